@@ -10,54 +10,176 @@
 
 #include "Tsunami.h"
 
+// Adds n to one of the receive statistics
+#ifdef __TSUNAMI_NO_RX_STATS__
+#define RX_COUNT(stat, n)	((void)0)
+#else
+#define RX_COUNT(stat, n)	(rxStats.stat += (n))
+#endif
+
+#ifndef __TSUNAMI_USE_HOST__
+#include <Arduino.h>
+
+#ifdef __TSUNAMI_USE_ALTSOFTSERIAL__
+static AltSoftSerial TsunamiSerial;
+#endif
+// The serial port selected in Tsunami.h, used by start(void)
+static TsunamiStreamTransport<decltype(TsunamiSerial)> defaultPort(TsunamiSerial);
 
 // **************************************************************
-// Starts the serial communication between Arduino and Tsunami (@ 57600 baud)
-// Then flushes the serial port
-// Then Requests version string
-// Then requests system info
+// Starts communication over the serial port selected in Tsunami.h
 void Tsunami::start(void) {
 
-uint8_t txbuf[5];
+	start(&defaultPort);
+}
+#endif
+
+// **************************************************************
+// Starts the communication between Arduino and Tsunami (@ 57600 baud)
+// over the given transport
+// Then flushes the serial port
+// Then starts the handshake: requests the version string and the
+// system info, and keeps asking from update() until both arrived.
+// Returns right away, see getHandshakeState() and setReadyCallback()
+void Tsunami::start(TsunamiTransport *pPort) {
 
+	port = pPort;
+#ifndef __TSUNAMI_NO_CALLBACKS__
 	trackReportCallback = NULL;
+#endif
 	versionRcvd = false;
+#if !defined(__TSUNAMI_NO_VERSION__) && !defined(__TSUNAMI_NO_DEFERRED_RX__)
+	versionStaged = 0;
+#endif
+	eventsDropped = 0;
+	resetRxStats();
 	sysinfoRcvd = false;
-  	TsunamiSerial.begin(57600);
+	numTracks = 0;
+	numVoices = 0;
+#ifndef __TSUNAMI_NO_COALESCE__
+	// Nothing is known about the values on a freshly started board
+	coalescer.reset();
+#endif
+#ifndef __TSUNAMI_NO_SCENES__
+	outState.clear();
+#endif
+#ifndef __TSUNAMI_NO_HOOKS__
+	if (mirror)
+		mirror->clear();
+	if (voices)
+		voices->idle();
+	if (poly)
+		poly->clear();
+#endif
+	port->begin(57600);
 	flush();
 
-	// Request version string
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x05;
-	txbuf[3] = CMD_GET_VERSION;
-	txbuf[4] = EOM;
-	TsunamiSerial.write(txbuf, 5);
+	readyMs = 0;
+	hsTries = 0;
+	hsStartMs = millis();
+	hsState = HANDSHAKE_AWAIT_VERSION;
+	handshakeSend();
+}
+
+// **************************************************************
+// Sets how long the handshake waits for an answer before asking
+// again, and how many times it asks before giving up
+void Tsunami::setHandshake(int retryMs, int tries) {
+
+	hsRetryMs = (uint16_t)retryMs;
+	hsMaxTries = (uint8_t)tries;
+}
+
+// **************************************************************
+// Runs the handshake again, to refresh the version and system info
+// (after the SD card was changed, for example). getVersion() and
+// getNumTracks() fail until the new answers arrive
+void Tsunami::requestInfo(void) {
+
+	versionRcvd = false;
+	sysinfoRcvd = false;
+	readyMs = 0;
+	hsTries = 0;
+	hsStartMs = millis();
+	hsState = HANDSHAKE_AWAIT_VERSION;
+	handshakeSend();
+}
+
+// **************************************************************
+// Private internal function that requests whatever the handshake
+// is still missing
+void Tsunami::handshakeSend(void) {
 
+	// Request version string
+	if (!versionRcvd)
+		writeConstFrame(TsunamiConstFrame<CMD_GET_VERSION>::data);
 	// Request system info
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x05;
-	txbuf[3] = CMD_GET_SYS_INFO;
-	txbuf[4] = EOM;
-	TsunamiSerial.write(txbuf, 5);
+	if (!sysinfoRcvd)
+		writeConstFrame(TsunamiConstFrame<CMD_GET_SYS_INFO>::data);
+	hsSentMs = millis();
+	hsTries++;
 }
 
 // **************************************************************
-// Flush: Resets rxCount, rxLen, and rxMsgReady, then writes all 0xFFFF to the voice table
+// Private internal function that moves the handshake on: to ready
+// once both answers are in, otherwise asks again when the last
+// request timed out, or fails after the last try
+void Tsunami::handshakeStep(void) {
+
+	if ((hsState != HANDSHAKE_AWAIT_VERSION) && (hsState != HANDSHAKE_AWAIT_SYSINFO))
+		return;
+	if (versionRcvd && sysinfoRcvd) {
+		hsState = HANDSHAKE_READY;
+		readyMs = millis() - hsStartMs;
+#ifndef __TSUNAMI_NO_CALLBACKS__
+		if (readyCallback)
+			readyCallback(true);
+#endif
+		return;
+	}
+	hsState = versionRcvd ? HANDSHAKE_AWAIT_SYSINFO : HANDSHAKE_AWAIT_VERSION;
+	if ((uint32_t)(millis() - hsSentMs) < hsRetryMs)
+		return;
+	if (hsTries >= hsMaxTries) {
+		hsState = HANDSHAKE_FAILED;
+		readyMs = millis() - hsStartMs;
+#ifndef __TSUNAMI_NO_CALLBACKS__
+		if (readyCallback)
+			readyCallback(false);
+#endif
+		return;
+	}
+	handshakeSend();
+}
+
+// **************************************************************
+// Flush: Resets rxCount and rxLen, then writes all 0xFFFF to the voice table
 // then reads from the serial while there are bytes available to clear it
 void Tsunami::flush(void) {
 
+#ifndef __TSUNAMI_NO_REPORTING__
 int i;
+#endif
+#ifndef __TSUNAMI_NO_DEFERRED_RX__
+TsunamiEvent ev;
+#endif
 
 	rxCount = 0;
 	rxLen = 0;
-	rxMsgReady = false;
+#ifndef __TSUNAMI_NO_REPORTING__
 	for (i = 0; i < MAX_NUM_VOICES; i++) {
 		voiceTable[i] = 0xffff;
 	}
-	while(TsunamiSerial.available())
-		i = TsunamiSerial.read();
+#ifndef __TSUNAMI_NO_TRACK_INDEX__
+	trackIndex.clear();
+#endif
+#endif
+	while(port->available())
+		port->read();
+#ifndef __TSUNAMI_NO_DEFERRED_RX__
+	while (events.pop(&ev))
+		;
+#endif
 }
 
 
@@ -66,139 +188,1214 @@ int i;
 // and callbacks are triggered
 void Tsunami::update(void) {
 
-int i;
-uint8_t dat;
-uint8_t voice;
-uint16_t track;
-
-	rxMsgReady = false;
-	while (TsunamiSerial.available() > 0) {
-		// dat is always our most recent data byte
-		dat = TsunamiSerial.read();
-		// Byte 0 should be SOM1
-		if ((rxCount == 0) && (dat == SOM1)) {
-			rxCount++;
+	update(0, 0);
+}
+
+// **************************************************************
+// Update with a budget: like update(), but stops after maxBytes
+// received bytes or maxMicros microseconds, whichever comes first
+// (0 means no limit). Bytes are read from the port and parsed in
+// chunks of RX_CHUNK_LEN, so the time budget is checked once per
+// chunk. A frame cut by the budget is completed by the next call.
+// Returns the number of bytes parsed. In RX_DEFERRED mode the budget
+// and the return value count queued messages instead of bytes
+int Tsunami::update(int maxBytes, uint32_t maxMicros) {
+
+uint8_t chunk[RX_CHUNK_LEN];
+#ifndef __TSUNAMI_NO_DEFERRED_RX__
+TsunamiEvent ev;
+#endif
+uint32_t t0 = 0;
+int done = 0;
+int n;
+
+	if ((hsState == HANDSHAKE_AWAIT_VERSION) || (hsState == HANDSHAKE_AWAIT_SYSINFO))
+		handshakeStep();
+#ifndef __TSUNAMI_NO_HOOKS__
+	if (cues)
+		runCues();
+#endif
+#ifndef __TSUNAMI_NO_COALESCE__
+	if (coalescing && coalescer.due(millis()))
+		coalesceFlush();
+#endif
+	if (txMode == TX_QUEUED)
+		txPump();
+	if (maxMicros)
+		t0 = micros();
+#ifndef __TSUNAMI_NO_DEFERRED_RX__
+	// In RX_DEFERRED mode the messages are already decoded
+	if (rxMode == RX_DEFERRED) {
+		while (events.pop(&ev)) {
+			rxApply(ev);
+			done++;
+			if (maxBytes && (done >= maxBytes))
+				break;
+			if (maxMicros && ((uint32_t)(micros() - t0) >= maxMicros))
+				break;
 		}
-		// Byte 1 should be SOM2
-		else if (rxCount == 1) {
-			// If byte 1 is SOM2, keep going
-			if (dat == SOM2)
-				rxCount++;
-			// Otherwise, bad message
-			else {
-				rxCount = 0;
-				#ifdef __TSUNAMI_DEBUG_MODE__
-				Serial.print(F("Bad msg 1\n"));
-				#endif
-			}
+#ifndef __TSUNAMI_NO_HOOKS__
+		if (sync)
+			syncTimeout();
+#endif
+#ifndef __TSUNAMI_NO_CALLBACKS__
+		if (dispatcher)
+			dispatchErrors();
+#endif
+		return done;
+	}
+#endif
+	for (;;) {
+		n = port->available();
+		if (n <= 0)
+			break;
+		if (n > RX_CHUNK_LEN)
+			n = RX_CHUNK_LEN;
+		if (maxBytes && (n > (maxBytes - done)))
+			n = maxBytes - done;
+		n = port->readBytes(chunk, n);
+		if (n <= 0)
+			break;
+		rxParse(chunk, n);
+		done += n;
+		if (maxBytes && (done >= maxBytes))
+			break;
+		if (maxMicros && ((uint32_t)(micros() - t0) >= maxMicros))
+			break;
+	}
+#ifndef __TSUNAMI_NO_HOOKS__
+	if (sync)
+		syncTimeout();
+#endif
+#ifndef __TSUNAMI_NO_CALLBACKS__
+	if (dispatcher)
+		dispatchErrors();
+#endif
+	return done;
+}
+
+#ifndef __TSUNAMI_NO_HOOKS__
+// **************************************************************
+// Private internal function that sends every cue that is due
+void Tsunami::runCues(void) {
+
+uint8_t frame[CUE_FRAME_LEN];
+int len;
+
+	while ((len = cues->next(micros(), frame)) > 0) {
+		if (latency && (frame[3] == CMD_TRACK_CONTROL))
+			latency->sent(frame[5] | (frame[6] << 8), frame[4]);
+		writeFrame(frame, len);
+	}
+}
+#endif
+
+// **************************************************************
+// Private internal function that returns true if len is a valid
+// frame length (SOM1 through EOM) for a message of type type.
+// Types the library does not know may have any length
+static bool rxLengthFits(uint8_t type, uint8_t len) {
+
+	switch (type) {
+		case RSP_TRACK_REPORT:
+			return len == TSUNAMI_FRAME_OVERHEAD + 4;
+		case RSP_VERSION_STRING:
+			return len == TSUNAMI_FRAME_OVERHEAD + VERSION_STRING_LEN - 1;
+		case RSP_SYSTEM_INFO:
+			return len == TSUNAMI_FRAME_OVERHEAD + 3;
+	}
+	return true;
+}
+
+// **************************************************************
+// Private internal function that feeds one byte to the receive
+// state machine, and dispatches the frame it completes. Returns
+// false if the byte does not fit the frame in progress: the frame
+// is then left in rxFrame for rxResync()
+inline bool Tsunami::rxStep(uint8_t dat) {
+
+	// Byte 0 should be SOM1, anything else is line noise
+	if (rxCount == 0) {
+		if (dat != SOM1) {
+			RX_COUNT(noise, 1);
+			RX_COUNT(bytesDiscarded, 1);
+			return true;
 		}
-		// Byte 2 should be message length
-		else if (rxCount == 2) {
-			// If the message length is less than the max message length
-			if (dat <= MAX_MESSAGE_LEN) {
-				rxCount++;
-				// Set our length
-				rxLen = dat - 1;
-			}
-			else {
-				rxCount = 0;
-				#ifdef __TSUNAMI_DEBUG_MODE__
-				Serial.print(F("Bad msg 2\n"));
-				#endif
-			}
+	}
+	// Byte 1 should be SOM2
+	else if (rxCount == 1) {
+		if (dat != SOM2) {
+			RX_COUNT(badSom2, 1);
+			return false;
 		}
-		// Everything past byte 2 but less than expected message length is the rx payload
-		else if ((rxCount > 2) && (rxCount < rxLen)) {
-			// Store payload in rxMessage
-			rxMessage[rxCount - 3] = dat;
-			rxCount++;
+	}
+	// Byte 2 should be message length
+	else if (rxCount == 2) {
+		// The length covers SOM1 through EOM, so a frame with a
+		// message type has at least TSUNAMI_FRAME_OVERHEAD bytes
+		if (dat > MAX_MESSAGE_LEN) {
+			RX_COUNT(oversize, 1);
+			return false;
 		}
-		// If we're at the expected message length
-		else if (rxCount == rxLen) {
-			// If the last byte is the EOM byte, the message is valid
-			if (dat == EOM)
-			// This is a good place to put a messageReceived callback
-				rxMsgReady = true;
-			else {
-				rxCount = 0;
-				#ifdef __TSUNAMI_DEBUG_MODE__
-				Serial.print(F("Bad msg 3\n"));
-				#endif
+		if (dat < TSUNAMI_FRAME_OVERHEAD) {
+			RX_COUNT(undersize, 1);
+			return false;
+		}
+		// Set our length
+		rxLen = dat - 1;
+	}
+	// Byte 3 is the message type, which fixes the length of the
+	// known messages. A damaged length is caught here rather than
+	// after waiting out a frame of the wrong size
+	else if (rxCount == 3) {
+		if (!rxLengthFits(dat, rxLen + 1)) {
+			RX_COUNT(badLength, 1);
+			return false;
+		}
+	}
+	// We're at the expected message length
+	else if (rxCount == rxLen) {
+		// If the last byte is the EOM byte, the message is valid
+		if (dat != EOM) {
+			RX_COUNT(badEom, 1);
+			return false;
+		}
+		// This is a good place to put a messageReceived callback
+		rxDispatch();
+		// Reset rx state after this message has been received
+		rxCount = 0;
+		rxLen = 0;
+		return true;
+	}
+	// Everything up to the EOM is kept in rxFrame
+	if (rxCount < RX_FRAME_LEN)
+		rxFrame[rxCount] = dat;
+	rxCount++;
+	return true;
+}
+
+// **************************************************************
+// Private internal function that runs the SOM1/SOM2/length/EOM
+// state machine over a block of received bytes. The state is kept
+// in rxCount, rxLen and rxFrame between calls. Framing errors are
+// counted in rxStats
+void Tsunami::rxParse(const uint8_t *buf, int len) {
+
+int n;
+
+	for (n = 0; n < len; n++) {
+		if (!rxStep(buf[n]))
+			rxResync(buf[n]);
+	}
+}
+
+// **************************************************************
+// Private internal function called when dat does not fit the frame
+// in rxFrame. Rather than throwing the whole frame away, the parser
+// restarts at the next SOM1 inside it, so a frame that began within
+// a damaged one is not lost with it. The bytes from that SOM1 on,
+// then dat, are fed through rxStep() again; dat itself may be the
+// SOM1 of the next frame. Repeats while a rescanned byte is rejected
+void Tsunami::rxResync(uint8_t dat) {
+
+uint8_t pend[RX_FRAME_LEN + 1];
+int head = 0;
+int tail = 0;
+int kept;
+int i;
+bool rejected = true;
+
+	while (rejected) {
+		// Bytes past RX_FRAME_LEN were not kept, so a frame that
+		// long can not be rescanned
+		kept = (rxCount < RX_FRAME_LEN) ? rxCount : RX_FRAME_LEN;
+		i = kept;
+		if (rxCount <= RX_FRAME_LEN) {
+			for (i = 1; i < kept; i++) {
+				if (rxFrame[i] == SOM1)
+					break;
 			}
 		}
-		// Any other pattern of bytes indicates a bad message, reset and set rxCount to 0
-		else {
-			rxCount = 0;
-			#ifdef __TSUNAMI_DEBUG_MODE__
-			Serial.print(F("Bad msg 4\n"));
-			#endif
+		if (i < kept)
+			RX_COUNT(resyncs, 1);
+		RX_COUNT(bytesDiscarded, rxCount - (kept - i));
+		// Queue rxFrame[i..kept - 1] and dat ahead of the bytes still
+		// waiting from an earlier pass
+		memmove(pend + (kept - i) + 1, pend + head, tail - head);
+		memcpy(pend, rxFrame + i, kept - i);
+		pend[kept - i] = dat;
+		tail = (kept - i) + 1 + (tail - head);
+		head = 0;
+		rxCount = 0;
+		rejected = false;
+		while (head < tail) {
+			dat = pend[head++];
+			if (!rxStep(dat)) {
+				rejected = true;
+				break;
+			}
 		}
-		// If we have a valid message
-		if (rxMsgReady) {
-			// Byte 0 in the payload indicates the rx message type
-			switch (rxMessage[0]) {
-				// Track report: sent every time a track starts or stops. Good place for a callback
-				// This is where the voice table is updated
-				case RSP_TRACK_REPORT:
-					track = rxMessage[2];
-					track = (track << 8) + rxMessage[1] + 1;
-					// Voice is the index within voice table
-					voice = rxMessage[3];
-					if (voice < MAX_NUM_VOICES) {
-						if (rxMessage[4] == 0) {
-							if (track == voiceTable[voice])
-								voiceTable[voice] = 0xffff;
-						}
-						else
-							voiceTable[voice] = track;
+	}
+}
+
+// **************************************************************
+// Starts a sync group: loads every member paused, then sends
+// resumeAllInSync() from update() as soon as the track reports
+// confirm each member got a voice. If that takes more than
+// timeoutMs, the group is left loaded in state SYNC_TIMED_OUT and
+// its getMissing() mask lists the members without a voice. Needs
+// reporting enabled. Note that resumeAllInSync() also resumes any
+// other paused track. Only one group can be loading at a time;
+// returns false if another one is or the group is empty
+bool Tsunami::syncStart(TsunamiSyncGroup *pGroup, int timeoutMs) {
+
+#ifdef __TSUNAMI_NO_HOOKS__
+	(void)pGroup;
+	(void)timeoutMs;
+	return false;
+#else
+int i;
+
+	if (sync || (pGroup->count == 0))
+		return false;
+	for (i = 0; i < pGroup->count; i++)
+		trackLoad(pGroup->tracks[i], pGroup->outs[i], pGroup->locks[i]);
+	pGroup->begin(millis(), (uint16_t)timeoutMs);
+	sync = pGroup;
+	return true;
+#endif
+}
+
+#ifndef __TSUNAMI_NO_HOOKS__
+// **************************************************************
+// Private internal function that gives up waiting for the sync group
+// once its time is out. update() calls it after handling the reports
+// received so far, so a confirmation already in the buffer counts
+void Tsunami::syncTimeout(void) {
+
+	if ((uint32_t)(millis() - sync->startMs) < sync->timeoutMs)
+		return;
+	sync->state = SYNC_TIMED_OUT;
+	sync->confirmMs = millis() - sync->startMs;
+	sync = NULL;
+}
+#endif
+
+// **************************************************************
+// Gives up on a sync group: stops every member and returns the group
+// to SYNC_IDLE. Members not confirmed yet are stopped too, as a load
+// still on its way would otherwise land paused and start with the
+// next resumeAllInSync()
+void Tsunami::syncCancel(TsunamiSyncGroup *pGroup) {
+
+int i;
+
+#ifndef __TSUNAMI_NO_HOOKS__
+	if (sync == pGroup)
+		sync = NULL;
+#endif
+	for (i = 0; i < pGroup->count; i++) {
+		trackStop(pGroup->tracks[i]);
+		pGroup->voices[i] = 0xff;
+	}
+	pGroup->missing = 0;
+	pGroup->state = SYNC_IDLE;
+}
+
+// **************************************************************
+// Copies the receive statistics counted since start() or the last
+// resetRxStats() into pStats
+void Tsunami::getRxStats(TsunamiRxStats *pStats) {
+
+#ifdef __TSUNAMI_NO_RX_STATS__
+	memset(pStats, 0, sizeof(*pStats));
+#else
+	TSUNAMI_ATOMIC_BEGIN();
+	*pStats = rxStats;
+	TSUNAMI_ATOMIC_END();
+	pStats->overruns = port ? (port->getOverruns() - overrunBase) : 0;
+	pStats->eventsDropped = eventsDropped - eventsDroppedBase;
+#endif
+}
+
+// **************************************************************
+// Clears the receive statistics
+void Tsunami::resetRxStats(void) {
+
+#ifndef __TSUNAMI_NO_RX_STATS__
+	TSUNAMI_ATOMIC_BEGIN();
+	memset(&rxStats, 0, sizeof(rxStats));
+	TSUNAMI_ATOMIC_END();
+	overrunBase = port ? port->getOverruns() : 0;
+	eventsDroppedBase = eventsDropped;
+#endif
+#ifndef __TSUNAMI_NO_CALLBACKS__
+	errorsSeen = 0;
+#endif
+}
+
+// **************************************************************
+// Selects where received bytes are framed and decoded:
+//   RX_DIRECT:   update() reads, frames and handles every message
+//                (the default)
+//   RX_DEFERRED: call rxService() from the serial RX interrupt,
+//                serialEvent or a reader thread. It frames the bytes
+//                and queues each decoded message in a lock-free
+//                queue of EVENT_QUEUE_LEN entries. update() only
+//                drains that queue: it updates the voice table and
+//                calls the callbacks, in the main loop. Messages that
+//                find the queue full are counted by getEventsDropped()
+// Change modes only while rxService() cannot run
+void Tsunami::setRxMode(int mode) {
+
+#ifdef __TSUNAMI_NO_DEFERRED_RX__
+	// Without the event queue every message is applied in update()
+	mode = RX_DIRECT;
+#endif
+	rxMode = (uint8_t)mode;
+}
+
+// **************************************************************
+// Receive side of RX_DEFERRED mode: reads every available byte
+// from the port and queues the decoded messages. Must not run at
+// the same time as itself. Returns the number of bytes read
+int Tsunami::rxService(void) {
+
+uint8_t chunk[RX_CHUNK_LEN];
+int done = 0;
+int n;
+
+	while (port->available() > 0) {
+		n = port->readBytes(chunk, RX_CHUNK_LEN);
+		if (n <= 0)
+			break;
+		rxParse(chunk, n);
+		done += n;
+	}
+	return done;
+}
+
+// **************************************************************
+// Private internal function that decodes the complete message in
+// rxFrame into an event. In RX_DEFERRED mode this runs on the
+// receive side, so it only queues the event
+void Tsunami::rxDispatch(void) {
+
+#ifndef __TSUNAMI_NO_VERSION__
+int i;
+#endif
+TsunamiEvent ev;
+const uint8_t *msg = rxFrame + 3;
+
+	// The payload follows SOM1, SOM2 and the length byte
+	ev.type = msg[0];
+	// Byte 0 in the payload indicates the rx message type
+	switch (msg[0]) {
+		// Track report: sent every time a track starts or stops
+		case RSP_TRACK_REPORT:
+			RX_COUNT(trackReports, 1);
+			ev.track = msg[2];
+			ev.track = (ev.track << 8) + msg[1] + 1;
+			// Voice is the index within voice table
+			ev.voice = msg[3];
+			ev.didStart = (msg[4] != 0);
+		break;
+		// Version string: Sent to the Arduino at somepoint after initialization
+		case RSP_VERSION_STRING:
+			RX_COUNT(versions, 1);
+#ifdef __TSUNAMI_NO_VERSION__
+			// Only the arrival matters, the string is not kept
+			ev.voice = 0;
+			ev.track = 0;
+#elif defined(__TSUNAMI_NO_DEFERRED_RX__)
+			// Always decoded in the main loop: no hand-over needed
+			for (i = 0; i < (VERSION_STRING_LEN - 1); i++)
+				version[i] = msg[i + 1];
+#else
+			// A version string still waiting for the main loop is kept,
+			// the main loop owns versionStage until it clears the flag
+			if (__atomic_load_n(&versionStaged, __ATOMIC_ACQUIRE))
+				return;
+			// Copy version string from payload
+			for (i = 0; i < (VERSION_STRING_LEN - 1); i++)
+				versionStage[i] = msg[i + 1];
+			__atomic_store_n(&versionStaged, 1, __ATOMIC_RELEASE);
+#endif
+		break;
+		// System info: Indicates max number of voices supported and number of tracks found on SD card
+		case RSP_SYSTEM_INFO:
+			RX_COUNT(sysInfos, 1);
+			ev.voice = msg[1];
+			ev.track = msg[3];
+			ev.track = (ev.track << 8) + msg[2];
+		break;
+		// Status: not used by the library
+		case RSP_STATUS:
+			RX_COUNT(status, 1);
+			return;
+		default:
+			RX_COUNT(unknownType, 1);
+			return;
+	}
+#ifndef __TSUNAMI_NO_DEFERRED_RX__
+	if (rxMode == RX_DEFERRED) {
+		if (!events.push(ev))
+			eventsDropped++;
+	}
+	else
+#endif
+		rxApply(ev);
+}
+
+// **************************************************************
+// Private internal function that acts on a decoded message. Always
+// runs in the main loop
+void Tsunami::rxApply(const TsunamiEvent &ev) {
+
+#ifndef __TSUNAMI_NO_CALLBACKS__
+TsunamiDispatchEvent dev;
+#endif
+
+	switch (ev.type) {
+		// Track report: This is where the voice table is updated
+		case RSP_TRACK_REPORT:
+#ifndef __TSUNAMI_NO_REPORTING__
+			if (ev.voice < MAX_NUM_VOICES) {
+				if (!ev.didStart) {
+					if (ev.track == voiceTable[ev.voice]) {
+						voiceTable[ev.voice] = 0xffff;
+#ifndef __TSUNAMI_NO_TRACK_INDEX__
+						trackIndex.remove(ev.track, ev.voice);
+#endif
+#ifndef __TSUNAMI_NO_HOOKS__
+						if (voices)
+							voices->stopped(ev.voice);
+						if (poly)
+							poly->stopped(ev.track);
+#endif
 					}
-					// Call the track report callback, if one has been specified
-					if (trackReportCallback) {
-						trackReportCallback(track, voice, rxMessage[4]);
+				}
+				else {
+#ifndef __TSUNAMI_NO_HOOKS__
+					if (voices)
+						voices->started(ev.voice, voiceTable[ev.voice], ev.track);
+					if (poly)
+						poly->started(ev.track, voiceTable[ev.voice]);
+#endif
+					if (voiceTable[ev.voice] != 0xffff) {
+#ifndef __TSUNAMI_NO_TRACK_INDEX__
+						trackIndex.remove(voiceTable[ev.voice], ev.voice);
+#endif
+#ifndef __TSUNAMI_NO_HOOKS__
+						// The voice was taken without a stop report
+						if (mirror)
+							mirror->report(voiceTable[ev.voice], false);
+#endif
 					}
-					#ifdef __TSUNAMI_DEBUG_MODE__
-					Serial.print("Track ");
-					Serial.print(track);
-					if (rxMessage[4] == 0)
-						Serial.print(" off\n");
-					else
-						Serial.print(" on\n");
-					#endif
-				break;
-				// Version string: Sent to the Arduino at somepoint after initialization
-				case RSP_VERSION_STRING:
-					// Copy version string from payload
-					for (i = 0; i < (VERSION_STRING_LEN - 1); i++)
-						version[i] = rxMessage[i + 1];
-					// zero-terminated char array to make it a string
-					version[VERSION_STRING_LEN - 1] = 0;
-					// Mark version received
-					versionRcvd = true;
-					#ifdef __TSUNAMI_DEBUG_MODE__
-					Serial.write(version);
-					Serial.write("\n");
-					#endif
+					voiceTable[ev.voice] = ev.track;
+#ifndef __TSUNAMI_NO_TRACK_INDEX__
+					trackIndex.add(ev.track, ev.voice);
+#endif
+				}
+			}
+#endif
+#ifndef __TSUNAMI_NO_HOOKS__
+			if (mirror)
+				mirror->report(ev.track, ev.didStart);
+			if (latency)
+				latency->report(ev.track, ev.didStart);
+			// The last load of a sync group got its voice: start them all
+			if (sync && ev.didStart && sync->confirm(ev.track, ev.voice)) {
+				resumeAllInSync();
+				sync->state = SYNC_STARTED;
+				sync->confirmMs = millis() - sync->startMs;
+				sync = NULL;
+			}
+#endif
+#ifndef __TSUNAMI_NO_CALLBACKS__
+			// Call the track report callback, if one has been specified
+			if (trackReportCallback) {
+				trackReportCallback(ev.track, ev.voice, ev.didStart);
+			}
+			if (dispatcher) {
+				dev.type = DISPATCH_TRACK_REPORT;
+				dev.track = ev.track;
+				dev.voice = ev.voice;
+				dev.didStart = ev.didStart;
+				dev.version = NULL;
+				dev.errors = 0;
+				dev.board = this;
+				dispatcher->dispatch(dev);
+			}
+#endif
+			#ifdef __TSUNAMI_DEBUG_MODE__
+			Serial.print("Track ");
+			Serial.print(ev.track);
+			if (!ev.didStart)
+				Serial.print(" off\n");
+			else
+				Serial.print(" on\n");
+			#endif
+		break;
+		case RSP_VERSION_STRING:
+#ifndef __TSUNAMI_NO_VERSION__
+#ifndef __TSUNAMI_NO_DEFERRED_RX__
+			memcpy(version, versionStage, VERSION_STRING_LEN - 1);
+#endif
+			// zero-terminated char array to make it a string
+			version[VERSION_STRING_LEN - 1] = 0;
+#ifndef __TSUNAMI_NO_DEFERRED_RX__
+			__atomic_store_n(&versionStaged, 0, __ATOMIC_RELEASE);
+#endif
+#endif
+			// Mark version received
+			versionRcvd = true;
+			handshakeStep();
+#ifndef __TSUNAMI_NO_CALLBACKS__
+			if (dispatcher) {
+				memset(&dev, 0, sizeof(dev));
+				dev.type = DISPATCH_VERSION;
+#ifndef __TSUNAMI_NO_VERSION__
+				dev.version = version;
+#endif
+				dev.board = this;
+				dispatcher->dispatch(dev);
+			}
+#endif
+			#if defined(__TSUNAMI_DEBUG_MODE__) && !defined(__TSUNAMI_NO_VERSION__)
+			Serial.write(version);
+			Serial.write("\n");
+			#endif
+		break;
+		case RSP_SYSTEM_INFO:
+			numVoices = ev.voice;
+			numTracks = ev.track;
+			sysinfoRcvd = true;
+			handshakeStep();
+#ifndef __TSUNAMI_NO_CALLBACKS__
+			if (dispatcher) {
+				memset(&dev, 0, sizeof(dev));
+				dev.type = DISPATCH_SYSINFO;
+				dev.voice = ev.voice;
+				dev.track = ev.track;
+				dev.board = this;
+				dispatcher->dispatch(dev);
+			}
+#endif
+			#ifdef __TSUNAMI_DEBUG_MODE__
+			Serial.print("Sys info received\n");
+			#endif
+		break;
+	}
+}
+
+// **************************************************************
+// Selects how command frames are sent:
+//   TX_DIRECT:     every command is written to the port immediately
+//                  (the default). The write blocks once the UART
+//                  buffer is full
+//   TX_QUEUED:     commands go into a queue that is drained by
+//                  update() and txPump(), as fast as the port can
+//                  take bytes without blocking. The queue has a ring
+//                  per priority class (see txClass()) and the most
+//                  urgent queued frame always goes out first
+//   TX_QUEUED_ISR: like TX_QUEUED, but update() leaves the queue
+//                  alone. Call txPump() from the TX-empty interrupt
+//                  or serialEvent. The library only pumps itself
+//                  while it waits for the queue (below), with the
+//                  interrupt held off
+// overflow selects what happens to a command that does not fit:
+//   TX_OVERFLOW_DROP:    the new command is discarded
+//   TX_OVERFLOW_BLOCK:   waits (blocking), pumping the queue, until
+//                        the port has taken enough queued frames to
+//                        make room
+//   TX_OVERFLOW_REPLACE: the oldest queued frames of the same
+//                        class are discarded
+// Frames are never split, whatever the policy. Lost frames are
+// counted by getTxDropped()
+void Tsunami::setTxMode(int mode, int overflow) {
+
+#ifdef __TSUNAMI_NO_TX_QUEUE__
+	// Without the queue every command is written directly
+	mode = TX_DIRECT;
+#else
+	// Anything still queued goes out before direct writes resume
+	if (mode == TX_DIRECT) {
+		while (txPending())
+			txWait();
+	}
+#endif
+	txMode = (uint8_t)mode;
+	txOverflow = (uint8_t)overflow;
+}
+
+// **************************************************************
+// Writes as many whole queued frames as the port accepts without
+// blocking, always the oldest frame of the most urgent class first.
+// A frame is only taken from the queue once it fits, so a more
+// urgent frame queued meanwhile goes out at the next frame boundary.
+// Returns the number of bytes written
+int Tsunami::txPump(void) {
+
+#ifdef __TSUNAMI_NO_TX_QUEUE__
+	return 0;
+#else
+uint8_t frame[MAX_MESSAGE_LEN];
+int cls;
+int len;
+int room;
+int sent = 0;
+
+	room = port->availableForWrite();
+	for (;;) {
+		for (cls = 0; cls < TX_PRIO_CLASSES; cls++) {
+			if ((len = txQueue[cls].peekLen()) > 0)
 				break;
-				// System info: Indicates max number of voices supported and number of tracks found on SD card
-				case RSP_SYSTEM_INFO:
-					numVoices = rxMessage[1];
-					numTracks = rxMessage[3];
-					numTracks = (numTracks << 8) + rxMessage[2];
-					sysinfoRcvd = true;
-					#ifdef __TSUNAMI_DEBUG_MODE__
-					Serial.print("Sys info received\n");
-					#endif
+		}
+		if ((cls == TX_PRIO_CLASSES) || (len > room))
+			break;
+		txQueue[cls].pop(frame);
+		port->write(frame, len);
+		if (txDelay)
+			txDelay->sent(cls);
+		room -= len;
+		sent += len;
+	}
+	return sent;
+#endif
+}
+
+// **************************************************************
+// Private internal function called in a loop by whatever waits for
+// the transmit queue. It pumps in both queued modes: serialEvent,
+// which may drive TX_QUEUED_ISR, does not run meanwhile. A port that
+// takes nothing without blocking (availableForWrite() 0, what a plain
+// Print returns) gets the most urgent frame written directly, which
+// waits for the UART rather than spinning forever
+void Tsunami::txWait(void) {
+
+#ifndef __TSUNAMI_NO_TX_QUEUE__
+uint8_t frame[MAX_MESSAGE_LEN];
+int cls;
+int len = 0;
+bool isr = (txMode == TX_QUEUED_ISR);
+
+	// The interrupt must not pop while the main loop does
+	if (isr) {
+		TSUNAMI_ATOMIC_BEGIN();
+	}
+	if (!txPump() && (port->availableForWrite() <= 0)) {
+		for (cls = 0; cls < TX_PRIO_CLASSES; cls++) {
+			if ((len = txQueue[cls].pop(frame)) > 0) {
+				if (txDelay)
+					txDelay->sent(cls);
 				break;
+			}
+		}
+	}
+	if (isr) {
+		TSUNAMI_ATOMIC_END();
+	}
+	// Written with interrupts on, as the write may wait for the UART
+	if (len > 0)
+		port->write(frame, len);
+#endif
+}
+
+// **************************************************************
+// Returns the number of bytes waiting in the transmit queue, all
+// classes together
+int Tsunami::txPending(void) {
+
+#ifdef __TSUNAMI_NO_TX_QUEUE__
+	return 0;
+#else
+int cls;
+int n = 0;
+
+	for (cls = 0; cls < TX_PRIO_CLASSES; cls++)
+		n += txQueue[cls].pending();
+	return n;
+#endif
+}
+
+// **************************************************************
+// Returns the number of bytes free in the TX_PRIO_BULK ring, where
+// gains, fades and the other frequent commands go
+int Tsunami::txSpace(void) {
+
+	return txSpace(TX_PRIO_BULK);
+}
+
+// **************************************************************
+// Returns the number of bytes free in the ring of class cls
+// (TX_PRIO_STOP, TX_PRIO_PLAY or TX_PRIO_BULK)
+int Tsunami::txSpace(int cls) {
+
+#ifdef __TSUNAMI_NO_TX_QUEUE__
+	(void)cls;
+	return 0;
+#else
+	return txQueue[cls].space();
+#endif
+}
+
+// **************************************************************
+// Times every queued frame from the queue to the port, per class.
+// Set it while the queue is empty. NULL stops the timing
+void Tsunami::setTxDelayMonitor(TsunamiTxDelay *pMon) {
+
+#ifdef __TSUNAMI_NO_TX_QUEUE__
+	(void)pMon;
+#else
+	if (pMon)
+		pMon->clear();
+	txDelay = pMon;
+#endif
+}
+
+// **************************************************************
+// Enables or disables coalescing of trackGain(), masterGain() and
+// samplerateOffset() commands. The last value sent to every output
+// (and to the most recent tracks) is remembered, and commands that
+// would not change it are dropped. With a windowMs above 0, changed
+// values are held for up to windowMs milliseconds and only the newest
+// value per target goes out when update() flushes them. Any other
+// command flushes the held values first, so the command order seen
+// by the Tsunami is kept
+void Tsunami::setCoalescing(bool enable, int windowMs) {
+
+#ifdef __TSUNAMI_NO_COALESCE__
+	(void)enable;
+	(void)windowMs;
+#else
+	if (!enable)
+		coalesceFlush();
+	coalescer.setWindow((uint16_t)windowMs);
+	coalescing = enable;
+#endif
+}
+
+// **************************************************************
+// Sends every value held by the coalescer now
+void Tsunami::coalesceFlush(void) {
+
+#ifndef __TSUNAMI_NO_COALESCE__
+uint8_t frame[MAX_MESSAGE_LEN];
+int len;
+
+	while ((len = coalescer.takePending(frame)) > 0)
+		coalesceSend(frame, len);
+#endif
+}
+
+#ifndef __TSUNAMI_NO_COALESCE__
+// **************************************************************
+// Private internal function that sends a frame the coalescer has
+// already recorded as sent. When the transmit queue drops frames
+// meanwhile, the coalescer forgets what they carried: the frame
+// itself, or with TX_OVERFLOW_REPLACE the older frames it pushed out,
+// which may be any
+void Tsunami::coalesceSend(const uint8_t *frame, int len) {
+
+uint16_t dropped = txDropped;
+
+	sendFrame(frame, len);
+	if (txDropped != dropped)
+		coalescer.forget((txOverflow == TX_OVERFLOW_REPLACE) ? NULL : frame);
+}
+#endif
+
+// **************************************************************
+// Copies the coalescer counters to pStats (all zero when the
+// coalescer is compiled out)
+void Tsunami::getCoalesceStats(TsunamiCoalesceStats *pStats) {
+
+#ifdef __TSUNAMI_NO_COALESCE__
+	memset(pStats, 0, sizeof(*pStats));
+#else
+	coalescer.getStats(pStats);
+#endif
+}
+
+// **************************************************************
+// Clears the coalescer counters
+void Tsunami::resetCoalesceStats(void) {
+
+#ifndef __TSUNAMI_NO_COALESCE__
+	coalescer.resetStats();
+#endif
+}
+
+// **************************************************************
+// Starts a batch: in TX_DIRECT mode the commands sent until
+// endBatch() are collected in pBuf (size bytes, at least the
+// longest frame) and written to the port together. The queued
+// modes already write frames in blocks and ignore the batch
+void Tsunami::beginBatch(uint8_t *pBuf, int size) {
+
+	endBatch();
+	batchBuf = pBuf;
+	batchSize = (uint8_t)size;
+}
+
+// **************************************************************
+// Writes the frames held by the batch and ends it
+void Tsunami::endBatch(void) {
+
+	if (batchLen)
+		port->write(batchBuf, batchLen);
+	batchBuf = NULL;
+	batchLen = 0;
+}
+
+// **************************************************************
+// Private internal function that every command goes through. Passes
+// the frame through the coalescer, if enabled, then sends it
+void Tsunami::writeFrame(const uint8_t *frame, int len) {
+
+#ifndef __TSUNAMI_NO_HOOKS__
+	if (mirror)
+		mirror->sent(frame, len, millis());
+#endif
+#ifndef __TSUNAMI_NO_SCENES__
+	outState.sent(frame);
+#endif
+#ifndef __TSUNAMI_NO_COALESCE__
+	if (coalescing) {
+		if (coalescer.absorb(frame, len, millis()))
+			return;
+		coalesceFlush();
+		coalescer.sent(frame);
+		coalesceSend(frame, len);
+		return;
+	}
+#endif
+	sendFrame(frame, len);
+}
+
+// **************************************************************
+// Private internal function that sends a constant frame stored in
+// flash (see TsunamiConstFrame)
+void Tsunami::writeConstFrame(const uint8_t *pFrame) {
+
+uint8_t txbuf[TSUNAMI_FRAME_OVERHEAD];
+
+	tsunamiCopyP(txbuf, pFrame, TSUNAMI_FRAME_OVERHEAD);
+	writeFrame(txbuf, TSUNAMI_FRAME_OVERHEAD);
+}
+
+#ifndef __TSUNAMI_NO_TX_QUEUE__
+// **************************************************************
+// True for a queued play or load (given by its first
+// TX_QUEUE_SCAN_LEN bytes), which the stop all frame makes pointless
+static bool txEndedBy(const uint8_t *queued, const uint8_t *frame) {
+
+uint8_t code = queued[MsgTrackControl::Offset<0>::value];
+
+	(void)frame;
+	return (queued[3] == CMD_TRACK_CONTROL) &&
+		((code == TRK_PLAY_SOLO) || (code == TRK_PLAY_POLY) || (code == TRK_LOAD));
+}
+
+// **************************************************************
+// True if frame must not go out before the queued frame (given by
+// its first TX_QUEUE_SCAN_LEN bytes), because the Tsunami would end
+// up in a different state
+static bool txDepends(const uint8_t *queued, const uint8_t *frame) {
+
+uint8_t code;
+
+	// Stop all and resume all act on every track
+	if (queued[3] == CMD_STOP_ALL)
+		return true;
+	// The stop all takes the queued plays and loads out (see sendFrame())
+	if ((frame[3] == CMD_STOP_ALL) && txEndedBy(queued, frame))
+		return false;
+	if (frame[3] != CMD_TRACK_CONTROL)
+		return (queued[3] == CMD_TRACK_CONTROL) || (queued[3] == CMD_RESUME_ALL_SYNC);
+	if (queued[3] == CMD_RESUME_ALL_SYNC)
+		return true;
+	// Track commands keep their order per track
+	if (queued[3] == CMD_TRACK_CONTROL)
+		return (queued[MsgTrackControl::Offset<1>::value] == frame[MsgTrackControl::Offset<1>::value]) &&
+			(queued[MsgTrackControl::Offset<1>::value + 1] == frame[MsgTrackControl::Offset<1>::value + 1]);
+	// and a play follows the gain and fade of its track. A stop may
+	// go first: the gain of a stopped track still applies
+	code = frame[MsgTrackControl::Offset<0>::value];
+	if ((code == TRK_STOP) || (code == TRK_PAUSE))
+		return false;
+	if ((queued[3] == CMD_TRACK_VOLUME) || (queued[3] == CMD_TRACK_FADE))
+		return (queued[MsgTrackVolume::Offset<0>::value] == frame[MsgTrackControl::Offset<1>::value]) &&
+			(queued[MsgTrackVolume::Offset<0>::value + 1] == frame[MsgTrackControl::Offset<1>::value + 1]);
+	return false;
+}
+
+// The board and the ring a stop all is taking plays and loads out
+// of, for txCancelled()
+struct TsunamiTxCancel {
+	Tsunami *pBoard;
+	int cls;
+};
+
+// **************************************************************
+// Private internal function called for each play or load a stop all
+// takes out of a ring, pos frames after the oldest one kept there.
+// The mirror needs nothing: the stop all that follows stops the
+// track there too
+void Tsunami::txCancelled(void *pCtx, const uint8_t *queued, int pos) {
+
+TsunamiTxCancel *pCancel = (TsunamiTxCancel *)pCtx;
+Tsunami *pT = pCancel->pBoard;
+
+	if (pT->txDelay)
+		pT->txDelay->removed(pCancel->cls, pos);
+	pT->txLost(queued);
+}
+
+// **************************************************************
+// Private internal function for a frame the transmit queue dropped
+// (given at least by its first TX_QUEUE_SCAN_LEN bytes): it counts
+// in txDropped, and the monitors that recorded a play or stop as
+// sent forget it
+void Tsunami::txLost(const uint8_t *frame) {
+
+#ifndef __TSUNAMI_NO_HOOKS__
+uint16_t trk;
+uint8_t code;
+#else
+	(void)frame;
+#endif
+
+	txDropped++;
+#ifndef __TSUNAMI_NO_HOOKS__
+	if (frame[3] != CMD_TRACK_CONTROL)
+		return;
+	trk = frame[MsgTrackControl::Offset<1>::value] +
+		(frame[MsgTrackControl::Offset<1>::value + 1] << 8);
+	code = frame[MsgTrackControl::Offset<0>::value];
+	if (latency && ((code == TRK_PLAY_SOLO) || (code == TRK_PLAY_POLY) || (code == TRK_STOP)))
+		latency->withdrawn(trk, code != TRK_STOP);
+	if (poly && (code == TRK_PLAY_POLY))
+		poly->withdrawn(trk);
+#endif
+}
+#endif
+
+// **************************************************************
+// Private internal function returning the priority class of a
+// frame: TX_PRIO_STOP for stop all, track stop and track pause,
+// TX_PRIO_PLAY for the other track commands and resume all, and
+// TX_PRIO_BULK for everything else. A frame is moved down to the
+// class of a less urgent queued frame it must not overtake (see
+// txDepends()), so only independent frames are reordered
+int Tsunami::txClass(const uint8_t *frame) {
+
+#ifdef __TSUNAMI_NO_TX_QUEUE__
+	(void)frame;
+	return TX_PRIO_BULK;
+#else
+int cls;
+int low;
+uint8_t code;
+
+	switch (frame[3]) {
+		case CMD_STOP_ALL:
+			cls = TX_PRIO_STOP;
+		break;
+		case CMD_TRACK_CONTROL:
+			code = frame[MsgTrackControl::Offset<0>::value];
+			cls = ((code == TRK_STOP) || (code == TRK_PAUSE)) ? TX_PRIO_STOP : TX_PRIO_PLAY;
+		break;
+		case CMD_RESUME_ALL_SYNC:
+			cls = TX_PRIO_PLAY;
+		break;
+		default:
+			return TX_PRIO_BULK;
+	}
+	for (low = TX_PRIO_BULK; low > cls; low--) {
+		if (txQueue[low].scan(txDepends, frame))
+			return low;
+	}
+	return cls;
+#endif
+}
 
+// **************************************************************
+// Private internal function that sends one complete command frame,
+// either directly or through the transmit queue
+void Tsunami::sendFrame(const uint8_t *frame, int len) {
+
+#ifndef __TSUNAMI_NO_TX_QUEUE__
+TsunamiTxQueue *pQueue;
+TsunamiTxCancel cancel;
+uint8_t lost[MAX_MESSAGE_LEN];
+int cls;
+#endif
+
+	// Held back to go out with the rest of the batch
+	if (batchBuf && (txMode == TX_DIRECT)) {
+		if ((batchLen + len) > batchSize) {
+			port->write(batchBuf, batchLen);
+			batchLen = 0;
+		}
+		if (len <= batchSize) {
+			memcpy(batchBuf + batchLen, frame, len);
+			batchLen += len;
+			return;
+		}
+	}
+#ifdef __TSUNAMI_NO_TX_QUEUE__
+	port->write(frame, len);
+#else
+	if (txMode == TX_DIRECT) {
+		port->write(frame, len);
+		return;
+	}
+	// Queued plays and loads would only start tracks the stop all
+	// ends. The other track commands still go out after it. A play
+	// held behind the gain of its track sits in the BULK ring
+	if (frame[3] == CMD_STOP_ALL) {
+		cancel.pBoard = this;
+		TSUNAMI_ATOMIC_BEGIN();
+		for (cancel.cls = TX_PRIO_PLAY; cancel.cls <= TX_PRIO_BULK; cancel.cls++)
+			txQueue[cancel.cls].remove(txEndedBy, frame, txCancelled, &cancel);
+		TSUNAMI_ATOMIC_END();
+	}
+	cls = txClass(frame);
+	pQueue = &txQueue[cls];
+	// Timed before the push, as the interrupt may send the frame as
+	// soon as it is queued
+	if (txDelay)
+		txDelay->queued(cls);
+	if (pQueue->push(frame, len))
+		return;
+	switch (txOverflow) {
+		case TX_OVERFLOW_BLOCK:
+			// Wait for the port (or the TX-empty interrupt) to make room
+			while (!pQueue->push(frame, len))
+				txWait();
+		break;
+		case TX_OVERFLOW_REPLACE:
+			// The interrupt may be popping frames at the same time
+			TSUNAMI_ATOMIC_BEGIN();
+			while (pQueue->space() < len) {
+				pQueue->pop(lost);
+				if (txDelay)
+					txDelay->dropped(cls);
+				txLost(lost);
 			}
-			// Reset rx payload state after this message has been received
-			rxCount = 0;
-			rxLen = 0;
-			rxMsgReady = false;
+			pQueue->push(frame, len);
+			TSUNAMI_ATOMIC_END();
+		break;
+		default:
+			if (txDelay)
+				txDelay->unqueued(cls);
+			txLost(frame);
+		break;
+	}
+#endif
+}
 
-		} // if (rxMsgReady)
+// **************************************************************
+// Counts voice starts, steals and busy time from the track reports
+// (see TsunamiVoiceStats). The voices playing now count as busy from
+// now on. NULL, the default, stops it. Without reporting
+// (__TSUNAMI_NO_REPORTING__) the monitor is never fed
+void Tsunami::setVoiceMonitor(TsunamiVoiceStats *pMon) {
+
+#ifdef __TSUNAMI_NO_HOOKS__
+	(void)pMon;
+#else
+#ifndef __TSUNAMI_NO_REPORTING__
+int i;
 
-	} // while (TsunamiSerial.available() > 0)
+	if (pMon) {
+		for (i = 0; i < MAX_NUM_VOICES; i++)
+			pMon->busy[i] = (voiceTable[i] != 0xffff);
+		pMon->clear();
+	}
+#endif
+	voices = pMon;
+#endif
+}
+
+// **************************************************************
+// Keeps trackPlayPrio() within a voice budget (see
+// TsunamiPolyManager). The tracks playing now count with the
+// manager's default priority. NULL, the default, stops it
+void Tsunami::setPolyManager(TsunamiPolyManager *pPoly) {
+
+#ifdef __TSUNAMI_NO_HOOKS__
+	(void)pPoly;
+#else
+#ifndef __TSUNAMI_NO_REPORTING__
+int i;
+#endif
+
+	if (pPoly) {
+		pPoly->clear();
+#ifndef __TSUNAMI_NO_REPORTING__
+		for (i = 0; i < MAX_NUM_VOICES; i++) {
+			if (voiceTable[i] != 0xffff)
+				pPoly->started(voiceTable[i], 0xffff);
+		}
+#endif
+	}
+	poly = pPoly;
+#endif
+}
+
+// **************************************************************
+// Sends the received events to the listeners of pDisp (see
+// TsunamiDispatcher), next to the track report callback. Parser
+// errors count from now on. NULL, the default, stops it. Ignored
+// with __TSUNAMI_NO_CALLBACKS__
+void Tsunami::setDispatcher(TsunamiDispatcher *pDisp) {
+
+#ifdef __TSUNAMI_NO_CALLBACKS__
+	(void)pDisp;
+#else
+	if (pDisp)
+		errorsSeen = rxErrors();
+	dispatcher = pDisp;
+#endif
+}
+
+// **************************************************************
+// Private internal function returning the frames the parser gave up
+uint32_t Tsunami::rxErrors(void) {
+
+#ifdef __TSUNAMI_NO_RX_STATS__
+	return 0;
+#else
+uint32_t n;
+
+	TSUNAMI_ATOMIC_BEGIN();
+	n = rxStats.badSom2 + rxStats.oversize + rxStats.undersize + rxStats.badEom + rxStats.badLength;
+	TSUNAMI_ATOMIC_END();
+	return n;
+#endif
+}
+
+// **************************************************************
+// Private: tells the listeners about the frames given up since the
+// last time, once per update()
+void Tsunami::dispatchErrors(void) {
+
+#ifndef __TSUNAMI_NO_CALLBACKS__
+TsunamiDispatchEvent dev;
+uint32_t n = rxErrors();
+
+	if (n == errorsSeen)
+		return;
+	memset(&dev, 0, sizeof(dev));
+	dev.type = DISPATCH_RX_ERROR;
+	dev.errors = n - errorsSeen;
+	dev.board = this;
+	errorsSeen = n;
+	dispatcher->dispatch(dev);
+#endif
 }
 
 // **************************************************************
@@ -206,45 +1403,102 @@ uint16_t track;
 // Indicates that track on voice has changed state. If didStart
 // is true, the track started playing. Otherwisem it has stopped playing
 void Tsunami::setTrackReportCallback(void (*pFunc)(uint16_t track, uint8_t voice, bool didStart)) {
+#ifdef __TSUNAMI_NO_CALLBACKS__
+	(void)pFunc;
+#else
 	trackReportCallback = pFunc;
+#endif
+}
+
+// **************************************************************
+// Sets the function called when the start-up handshake ends, with
+// ready true once the Tsunami answered and false when it gave up
+void Tsunami::setReadyCallback(void (*pFunc)(bool ready)) {
+
+#ifdef __TSUNAMI_NO_CALLBACKS__
+	(void)pFunc;
+#else
+	readyCallback = pFunc;
+#endif
+}
+
+// **************************************************************
+// Returns the track playing on voice, or -1 if the voice is free or
+// out of range
+int Tsunami::getVoiceTrack(int voice) {
+
+#ifdef __TSUNAMI_NO_REPORTING__
+	(void)voice;
+	return -1;
+#else
+	if ((voice < 0) || (voice >= MAX_NUM_VOICES) || (voiceTable[voice] == 0xffff))
+		return -1;
+	return voiceTable[voice];
+#endif
 }
 
 // **************************************************************
 // Returns the channel on which the track number is playing, 
-// or -1 if the track is not playing on any channels
+// or -1 if the track is not playing on any channels. When the
+// track plays on several voices, the lowest one is returned
 int Tsunami::isTrackPlaying(int trk) {
 
+#ifdef __TSUNAMI_NO_REPORTING__
+	(void)trk;
+	return -1;
+#else
+TsunamiVoiceMask mask;
+
 	update();
-	for (int i = 0; i < MAX_NUM_VOICES; i++) {
+	mask = trackVoices(trk);
+	if (!mask)
+		return -1;
+	return __builtin_ctzl(mask);
+#endif
+}
+
+// **************************************************************
+// Returns the number of voices track trk (1-4096) is playing on.
+// Unlike isTrackPlaying(), does not call update(): the answer is as
+// current as the last update() call. trackVoices(trk) returns the
+// same voices as a mask, bit n set for voice n
+int Tsunami::trackVoiceCount(int trk) {
+
+	return __builtin_popcountl(trackVoices(trk));
+}
+
+// **************************************************************
+// Returns the voices track trk plays on, bit n set for voice n. With
+// __TSUNAMI_NO_TRACK_INDEX__ the voice table is scanned instead
+TsunamiVoiceMask Tsunami::trackVoices(int trk) {
+
+#ifdef __TSUNAMI_NO_REPORTING__
+	(void)trk;
+	return 0;
+#elif defined(__TSUNAMI_NO_TRACK_INDEX__)
+TsunamiVoiceMask mask = 0;
+int i;
+
+	for (i = 0; i < MAX_NUM_VOICES; i++) {
 		if (voiceTable[i] == trk)
-			return i;
+			mask |= (TsunamiVoiceMask)1 << i;
 	}
-	return -1;
+	return mask;
+#else
+	return trackIndex.voices((uint16_t)trk);
+#endif
 }
 
 // **************************************************************
 // Set master gain on channel out to gain
 void Tsunami::masterGain(int out, int gain) {
 
-uint8_t txbuf[8];
-unsigned short vol;
-uint8_t o;
+uint8_t txbuf[MsgMasterVolume::LEN];
 
 	// Truncate output channel to proper range (4 stereo or 8 mono channels)
-	o = out & 0x07;
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x08;
-	txbuf[3] = CMD_MASTER_VOLUME;
-	txbuf[4] = o;
-	// Truncate gain to 16 bit short
-	vol = (unsigned short)gain;
-	// Byte 5 is gain LSB
-	txbuf[5] = (uint8_t)vol;
-	// Byte 6 is gain MSB
-	txbuf[6] = (uint8_t)(vol >> 8);
-	txbuf[7] = EOM;
-	TsunamiSerial.write(txbuf, 8);
+	// and gain to 16 bit short
+	MsgMasterVolume::encode(txbuf, out & 0x07, (uint16_t)gain);
+	writeFrame(txbuf, MsgMasterVolume::LEN);
 }
 
 // **************************************************************
@@ -252,15 +1506,10 @@ uint8_t o;
 // Should be called to enable callbacks
 void Tsunami::setReporting(bool enable) {
 
-uint8_t txbuf[6];
+uint8_t txbuf[MsgSetReporting::LEN];
 
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x06;
-	txbuf[3] = CMD_SET_REPORTING;
-	txbuf[4] = enable;
-	txbuf[5] = EOM;
-	TsunamiSerial.write(txbuf, 6);
+	MsgSetReporting::encode(txbuf, enable);
+	writeFrame(txbuf, MsgSetReporting::LEN);
 }
 
 // **************************************************************
@@ -269,6 +1518,11 @@ uint8_t txbuf[6];
 // no version string has been received from Tsunami), returns false
 bool Tsunami::getVersion(char *pDst, int len) {
 
+#ifdef __TSUNAMI_NO_VERSION__
+	(void)pDst;
+	(void)len;
+	return false;
+#else
 int i;
 
 	update();
@@ -280,8 +1534,9 @@ int i;
 			break;
 		pDst[i] = version[i];
 	}
-	pDst[++i] = 0;
+	pDst[i] = 0;
 	return true;
+#endif
 }
 
 // **************************************************************
@@ -291,9 +1546,22 @@ int i;
 int Tsunami::getNumTracks(void) {
 
 	update();
+	if (!sysinfoRcvd)
+		return -1;
 	return numTracks;
 }
 
+// **************************************************************
+// Returns the number of voices the Tsunami supports, or -1 if the
+// Tsunami hasn't provided a number
+int Tsunami::getNumVoices(void) {
+
+	update();
+	if (!sysinfoRcvd)
+		return -1;
+	return numVoices;
+}
+
 
 // **************************************************************
 // Stops any and all tracks currently playing (on all outputs?) 
@@ -327,6 +1595,35 @@ int flags = 0;
 	trackControl(trk, TRK_PLAY_POLY, out, flags);
 }
 
+// **************************************************************
+// Starts track trk (1-4096) like trackPlayPoly(), with priority prio
+// (POLY_PRIO_LOW ... POLY_PRIO_PROTECTED). Protected tracks are
+// played with the voice lock. With a polyphony manager set, the play
+// is refused when the voice budget is full, and the tracks the
+// manager picks are stopped first to keep its reserve free. Returns
+// false if the play was not sent
+bool Tsunami::trackPlayPrio(int trk, int out, int prio) {
+
+#ifndef __TSUNAMI_NO_HOOKS__
+int victim;
+#endif
+
+	if ((trk < 1) || (trk > 4096) || (prio < 0) || (prio >= POLY_PRIO_LEVELS))
+		return false;
+#ifndef __TSUNAMI_NO_HOOKS__
+	if (poly) {
+		if (!poly->admit(sysinfoRcvd ? numVoices : MAX_NUM_VOICES))
+			return false;
+		while ((victim = poly->victim((uint16_t)trk, (uint8_t)prio)) > 0)
+			trackStop(victim);
+		if (!poly->played((uint16_t)trk, (uint8_t)prio))
+			return false;
+	}
+#endif
+	trackPlayPoly(trk, out, prio == POLY_PRIO_PROTECTED);
+	return true;
+}
+
 // **************************************************************
 // Loads track trk (1-4096) and pauses it at the beginning. Can be
 // used for multiple tracks and have them all unpaused at same time
@@ -388,49 +1685,28 @@ void Tsunami::trackLoop(int trk, bool enable) {
 // Private internal function that handles all CMD_TRACK_CONTROL commands
 void Tsunami::trackControl(int trk, int code, int out, int flags) {
   
-uint8_t txbuf[10];
-uint8_t o;
-
-	o = out & 0x07;
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x0a;
-	txbuf[3] = CMD_TRACK_CONTROL;
-	txbuf[4] = (uint8_t)code;
-	txbuf[5] = (uint8_t)trk;
-	txbuf[6] = (uint8_t)(trk >> 8);
-	txbuf[7] = (uint8_t)o;
-	txbuf[8] = (uint8_t)flags;
-	txbuf[9] = EOM;
-	TsunamiSerial.write(txbuf, 10);
+uint8_t txbuf[MsgTrackControl::LEN];
+
+	MsgTrackControl::encode(txbuf, code, trk, out & 0x07, flags);
+#ifndef __TSUNAMI_NO_HOOKS__
+	if (latency)
+		latency->sent((uint16_t)trk, (uint8_t)code);
+#endif
+	writeFrame(txbuf, MsgTrackControl::LEN);
 }
 
 // **************************************************************
 // Immediatly stops playing all tracks
 void Tsunami::stopAllTracks(void) {
 
-uint8_t txbuf[5];
-
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x05;
-	txbuf[3] = CMD_STOP_ALL;
-	txbuf[4] = EOM;
-	TsunamiSerial.write(txbuf, 5);
+	writeConstFrame(TsunamiConstFrame<CMD_STOP_ALL>::data);
 }
 
 // **************************************************************
 // Resumes all paused tracks in sync
 void Tsunami::resumeAllInSync(void) {
 
-uint8_t txbuf[5];
-
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x05;
-	txbuf[3] = CMD_RESUME_ALL_SYNC;
-	txbuf[4] = EOM;
-	TsunamiSerial.write(txbuf, 5);
+	writeConstFrame(TsunamiConstFrame<CMD_RESUME_ALL_SYNC>::data);
 }
 
 // **************************************************************
@@ -448,20 +1724,10 @@ uint8_t txbuf[5];
 // use the TRACK_FADE command instead.
 void Tsunami::trackGain(int trk, int gain) {
 
-uint8_t txbuf[9];
-unsigned short vol;
+uint8_t txbuf[MsgTrackVolume::LEN];
 
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x09;
-	txbuf[3] = CMD_TRACK_VOLUME;
-	txbuf[4] = (uint8_t)trk;
-	txbuf[5] = (uint8_t)(trk >> 8);
-	vol = (unsigned short)gain;
-	txbuf[6] = (uint8_t)vol;
-	txbuf[7] = (uint8_t)(vol >> 8);
-	txbuf[8] = EOM;
-	TsunamiSerial.write(txbuf, 9);
+	MsgTrackVolume::encode(txbuf, trk, (uint16_t)gain);
+	writeFrame(txbuf, MsgTrackVolume::LEN);
 }
 
 // **************************************************************
@@ -475,23 +1741,10 @@ unsigned short vol;
 // will automatically stop the track and release the voice at the end of the fade out.
 void Tsunami::trackFade(int trk, int gain, int time, bool stopFlag) {
 
-uint8_t txbuf[12];
-unsigned short vol;
+uint8_t txbuf[MsgTrackFade::LEN];
 
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x0c;
-	txbuf[3] = CMD_TRACK_FADE;
-	txbuf[4] = (uint8_t)trk;
-	txbuf[5] = (uint8_t)(trk >> 8);
-	vol = (unsigned short)gain;
-	txbuf[6] = (uint8_t)vol;
-	txbuf[7] = (uint8_t)(vol >> 8);
-	txbuf[8] = (uint8_t)time;
-	txbuf[9] = (uint8_t)(time >> 8);
-	txbuf[10] = stopFlag;
-	txbuf[11] = EOM;
-	TsunamiSerial.write(txbuf, 12);
+	MsgTrackFade::encode(txbuf, trk, (uint16_t)gain, time, stopFlag);
+	writeFrame(txbuf, MsgTrackFade::LEN);
 }
 
 // **************************************************************
@@ -503,36 +1756,20 @@ unsigned short vol;
 // speed (one octave pitch shift up.)
 void Tsunami::samplerateOffset(int out, int offset) {
 
-uint8_t txbuf[8];
-unsigned short off;
-uint8_t o;
+uint8_t txbuf[MsgSamplerateOffset::LEN];
 
-	o = out & 0x07;
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x08;
-	txbuf[3] = CMD_SAMPLERATE_OFFSET;
-	txbuf[4] = (uint8_t)o;
-	off = (unsigned short)offset;
-	txbuf[5] = (uint8_t)off;
-	txbuf[6] = (uint8_t)(off >> 8);
-	txbuf[7] = EOM;
-	TsunamiSerial.write(txbuf, 8);
+	MsgSamplerateOffset::encode(txbuf, out & 0x07, (uint16_t)offset);
+	writeFrame(txbuf, MsgSamplerateOffset::LEN);
 }
 
 // **************************************************************
 // Set the trigger bank
 void Tsunami::setTriggerBank(int bank) {
 
-	uint8_t txbuf[6];
+	uint8_t txbuf[MsgSetTriggerBank::LEN];
 
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x06;
-	txbuf[3] = CMD_SET_TRIGGER_BANK;
-	txbuf[4] = (uint8_t)bank;
-	txbuf[5] = EOM;
-	TsunamiSerial.write(txbuf, 6);
+	MsgSetTriggerBank::encode(txbuf, bank);
+	writeFrame(txbuf, MsgSetTriggerBank::LEN);
 }
 
 // **************************************************************
@@ -543,30 +1780,101 @@ void Tsunami::setTriggerBank(int bank) {
 // to the corresponding output pair.
 void Tsunami::setInputMix(int mix) {
 
-	uint8_t txbuf[6];
+	uint8_t txbuf[MsgSetInputMix::LEN];
 
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x06;
-	txbuf[3] = CMD_SET_INPUT_MIX;
-	txbuf[4] = (uint8_t)mix;
-	txbuf[5] = EOM;
-	TsunamiSerial.write(txbuf, 6);
+	MsgSetInputMix::encode(txbuf, mix);
+	writeFrame(txbuf, MsgSetInputMix::LEN);
 }
 
 // **************************************************************
 // Set MIDI bank
 void Tsunami::setMidiBank(int bank) {
 
-	uint8_t txbuf[6];
+	uint8_t txbuf[MsgSetMidiBank::LEN];
+
+	MsgSetMidiBank::encode(txbuf, bank);
+	writeFrame(txbuf, MsgSetMidiBank::LEN);
+}
+
+// **************************************************************
+// Sets every output as pScene holds. Only the settings that differ
+// from the ones last sent (by an earlier scene or by masterGain(),
+// samplerateOffset() and setInputMix()) are sent, all in one write
+// in TX_DIRECT mode. Everything goes after a start() or with
+// __TSUNAMI_NO_SCENES__. If the transmit queue drops frames meanwhile,
+// the settings sent are forgotten (by the coalescer too) and the next
+// scene goes out whole.
+// Returns the bytes sent
+int Tsunami::applyScene(const TsunamiScene *pScene) {
+
+uint8_t buf[SCENE_BLOB_LEN];
+uint16_t dropped = txDropped;
+int len;
+int pos;
+
+#ifdef __TSUNAMI_NO_SCENES__
+	len = pScene->delta(NULL, buf);
+#else
+	len = pScene->delta(&outState, buf);
+#endif
+	if (!len)
+		return 0;
+#ifndef __TSUNAMI_NO_COALESCE__
+	// Held values go first, and the coalescer learns the new ones
+	if (coalescing)
+		coalesceFlush();
+#endif
+	for (pos = 0; pos < len; pos += buf[pos + 2]) {
+#ifndef __TSUNAMI_NO_HOOKS__
+		if (mirror)
+			mirror->sent(buf + pos, buf[pos + 2], millis());
+#endif
+#ifndef __TSUNAMI_NO_SCENES__
+		outState.sent(buf + pos);
+#endif
+#ifndef __TSUNAMI_NO_COALESCE__
+		if (coalescing)
+			coalescer.sent(buf + pos);
+#endif
+		// The queued modes and a batch take the frames one by one
+		if ((txMode != TX_DIRECT) || batchBuf)
+			sendFrame(buf + pos, buf[pos + 2]);
+	}
+	if ((txMode == TX_DIRECT) && !batchBuf)
+		port->write(buf, len);
+	if (txDropped != dropped) {
+#ifndef __TSUNAMI_NO_SCENES__
+		outState.clear();
+#endif
+#ifndef __TSUNAMI_NO_COALESCE__
+		coalescer.forget(NULL);
+#endif
+	}
+	return len;
+}
 
-	txbuf[0] = SOM1;
-	txbuf[1] = SOM2;
-	txbuf[2] = 0x06;
-	txbuf[3] = CMD_SET_MIDI_BANK;
-	txbuf[4] = (uint8_t)bank;
-	txbuf[5] = EOM;
-	TsunamiSerial.write(txbuf, 6);
+// **************************************************************
+// Copies the output settings last sent to the Tsunami into pScene.
+// Settings not sent since start() keep the value pScene held.
+// Returns true if every setting was known
+bool Tsunami::captureScene(TsunamiScene *pScene) {
+
+#ifdef __TSUNAMI_NO_SCENES__
+	(void)pScene;
+	return false;
+#else
+int i;
+
+	for (i = 0; i < TSUNAMI_NUM_OUTPUTS; i++) {
+		if (outState.known & (1UL << i))
+			pScene->setGain(i, outState.gain[i]);
+		if (outState.known & SCENE_KNOWN_RATE(i))
+			pScene->setRate(i, outState.rate[i]);
+	}
+	if (outState.known & SCENE_KNOWN_MIX)
+		pScene->setInputMix(outState.mix);
+	return outState.known == SCENE_KNOWN_ALL;
+#endif
 }
 
 
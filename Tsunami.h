@@ -38,6 +38,105 @@
 #define __TSUNAMI_DEBUG_MODE__
 // ==================================================================
 
+// ==================================================================
+// Footprint: uncomment (or pass with -D on the compiler command line)
+//  the features your sketch does not need, to save their RAM and flash.
+//  The functions stay, so sketches build either way. Run "make footprint"
+//  in extras/host to see what each option saves
+// No track status: isTrackPlaying() and friends always return -1 / 0.
+//  Saves the voice table and the track index
+//#define __TSUNAMI_NO_REPORTING__
+// No track index: isTrackPlaying() and trackVoices() scan the voice
+//  table instead
+//#define __TSUNAMI_NO_TRACK_INDEX__
+// The version string is not kept: getVersion() always returns false
+//#define __TSUNAMI_NO_VERSION__
+// No track report or ready callbacks
+//#define __TSUNAMI_NO_CALLBACKS__
+// Only TX_DIRECT: setTxMode() is ignored
+//#define __TSUNAMI_NO_TX_QUEUE__
+// No coalescing stage: setCoalescing() is ignored
+//#define __TSUNAMI_NO_COALESCE__
+// Only RX_DIRECT: setRxMode() is ignored
+//#define __TSUNAMI_NO_DEFERRED_RX__
+// The output settings sent are not kept: applyScene() always sends
+//  the whole scene and captureScene() does nothing
+//#define __TSUNAMI_NO_SCENES__
+// No receive statistics: getRxStats() always gives zeros and the
+//  dispatcher never sees parser errors
+//#define __TSUNAMI_NO_RX_STATS__
+// The latency monitor, cue list, sync groups, track mirror, voice
+//  monitor and polyphony manager can not be attached: their setters
+//  are ignored and syncStart() always returns false
+//#define __TSUNAMI_NO_HOOKS__
+// All of the above
+//#define __TSUNAMI_FOOTPRINT_MINIMAL__
+// MAX_NUM_VOICES (below) and TSUNAMI_MAX_TRACKS (TsunamiTrackIndex.h) can
+//  be lowered the same way, with -DMAX_NUM_VOICES=8 for example
+// ==================================================================
+
+// ==================================================================
+// On AVR boards (2 KB of RAM on an Uno) the transmit queue, the
+//  coalescer, the deferred receive queue, the track index, the scene
+//  state and the receive statistics are left out unless asked for.
+//  Uncomment (or pass with -D) the ones your sketch uses.
+//  __TSUNAMI_FOOTPRINT_SMALL__ gives the same defaults on other boards
+//#define __TSUNAMI_WITH_TX_QUEUE__
+//#define __TSUNAMI_WITH_COALESCE__
+//#define __TSUNAMI_WITH_DEFERRED_RX__
+//#define __TSUNAMI_WITH_TRACK_INDEX__
+//#define __TSUNAMI_WITH_SCENES__
+//#define __TSUNAMI_WITH_RX_STATS__
+// ==================================================================
+
+#if defined(__AVR__) && !defined(__TSUNAMI_FOOTPRINT_SMALL__)
+#define __TSUNAMI_FOOTPRINT_SMALL__
+#endif
+
+#ifdef __TSUNAMI_FOOTPRINT_SMALL__
+#ifndef __TSUNAMI_WITH_TX_QUEUE__
+#define __TSUNAMI_NO_TX_QUEUE__
+#endif
+#ifndef __TSUNAMI_WITH_COALESCE__
+#define __TSUNAMI_NO_COALESCE__
+#endif
+#ifndef __TSUNAMI_WITH_DEFERRED_RX__
+#define __TSUNAMI_NO_DEFERRED_RX__
+#endif
+#ifndef __TSUNAMI_WITH_TRACK_INDEX__
+#define __TSUNAMI_NO_TRACK_INDEX__
+#endif
+#ifndef __TSUNAMI_WITH_SCENES__
+#define __TSUNAMI_NO_SCENES__
+#endif
+#ifndef __TSUNAMI_WITH_RX_STATS__
+#define __TSUNAMI_NO_RX_STATS__
+#endif
+#endif
+
+#ifdef __TSUNAMI_FOOTPRINT_MINIMAL__
+#define __TSUNAMI_NO_REPORTING__
+#define __TSUNAMI_NO_TRACK_INDEX__
+#define __TSUNAMI_NO_VERSION__
+#define __TSUNAMI_NO_CALLBACKS__
+#define __TSUNAMI_NO_TX_QUEUE__
+#define __TSUNAMI_NO_COALESCE__
+#define __TSUNAMI_NO_DEFERRED_RX__
+#define __TSUNAMI_NO_SCENES__
+#define __TSUNAMI_NO_RX_STATS__
+#define __TSUNAMI_NO_HOOKS__
+#endif
+
+// ==================================================================
+// Off the board (Linux host builds, simulator and benchmarks) there is
+//  no Arduino core. The serial selection above is then ignored and the
+//  library only talks through the TsunamiTransport given to start()
+#ifndef ARDUINO
+#define __TSUNAMI_USE_HOST__
+#undef __TSUNAMI_DEBUG_MODE__
+#endif
+// ==================================================================
+
 #define CMD_GET_VERSION				1
 #define CMD_GET_SYS_INFO			2
 #define CMD_TRACK_CONTROL			3
@@ -66,12 +165,23 @@
 #define	RSP_STATUS					131
 #define	RSP_TRACK_REPORT			132
 
+#ifndef MAX_NUM_VOICES
 #ifdef __TSUNAMI_USE_MONO__
 #define MAX_NUM_VOICES				32
 #else
 #define MAX_NUM_VOICES				18
 #endif
+#endif
 #define MAX_MESSAGE_LEN				32
+// Bytes kept of a received frame. Without the version string the
+// longest frame used is the track report; longer ones are still
+// framed, but only their first bytes are kept (and rescanned)
+#ifdef __TSUNAMI_NO_VERSION__
+#define RX_FRAME_LEN				12
+#else
+#define RX_FRAME_LEN				MAX_MESSAGE_LEN
+#endif
+#define RX_CHUNK_LEN				32
 #define VERSION_STRING_LEN			23
 #define TSUNAMI_NUM_OUTPUTS			8
 
@@ -84,6 +194,52 @@
 #define IMIX_OUT3	0x04
 #define IMIX_OUT4	0x08
 
+// Transmit modes, see setTxMode()
+#define TX_DIRECT				0
+#define TX_QUEUED				1
+#define TX_QUEUED_ISR			2
+
+// Receive modes, see setRxMode()
+#define RX_DIRECT				0
+#define RX_DEFERRED				1
+
+// Start-up handshake states, see getHandshakeState()
+#define HANDSHAKE_IDLE			0
+#define HANDSHAKE_AWAIT_VERSION	1
+#define HANDSHAKE_AWAIT_SYSINFO	2
+#define HANDSHAKE_READY			3
+#define HANDSHAKE_FAILED		4
+
+// Handshake requests are repeated every HANDSHAKE_RETRY_MS, up to
+// HANDSHAKE_TRIES times, which covers the board's own boot time
+#define HANDSHAKE_RETRY_MS		100
+#define HANDSHAKE_TRIES			20
+
+// What a queued command does when the transmit queue is full
+#define TX_OVERFLOW_DROP		0
+#define TX_OVERFLOW_BLOCK		1
+#define TX_OVERFLOW_REPLACE		2
+
+#include "TsunamiTransport.h"
+#include "TsunamiFrame.h"
+#include "TsunamiTxQueue.h"
+#include "TsunamiCoalesce.h"
+#include "TsunamiTrackIndex.h"
+#include "TsunamiEventQueue.h"
+#include "TsunamiLatency.h"
+#include "TsunamiCue.h"
+#include "TsunamiSync.h"
+#include "TsunamiCapture.h"
+#include "TsunamiMirror.h"
+#include "TsunamiVoices.h"
+#include "TsunamiPoly.h"
+#include "TsunamiScene.h"
+#include "TsunamiDispatch.h"
+#include "TsunamiMidi.h"
+
+#ifdef __TSUNAMI_USE_HOST__
+#include "TsunamiHost.h"
+#else
 #ifdef __TSUNAMI_USE_ALTSOFTSERIAL__
 #include "../AltSoftSerial/AltSoftSerial.h"
 #else
@@ -108,24 +264,97 @@
 #define TsunamiSerial Serial
 #endif
 #endif
+#endif
+
+// Protects state shared with interrupt handlers
+#ifdef __TSUNAMI_USE_HOST__
+#define TSUNAMI_ATOMIC_BEGIN()
+#define TSUNAMI_ATOMIC_END()
+#else
+#define TSUNAMI_ATOMIC_BEGIN()	noInterrupts()
+#define TSUNAMI_ATOMIC_END()	interrupts()
+#endif
+
+// Receive statistics, see getRxStats()
+struct TsunamiRxStats {
+	// Complete frames received, by message type
+	uint32_t trackReports;
+	uint32_t versions;
+	uint32_t sysInfos;
+	uint32_t status;
+	// Complete frames with a message type the library does not know
+	uint32_t unknownType;
+	// Bytes outside any frame
+	uint32_t noise;
+	// Frames given up: SOM1 not followed by SOM2
+	uint32_t badSom2;
+	// Frames given up: length byte above MAX_MESSAGE_LEN
+	uint32_t oversize;
+	// Frames given up: length byte too short to hold a message type
+	uint32_t undersize;
+	// Frames given up: no EOM where the length said it would be
+	uint32_t badEom;
+	// Frames given up: length byte wrong for the message type
+	uint32_t badLength;
+	// Frames given up that held the SOM1 the parser restarted from
+	uint32_t resyncs;
+	// Bytes thrown away: the noise and every byte of the frames given up
+	uint32_t bytesDiscarded;
+	// Bytes lost by the transport before they could be read
+	uint32_t overruns;
+	// Messages lost to a full event queue in RX_DEFERRED mode
+	uint32_t eventsDropped;
+};
 
 class Tsunami
 {
 public:
-	Tsunami() {;}
+	Tsunami() : port(NULL), txMode(TX_DIRECT), txOverflow(TX_OVERFLOW_DROP), txDropped(0),
+		batchBuf(NULL), batchLen(0), batchSize(0), coalescing(false), rxMode(RX_DIRECT), eventsDropped(0),
+#ifndef __TSUNAMI_NO_HOOKS__
+		latency(NULL), cues(NULL), sync(NULL), mirror(NULL), voices(NULL), poly(NULL),
+#endif
+#ifndef __TSUNAMI_NO_CALLBACKS__
+		dispatcher(NULL), errorsSeen(0), readyCallback(NULL),
+#endif
+		hsState(HANDSHAKE_IDLE),
+		hsMaxTries(HANDSHAKE_TRIES), hsRetryMs(HANDSHAKE_RETRY_MS) {
+#ifndef __TSUNAMI_NO_TX_QUEUE__
+		txDelay = NULL;
+		txQueue[TX_PRIO_STOP].init(txBuf, TX_QUEUE_STOP_LEN);
+		txQueue[TX_PRIO_PLAY].init(txBuf + TX_QUEUE_STOP_LEN, TX_QUEUE_PLAY_LEN);
+		txQueue[TX_PRIO_BULK].init(txBuf + TX_QUEUE_STOP_LEN + TX_QUEUE_PLAY_LEN, TX_QUEUE_LEN);
+#endif
+	}
 	~Tsunami() {;}
+#ifndef __TSUNAMI_USE_HOST__
 	void start(void);
+#endif
+	void start(TsunamiTransport *pPort);
 	void update(void);
+	int update(int maxBytes, uint32_t maxMicros);
 	void flush(void);
 	void setReporting(bool enable);
 	bool getVersion(char *pDst, int len);
 	int getNumTracks(void);
+	int getNumVoices(void);
+	void setHandshake(int retryMs, int tries);
+	int getHandshakeRetryMs(void) { return hsRetryMs; }
+	void setReadyCallback(void (*pFunc)(bool ready));
+	int getHandshakeState(void) { return hsState; }
+	bool isReady(void) { return hsState == HANDSHAKE_READY; }
+	uint32_t getReadyMs(void) { return readyMs; }
+	void requestInfo(void);
 	int isTrackPlaying(int trk);
+	int trackVoiceCount(int trk);
+	int getVoiceTrack(int voice);
+	TsunamiVoiceMask trackVoices(int trk);
 	void masterGain(int out, int gain);
 	void stopAllTracks(void);
 	void resumeAllInSync(void);
 	void trackPlaySolo(int trk, int out, bool lock);
 	void trackPlayPoly(int trk, int out, bool lock);
+	bool trackPlayPrio(int trk, int out, int prio);
 	void trackLoad(int trk, int out, bool lock);
 	void trackStop(int trk);
 	void trackPause(int trk);
@@ -137,26 +366,178 @@ public:
 	void setTriggerBank(int bank);
 	void setInputMix(int mix);
 	void setMidiBank(int bank);
+	int applyScene(const TsunamiScene *pScene);
+	bool captureScene(TsunamiScene *pScene);
 	void setTrackReportCallback(void (*pFunc)(uint16_t track, uint8_t voice, bool didStart));
+	void setTxMode(int mode, int overflow);
+	int txPump(void);
+	int txPending(void);
+	int txSpace(void);
+	int txSpace(int cls);
+	void setTxDelayMonitor(TsunamiTxDelay *pMon);
+	uint16_t getTxDropped(void) { return txDropped; }
+	void setCoalescing(bool enable, int windowMs);
+	void coalesceFlush(void);
+	void beginBatch(uint8_t *pBuf, int size);
+	void endBatch(void);
+	void getCoalesceStats(TsunamiCoalesceStats *pStats);
+	void resetCoalesceStats(void);
+	void setRxMode(int mode);
+	int rxService(void);
+	uint32_t getEventsDropped(void) { return eventsDropped; }
+#ifdef __TSUNAMI_NO_HOOKS__
+	void setLatencyMonitor(TsunamiLatency *pMon) { (void)pMon; }
+	void setCueList(TsunamiCueList *pCues) { (void)pCues; }
+	void setTrackMirror(TsunamiTrackMirror *pMirror) { (void)pMirror; }
+#else
+	void setLatencyMonitor(TsunamiLatency *pMon) { latency = pMon; }
+	void setCueList(TsunamiCueList *pCues) { cues = pCues; }
+	void setTrackMirror(TsunamiTrackMirror *pMirror) { mirror = pMirror; }
+#endif
+	void setVoiceMonitor(TsunamiVoiceStats *pMon);
+	void setPolyManager(TsunamiPolyManager *pPoly);
+	void setDispatcher(TsunamiDispatcher *pDisp);
+	bool syncStart(TsunamiSyncGroup *pGroup, int timeoutMs);
+	void syncCancel(TsunamiSyncGroup *pGroup);
+	void getRxStats(TsunamiRxStats *pStats);
+	void resetRxStats(void);
 
 private:
 	void trackControl(int trk, int code, int out, int flags);
+	void rxParse(const uint8_t *buf, int len);
+	bool rxStep(uint8_t dat);
+	void rxResync(uint8_t dat);
+	void rxDispatch(void);
+	void rxApply(const TsunamiEvent &ev);
+	uint32_t rxErrors(void);
+	void dispatchErrors(void);
+#ifndef __TSUNAMI_NO_HOOKS__
+	void runCues(void);
+	void syncTimeout(void);
+#endif
+	void handshakeSend(void);
+	void handshakeStep(void);
+	void writeFrame(const uint8_t *frame, int len);
+	void writeConstFrame(const uint8_t *pFrame);
+	void sendFrame(const uint8_t *frame, int len);
+	void txWait(void);
+#ifndef __TSUNAMI_NO_COALESCE__
+	void coalesceSend(const uint8_t *frame, int len);
+#endif
+	int txClass(const uint8_t *frame);
+#ifndef __TSUNAMI_NO_TX_QUEUE__
+	static void txCancelled(void *pCtx, const uint8_t *queued, int pos);
+	void txLost(const uint8_t *frame);
+#endif
 
-#ifdef __TSUNAMI_USE_ALTSOFTSERIAL__
-	AltSoftSerial TsunamiSerial;
+	// The byte stream connected to the Tsunami
+	TsunamiTransport *port;
+#ifndef __TSUNAMI_NO_TX_QUEUE__
+	// Frames waiting to be sent in the queued transmit modes, one
+	// ring per priority class, and their storage
+	TsunamiTxQueue txQueue[TX_PRIO_CLASSES];
+	uint8_t txBuf[TX_QUEUE_STOP_LEN + TX_QUEUE_PLAY_LEN + TX_QUEUE_LEN];
+	// Times queued frames to the port, NULL when not used
+	TsunamiTxDelay *txDelay;
+#endif
+	// Transmit mode (TX_DIRECT, TX_QUEUED, TX_QUEUED_ISR)
+	uint8_t txMode;
+	// What to do with a frame that does not fit in its txQueue ring
+	uint8_t txOverflow;
+	// Number of frames lost to a full txQueue ring
+	uint16_t txDropped;
+	// Frames held back by beginBatch() in TX_DIRECT mode, or NULL
+	uint8_t *batchBuf;
+	uint8_t batchLen;
+	uint8_t batchSize;
+#ifndef __TSUNAMI_NO_COALESCE__
+	// Holds back redundant gain and samplerate frames
+	TsunamiCoalescer coalescer;
+#endif
+	// Bool indicating that frames pass through the coalescer
+	bool coalescing;
+#ifndef __TSUNAMI_NO_SCENES__
+	// Output settings last sent, for applyScene()
+	TsunamiOutputState outState;
+#endif
+#ifndef __TSUNAMI_NO_DEFERRED_RX__
+	// Decoded messages waiting for update() in RX_DEFERRED mode
+	TsunamiEventQueue events;
+#endif
+	// Receive mode (RX_DIRECT, RX_DEFERRED)
+	uint8_t rxMode;
+	// Number of messages lost to a full event queue
+	volatile uint32_t eventsDropped;
+#ifndef __TSUNAMI_NO_HOOKS__
+	// Times commands to their track reports, NULL when not used
+	TsunamiLatency *latency;
+	// Scheduled cues sent by update(), NULL when not used
+	TsunamiCueList *cues;
+	// Sync group waiting for its loads to be confirmed, or NULL
+	TsunamiSyncGroup *sync;
+	// Per-track state kept from the commands and reports, or NULL
+	TsunamiTrackMirror *mirror;
+	// Voice occupancy and steals from the track reports, or NULL
+	TsunamiVoiceStats *voices;
+	// Voice budget and priorities for trackPlayPrio(), or NULL
+	TsunamiPolyManager *poly;
+#endif
+#ifndef __TSUNAMI_NO_CALLBACKS__
+	// Listeners for the received events, or NULL
+	TsunamiDispatcher *dispatcher;
+	// Parser errors already dispatched. Kept per board, as several
+	// boards may share one dispatcher
+	uint32_t errorsSeen;
+	// Called when the start-up handshake succeeds or fails
+	void (*readyCallback)(bool ready);
+#endif
+	// Start-up handshake state (HANDSHAKE_IDLE ... HANDSHAKE_FAILED)
+	uint8_t hsState;
+	// Requests sent so far and the most allowed
+	uint8_t hsTries;
+	uint8_t hsMaxTries;
+	// Milliseconds to wait for an answer before asking again
+	uint16_t hsRetryMs;
+	// millis() at the start of the handshake and at the last request
+	uint32_t hsStartMs;
+	uint32_t hsSentMs;
+	// Milliseconds from start() to HANDSHAKE_READY (or HANDSHAKE_FAILED)
+	uint32_t readyMs;
+#ifndef __TSUNAMI_NO_RX_STATS__
+	// Receive statistics, counted where the bytes are parsed
+	TsunamiRxStats rxStats;
+	// Transport overruns and dropped events at the last resetRxStats()
+	uint32_t overrunBase;
+	uint32_t eventsDroppedBase;
 #endif
 
+#ifndef __TSUNAMI_NO_CALLBACKS__
 	// The callback that is called when a TRACK_REPORT message is received
 	void (*trackReportCallback) (uint16_t track, uint8_t voice, bool didStart);
+#endif
 
 	// State variables
+#ifndef __TSUNAMI_NO_REPORTING__
 	// Voice table: array of track numbers (numbered 1-4096)
 	// Each index represents a single voice, which is either a mono (0-31) or stereo (0-17) track depending on config
 	uint16_t voiceTable[MAX_NUM_VOICES];
-	// A buffer for the last received rx message payload
-	uint8_t rxMessage[MAX_MESSAGE_LEN];
+#ifndef __TSUNAMI_NO_TRACK_INDEX__
+	// Reverse of voiceTable: the voices each track plays on
+	TsunamiTrackIndex trackIndex;
+#endif
+#endif
+	// The frame being received, from SOM1 on
+	uint8_t rxFrame[RX_FRAME_LEN];
+#ifndef __TSUNAMI_NO_VERSION__
 	// String containing the version string, which is set by Tsunami upon initialization
 	char version[VERSION_STRING_LEN];
+#ifndef __TSUNAMI_NO_DEFERRED_RX__
+	// Version string as received, handed from the receive side to the main loop
+	char versionStage[VERSION_STRING_LEN - 1];
+	// Set while versionStage holds a string the main loop has not copied yet
+	uint8_t versionStaged;
+#endif
+#endif
 	// Short containing # of tracks, which is set by Tsunami upon initialization
 	uint16_t numTracks;
 	// Byte containing # of voices, which is set by Tsunami upon initialization
@@ -165,12 +546,28 @@ private:
 	uint8_t rxCount;
 	// Variable that contains the message length indicated in byte 2 of every rx message
 	uint8_t rxLen;
-	// Bool indicating that there is a valid message ready to be received
-	bool rxMsgReady;
 	// Bool indicating that a valid version string has been received, located in version
 	bool versionRcvd;
 	// Bool indicating that valid system info has been received in numTracks and numVoices
 	bool sysinfoRcvd;
 };
 
+// **************************************************************
+// A Tsunami that owns the serial port it talks through. Declare one
+// per board to drive several boards from one controller, each on its
+// own port with its own receive state:
+//   TsunamiBoard<HardwareSerial> left(Serial1);
+//   TsunamiBoard<HardwareSerial> right(Serial2);
+template <class T>
+class TsunamiBoard : public Tsunami
+{
+public:
+	TsunamiBoard(T &s) : link(s) {;}
+	using Tsunami::start;
+	void start(void) { Tsunami::start(&link); }
+
+private:
+	TsunamiStreamTransport<T> link;
+};
+
 #endif
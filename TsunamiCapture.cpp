@@ -0,0 +1,172 @@
+// **************************************************************
+//     Filename: TsunamiCapture.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Record and replay of the serial traffic
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+#ifndef __TSUNAMI_USE_HOST__
+#include <Arduino.h>
+#endif
+
+// **************************************************************
+// Starts the captured transport and writes the log header
+void TsunamiCapture::begin(uint32_t baud) {
+
+static const uint8_t header[CAPTURE_HEADER_LEN] =
+	{ CAPTURE_MAGIC_0, CAPTURE_MAGIC_1, CAPTURE_MAGIC_2, CAPTURE_VERSION };
+
+	link->begin(baud);
+	if (!started) {
+		logLost += CAPTURE_HEADER_LEN - log->write(header, CAPTURE_HEADER_LEN);
+		lastUs = clock ? clock() : micros();
+		started = true;
+	}
+}
+
+// **************************************************************
+int TsunamiCapture::read(void) {
+
+int dat = link->read();
+uint8_t b;
+
+	if (dat >= 0) {
+		b = (uint8_t)dat;
+		record(0, &b, 1);
+	}
+	return dat;
+}
+
+// **************************************************************
+int TsunamiCapture::readBytes(uint8_t *buf, int len) {
+
+int n = link->readBytes(buf, len);
+
+	if (n > 0)
+		record(0, buf, n);
+	return n;
+}
+
+// **************************************************************
+size_t TsunamiCapture::write(const uint8_t *buf, size_t len) {
+
+size_t n = link->write(buf, len);
+
+	if (n > 0)
+		record(CAPTURE_TX, buf, (int)n);
+	return n;
+}
+
+// **************************************************************
+// Private internal function that logs len bytes in records of at
+// most CAPTURE_RECORD_MAX bytes, each written to the log in one go
+void TsunamiCapture::record(uint8_t dir, const uint8_t *buf, int len) {
+
+uint8_t rec[1 + 5 + CAPTURE_RECORD_MAX];
+uint32_t now = clock ? clock() : micros();
+uint32_t dt = now - lastUs;
+int hdr;
+int n;
+
+	lastUs = now;
+	while (len > 0) {
+		n = (len > CAPTURE_RECORD_MAX) ? CAPTURE_RECORD_MAX : len;
+		rec[0] = dir | (uint8_t)(n - 1);
+		hdr = 1;
+		while (dt >= 0x80) {
+			rec[hdr++] = (uint8_t)(dt | 0x80);
+			dt >>= 7;
+		}
+		rec[hdr++] = (uint8_t)dt;
+		memcpy(rec + hdr, buf, n);
+		logLost += (hdr + n) - log->write(rec, hdr + n);
+		buf += n;
+		len -= n;
+		dt = 0;
+	}
+}
+
+// **************************************************************
+// Starts over at the first record. A log without the right header
+// replays as empty
+void TsunamiReplay::rewind(void) {
+
+	valid = (logLen >= CAPTURE_HEADER_LEN) && (log[0] == CAPTURE_MAGIC_0) &&
+		(log[1] == CAPTURE_MAGIC_1) && (log[2] == CAPTURE_MAGIC_2) &&
+		(log[3] == CAPTURE_VERSION);
+	pos = valid ? CAPTURE_HEADER_LEN : logLen;
+	timeUs = 0;
+	txBytes = 0;
+	left = 0;
+}
+
+// **************************************************************
+// Private internal function that returns the bytes left in the
+// current received record, moving on to the next received record
+// when it is used up. Sent records are skipped
+int TsunamiReplay::nextRx(void) {
+
+uint8_t tag;
+uint32_t dt;
+int shift;
+int len;
+
+	while (left == 0) {
+		if (pos >= logLen)
+			return 0;
+		tag = log[pos++];
+		dt = 0;
+		shift = 0;
+		while ((pos < logLen) && (log[pos] & 0x80)) {
+			dt |= (uint32_t)(log[pos++] & 0x7f) << shift;
+			shift += 7;
+			// More than a 32 bit time: the record is damaged
+			if (shift > 28)
+				pos = logLen;
+		}
+		if (pos >= logLen)
+			return 0;
+		dt |= (uint32_t)log[pos++] << shift;
+		timeUs += dt;
+		len = (tag & 0x7f) + 1;
+		// A record cut short ends the log
+		if ((pos + len) > logLen) {
+			pos = logLen;
+			return 0;
+		}
+		if (tag & CAPTURE_TX) {
+			txBytes += len;
+			pos += len;
+		}
+		else
+			left = (uint8_t)len;
+	}
+	return left;
+}
+
+// **************************************************************
+int TsunamiReplay::read(void) {
+
+	if (nextRx() == 0)
+		return -1;
+	left--;
+	return log[pos++];
+}
+
+// **************************************************************
+// Reads up to len bytes, never across the end of a record, so the
+// bytes read together share one time stamp
+int TsunamiReplay::readBytes(uint8_t *buf, int len) {
+
+int n = nextRx();
+
+	if (n > len)
+		n = len;
+	memcpy(buf, log + pos, n);
+	pos += n;
+	left -= n;
+	return n;
+}
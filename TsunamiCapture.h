@@ -0,0 +1,102 @@
+// **************************************************************
+//     Filename: TsunamiCapture.h
+// Date Created: 10/17/2026
+//
+//     Comments: Record and replay of the serial traffic. A
+//               TsunamiCapture sits between the library and its
+//               transport and logs every frame written and every
+//               block of bytes read, with time stamps, into a
+//               compact binary log. A TsunamiReplay is a transport
+//               that plays the received side of such a log back
+//               into Tsunami::update() at full speed.
+//
+//               Log format: the 4 byte header CAPTURE_MAGIC, then
+//               records of
+//                 tag:   bit 7 set for sent bytes, clear for
+//                        received bytes; bits 0-6 hold length - 1
+//                 time:  microseconds since the previous record,
+//                        7 bits per byte, LSB first, bit 7 set in
+//                        every byte but the last
+//                 bytes: length bytes of traffic
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_CAPTURE_H_
+#define _TSUNAMI_CAPTURE_H_
+
+#include <stdint.h>
+#include "TsunamiTransport.h"
+
+#define CAPTURE_MAGIC_0				'T'
+#define CAPTURE_MAGIC_1				'S'
+#define CAPTURE_MAGIC_2				'C'
+#define CAPTURE_VERSION				1
+#define CAPTURE_HEADER_LEN			4
+#define CAPTURE_TX					0x80
+// Longest block of bytes in one record
+#define CAPTURE_RECORD_MAX			128
+
+class TsunamiCapture : public TsunamiTransport
+{
+public:
+	TsunamiCapture(TsunamiTransport *pLink, TsunamiTransport *pLog) :
+		link(pLink), log(pLog), clock(0), lastUs(0), logLost(0), started(false) {;}
+	void setClock(uint32_t (*pFunc)(void)) { clock = pFunc; }
+	uint32_t getLogLost(void) { return logLost; }
+
+	// TsunamiTransport
+	void begin(uint32_t baud);
+	int available(void) { return link->available(); }
+	int read(void);
+	int readBytes(uint8_t *buf, int len);
+	size_t write(const uint8_t *buf, size_t len);
+	int availableForWrite(void) { return link->availableForWrite(); }
+	uint32_t getOverruns(void) { return link->getOverruns(); }
+
+private:
+	void record(uint8_t dir, const uint8_t *buf, int len);
+
+	// The transport being captured and the one the log goes to
+	TsunamiTransport *link;
+	TsunamiTransport *log;
+	uint32_t (*clock)(void);
+	uint32_t lastUs;
+	// Log bytes the log transport did not take
+	uint32_t logLost;
+	bool started;
+};
+
+class TsunamiReplay : public TsunamiTransport
+{
+public:
+	TsunamiReplay(const uint8_t *pLog, uint32_t len) : log(pLog), logLen(len) { rewind(); }
+	bool isValid(void) const { return valid; }
+	void rewind(void);
+	bool done(void) { return nextRx() == 0; }
+	// Time stamp, in microseconds from the first record, of the bytes
+	// read last
+	uint32_t getTimeUs(void) const { return timeUs; }
+	// Sent bytes in the part of the log replayed so far
+	uint32_t getTxBytes(void) const { return txBytes; }
+
+	// TsunamiTransport
+	int available(void) { return nextRx(); }
+	int read(void);
+	int readBytes(uint8_t *buf, int len);
+	// What the library sends during a replay goes nowhere
+	size_t write(const uint8_t *buf, size_t len) { (void)buf; return len; }
+
+private:
+	int nextRx(void);
+
+	const uint8_t *log;
+	uint32_t logLen;
+	// Offset of the next record and the bytes left in the current one
+	uint32_t pos;
+	uint32_t timeUs;
+	uint32_t txBytes;
+	uint8_t left;
+	bool valid;
+};
+
+#endif
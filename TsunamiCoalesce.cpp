@@ -0,0 +1,242 @@
+// **************************************************************
+//     Filename: TsunamiCoalesce.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Coalescing stage for gain and samplerate frames
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+#define COALESCE_TRACK_MASK		(COALESCE_TRACKS - 1)
+
+// **************************************************************
+TsunamiCoalescer::TsunamiCoalescer() {
+
+	windowMs = 0;
+	reset();
+	resetStats();
+}
+
+// **************************************************************
+// Forgets every value sent and discards pending updates. Used when
+// the board state is unknown, e.g. after it has been (re)started
+void TsunamiCoalescer::reset(void) {
+
+int i;
+
+	for (i = 0; i < COALESCE_OUTPUTS; i++) {
+		master[i].known = false;
+		master[i].pending = false;
+		rate[i].known = false;
+		rate[i].pending = false;
+	}
+	for (i = 0; i < COALESCE_TRACKS; i++) {
+		track[i].known = false;
+		track[i].pending = false;
+		trackNum[i] = 0;
+	}
+	numPending = 0;
+}
+
+// **************************************************************
+void TsunamiCoalescer::resetStats(void) {
+
+	stats.suppressed = 0;
+	stats.merged = 0;
+	stats.bytesSaved = 0;
+}
+
+// **************************************************************
+// Offers a frame to the coalescing stage. Returns true if the frame
+// was held as pending or dropped, false if it must be sent now (after
+// any pending frames, to keep the command order)
+bool TsunamiCoalescer::absorb(const uint8_t *frame, int len, uint32_t nowMs) {
+
+uint16_t trk;
+int slot;
+
+	switch (frame[3]) {
+		case CMD_MASTER_VOLUME:
+			return absorbTarget(&master[frame[4] & 0x07],
+				(int16_t)(frame[5] | (frame[6] << 8)), len, nowMs);
+		case CMD_SAMPLERATE_OFFSET:
+			return absorbTarget(&rate[frame[4] & 0x07],
+				(int16_t)(frame[5] | (frame[6] << 8)), len, nowMs);
+		case CMD_TRACK_VOLUME:
+			trk = frame[4] | (frame[5] << 8);
+			slot = trk & COALESCE_TRACK_MASK;
+			if (trackNum[slot] != trk) {
+				// A slot with a pending value for another track is
+				// taken over only once this frame has been sent
+				if (track[slot].pending)
+					return false;
+				trackNum[slot] = trk;
+				track[slot].known = false;
+			}
+			return absorbTarget(&track[slot],
+				(int16_t)(frame[6] | (frame[7] << 8)), len, nowMs);
+	}
+	return false;
+}
+
+// **************************************************************
+// Private: coalescing rules for one target
+bool TsunamiCoalescer::absorbTarget(Target *pT, int16_t value, int len, uint32_t nowMs) {
+
+	if (pT->pending) {
+		// One of the two frames for this target never goes out
+		stats.merged++;
+		stats.bytesSaved += len;
+		if (pT->known && (value == pT->sent)) {
+			// Back to the value already on the board
+			stats.suppressed++;
+			stats.bytesSaved += len;
+			pT->pending = false;
+			numPending--;
+		}
+		else
+			pT->pend = value;
+		return true;
+	}
+	if (pT->known && (value == pT->sent)) {
+		stats.suppressed++;
+		stats.bytesSaved += len;
+		return true;
+	}
+	if (windowMs == 0)
+		return false;
+	pT->pend = value;
+	pT->pending = true;
+	if (numPending++ == 0)
+		windowStart = nowMs;
+	return true;
+}
+
+// **************************************************************
+// Records a frame that has been sent to the board
+void TsunamiCoalescer::sent(const uint8_t *frame) {
+
+uint16_t trk;
+int slot;
+Target *pT;
+
+	switch (frame[3]) {
+		case CMD_MASTER_VOLUME:
+		case CMD_SAMPLERATE_OFFSET:
+			if (frame[3] == CMD_MASTER_VOLUME)
+				pT = &master[frame[4] & 0x07];
+			else
+				pT = &rate[frame[4] & 0x07];
+			pT->sent = (int16_t)(frame[5] | (frame[6] << 8));
+			pT->known = true;
+		break;
+		case CMD_TRACK_VOLUME:
+			trk = frame[4] | (frame[5] << 8);
+			slot = trk & COALESCE_TRACK_MASK;
+			trackNum[slot] = trk;
+			track[slot].sent = (int16_t)(frame[6] | (frame[7] << 8));
+			track[slot].known = true;
+		break;
+		case CMD_TRACK_FADE:
+			// The track gain now moves on its own
+			trk = frame[4] | (frame[5] << 8);
+			slot = trk & COALESCE_TRACK_MASK;
+			if (trackNum[slot] == trk)
+				track[slot].known = false;
+		break;
+	}
+}
+
+// **************************************************************
+// Forgets the value of the target of a frame recorded by sent() that
+// never reached the board, so the next write to it goes out. NULL
+// forgets every value sent. Pending values are kept
+void TsunamiCoalescer::forget(const uint8_t *frame) {
+
+uint16_t trk;
+int i;
+
+	if (!frame) {
+		for (i = 0; i < COALESCE_OUTPUTS; i++) {
+			master[i].known = false;
+			rate[i].known = false;
+		}
+		for (i = 0; i < COALESCE_TRACKS; i++)
+			track[i].known = false;
+		return;
+	}
+	switch (frame[3]) {
+		case CMD_MASTER_VOLUME:
+			master[frame[4] & 0x07].known = false;
+		break;
+		case CMD_SAMPLERATE_OFFSET:
+			rate[frame[4] & 0x07].known = false;
+		break;
+		case CMD_TRACK_VOLUME:
+			trk = frame[4] | (frame[5] << 8);
+			if (trackNum[trk & COALESCE_TRACK_MASK] == trk)
+				track[trk & COALESCE_TRACK_MASK].known = false;
+		break;
+	}
+}
+
+// **************************************************************
+// Returns true when pending frames have waited a full window
+bool TsunamiCoalescer::due(uint32_t nowMs) {
+
+	return numPending && ((uint32_t)(nowMs - windowStart) >= windowMs);
+}
+
+// **************************************************************
+// Encodes the next pending frame into pDst and marks it sent.
+// Returns the frame length, or 0 when nothing is pending
+int TsunamiCoalescer::takePending(uint8_t *pDst) {
+
+int i;
+Target *pT = NULL;
+uint8_t cmd = 0;
+uint16_t target = 0;
+int len;
+
+	if (numPending == 0)
+		return 0;
+	for (i = 0; (i < COALESCE_OUTPUTS) && !pT; i++) {
+		if (master[i].pending) {
+			pT = &master[i];
+			cmd = CMD_MASTER_VOLUME;
+			target = i;
+		}
+		else if (rate[i].pending) {
+			pT = &rate[i];
+			cmd = CMD_SAMPLERATE_OFFSET;
+			target = i;
+		}
+	}
+	for (i = 0; (i < COALESCE_TRACKS) && !pT; i++) {
+		if (track[i].pending) {
+			pT = &track[i];
+			cmd = CMD_TRACK_VOLUME;
+			target = trackNum[i];
+		}
+	}
+	if (!pT)
+		return 0;
+	if (cmd == CMD_TRACK_VOLUME) {
+		MsgTrackVolume::encode(pDst, target, (uint16_t)pT->pend);
+		len = MsgTrackVolume::LEN;
+	}
+	else if (cmd == CMD_MASTER_VOLUME) {
+		MsgMasterVolume::encode(pDst, (uint8_t)target, (uint16_t)pT->pend);
+		len = MsgMasterVolume::LEN;
+	}
+	else {
+		MsgSamplerateOffset::encode(pDst, (uint8_t)target, (uint16_t)pT->pend);
+		len = MsgSamplerateOffset::LEN;
+	}
+	pT->sent = pT->pend;
+	pT->known = true;
+	pT->pending = false;
+	numPending--;
+	return len;
+}
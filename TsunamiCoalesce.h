@@ -0,0 +1,69 @@
+// **************************************************************
+//     Filename: TsunamiCoalesce.h
+// Date Created: 10/17/2026
+//
+//     Comments: Coalescing stage for track gain, master gain and
+//               samplerate offset frames. Remembers the last value
+//               sent to each target, drops writes that would not
+//               change anything and merges updates that are
+//               superseded before the flush window ends.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_COALESCE_H_
+#define _TSUNAMI_COALESCE_H_
+
+#include <stdint.h>
+
+// Number of tracks whose last gain is remembered. Tracks share the
+// slots by (track % COALESCE_TRACKS). Must be a power of 2
+#ifndef COALESCE_TRACKS
+#define COALESCE_TRACKS			16
+#endif
+#define COALESCE_OUTPUTS		8
+
+struct TsunamiCoalesceStats {
+	// Frames dropped because they repeated the value already sent
+	uint32_t suppressed;
+	// Pending frames replaced by a newer value for the same target
+	uint32_t merged;
+	// Bytes kept off the wire by the two above
+	uint32_t bytesSaved;
+};
+
+class TsunamiCoalescer
+{
+public:
+	TsunamiCoalescer();
+	void setWindow(uint16_t ms) { windowMs = ms; }
+	void reset(void);
+	bool absorb(const uint8_t *frame, int len, uint32_t nowMs);
+	void sent(const uint8_t *frame);
+	void forget(const uint8_t *frame);
+	bool due(uint32_t nowMs);
+	int takePending(uint8_t *pDst);
+	void getStats(TsunamiCoalesceStats *pStats) { *pStats = stats; }
+	void resetStats(void);
+
+private:
+	// Last sent and pending value of one target
+	struct Target {
+		int16_t sent;
+		int16_t pend;
+		bool known;
+		bool pending;
+	};
+
+	bool absorbTarget(Target *pT, int16_t value, int len, uint32_t nowMs);
+
+	Target master[COALESCE_OUTPUTS];
+	Target rate[COALESCE_OUTPUTS];
+	Target track[COALESCE_TRACKS];
+	uint16_t trackNum[COALESCE_TRACKS];
+	TsunamiCoalesceStats stats;
+	uint32_t windowStart;
+	uint16_t windowMs;
+	uint8_t numPending;
+};
+
+#endif
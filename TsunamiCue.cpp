@@ -0,0 +1,248 @@
+// **************************************************************
+//     Filename: TsunamiCue.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Cue list scheduler
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+// Bytes of the time stamp in front of every blob record
+#define CUE_TIME_LEN				4
+
+// **************************************************************
+// Drops every cue, the blob included, and clears the lateness
+// histogram
+void TsunamiCueList::clear(void) {
+
+	heapCount = 0;
+	seqNext = 0;
+	blob = 0;
+	blobLen = 0;
+	blobPos = 0;
+	startUs = 0;
+	dispatched = 0;
+	running = false;
+	lateness.clear();
+}
+
+// **************************************************************
+// Private: true if cue a goes out before cue b. Cue times count from
+// start() and only move forward, so they compare unsigned. Cues due
+// at the same time go out in the order they were added
+bool TsunamiCueList::before(const Cue &a, const Cue &b) {
+
+	if (a.atUs != b.atUs)
+		return a.atUs < b.atUs;
+	return a.seq < b.seq;
+}
+
+// **************************************************************
+// Adds a complete frame (SOM1 ... EOM, length in byte 2) to be sent
+// atUs microseconds after start(). Cues added for the same time go
+// out in the order they were added. Returns false if the frame is
+// too long or the heap is full
+bool TsunamiCueList::add(uint32_t atUs, const uint8_t *frame) {
+
+Cue cue;
+int i;
+int parent;
+int len = frame[2];
+
+	if ((len > CUE_FRAME_LEN) || (heapCount >= CUE_HEAP_LEN))
+		return false;
+	cue.atUs = atUs;
+	cue.seq = seqNext++;
+	memcpy(cue.frame, frame, len);
+	// Sift up from the new leaf
+	i = heapCount++;
+	while (i > 0) {
+		parent = (i - 1) >> 1;
+		if (!before(cue, heap[parent]))
+			break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = cue;
+	return true;
+}
+
+// **************************************************************
+// Encoding helpers: each builds the frame now, so nothing is left
+// to encode when the cue is due
+bool TsunamiCueList::addTrack(uint32_t atUs, int code, int trk, int out, bool lock) {
+
+uint8_t frame[MsgTrackControl::LEN];
+
+	MsgTrackControl::encode(frame, code, trk, out & 0x07, lock ? 0x01 : 0x00);
+	return add(atUs, frame);
+}
+
+bool TsunamiCueList::addFade(uint32_t atUs, int trk, int gain, int time, bool stopFlag) {
+
+uint8_t frame[MsgTrackFade::LEN];
+
+	MsgTrackFade::encode(frame, trk, gain, time, stopFlag ? 0x01 : 0x00);
+	return add(atUs, frame);
+}
+
+bool TsunamiCueList::addTrackGain(uint32_t atUs, int trk, int gain) {
+
+uint8_t frame[MsgTrackVolume::LEN];
+
+	MsgTrackVolume::encode(frame, trk, gain);
+	return add(atUs, frame);
+}
+
+bool TsunamiCueList::addMasterGain(uint32_t atUs, int out, int gain) {
+
+uint8_t frame[MsgMasterVolume::LEN];
+
+	MsgMasterVolume::encode(frame, out & 0x07, gain);
+	return add(atUs, frame);
+}
+
+// **************************************************************
+// Uses the len byte cue blob at pBlob (in flash on AVR) besides the
+// cues in RAM. The blob is read in place and must stay valid
+void TsunamiCueList::loadBlob(const uint8_t *pBlob, uint16_t len) {
+
+	blob = pBlob;
+	blobLen = len;
+	blobPos = 0;
+}
+
+// **************************************************************
+// Starts the show: cue times count from nowUs
+void TsunamiCueList::start(uint32_t nowUs) {
+
+	startUs = nowUs;
+	blobPos = 0;
+	running = true;
+}
+
+// **************************************************************
+// Number of cues not sent yet, including the blob records
+int TsunamiCueList::pending(void) const {
+
+int n = heapCount;
+uint16_t pos = blobPos;
+uint8_t len;
+
+	while ((pos + CUE_TIME_LEN + TSUNAMI_FRAME_OVERHEAD) <= blobLen) {
+		tsunamiCopyP(&len, blob + pos + CUE_TIME_LEN + 2, 1);
+		if ((len < TSUNAMI_FRAME_OVERHEAD) || (len > CUE_FRAME_LEN))
+			break;
+		pos += CUE_TIME_LEN + len;
+		n++;
+	}
+	return n;
+}
+
+// **************************************************************
+// Private internal function that reads the time of the next blob
+// record. Returns false when the blob is used up
+bool TsunamiCueList::blobPeek(uint32_t *pAt) {
+
+uint8_t t[CUE_TIME_LEN];
+
+	if ((blobPos + CUE_TIME_LEN + TSUNAMI_FRAME_OVERHEAD) > blobLen)
+		return false;
+	tsunamiCopyP(t, blob + blobPos, CUE_TIME_LEN);
+	*pAt = t[0] | ((uint32_t)t[1] << 8) | ((uint32_t)t[2] << 16) | ((uint32_t)t[3] << 24);
+	return true;
+}
+
+// **************************************************************
+// Private internal function that removes the earliest cue from the
+// heap
+void TsunamiCueList::heapPop(void) {
+
+Cue last;
+int i = 0;
+int child;
+
+	last = heap[--heapCount];
+	// Sift the last leaf down from the root
+	for (;;) {
+		child = (i << 1) + 1;
+		if (child >= heapCount)
+			break;
+		if (((child + 1) < heapCount) && before(heap[child + 1], heap[child]))
+			child++;
+		if (before(last, heap[child]))
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = last;
+}
+
+// **************************************************************
+// Microseconds until the next cue is due (0 or less when one is
+// due now), or INT32_MAX when nothing is waiting or the next cue is
+// further away than that
+int32_t TsunamiCueList::untilNextUs(uint32_t nowUs) {
+
+uint32_t at;
+uint32_t t = nowUs - startUs;
+bool any;
+
+	if (!running)
+		return INT32_MAX;
+	any = blobPeek(&at);
+	if (heapCount && (!any || (heap[0].atUs < at))) {
+		at = heap[0].atUs;
+		any = true;
+	}
+	if (!any)
+		return INT32_MAX;
+	if (at <= t)
+		return ((t - at) < INT32_MAX) ? -(int32_t)(t - at) : -INT32_MAX;
+	return ((at - t) < INT32_MAX) ? (int32_t)(at - t) : INT32_MAX;
+}
+
+// **************************************************************
+// Copies the earliest cue that is due at nowUs into pDst (which
+// must hold CUE_FRAME_LEN bytes) and counts its lateness. Returns
+// the frame length, or 0 if no cue is due. Cues due at the same time
+// go out in blob order, RAM cues first
+int TsunamiCueList::next(uint32_t nowUs, uint8_t *pDst) {
+
+uint32_t t = nowUs - startUs;
+uint32_t at;
+uint8_t len;
+bool fromBlob;
+
+	if (!running)
+		return 0;
+	fromBlob = blobPeek(&at);
+	if (heapCount && (!fromBlob || (heap[0].atUs <= at))) {
+		at = heap[0].atUs;
+		fromBlob = false;
+	}
+	else if (!fromBlob)
+		return 0;
+	if (t < at)
+		return 0;
+	if (fromBlob) {
+		tsunamiCopyP(&len, blob + blobPos + CUE_TIME_LEN + 2, 1);
+		// A damaged record ends the blob
+		if ((len < TSUNAMI_FRAME_OVERHEAD) || (len > CUE_FRAME_LEN) ||
+				((blobPos + CUE_TIME_LEN + len) > blobLen)) {
+			blobPos = blobLen;
+			return 0;
+		}
+		tsunamiCopyP(pDst, blob + blobPos + CUE_TIME_LEN, len);
+		blobPos += CUE_TIME_LEN + len;
+	}
+	else {
+		len = heap[0].frame[2];
+		memcpy(pDst, heap[0].frame, len);
+		heapPop();
+	}
+	lateness.add(t - at);
+	dispatched++;
+	return len;
+}
@@ -0,0 +1,107 @@
+// **************************************************************
+//     Filename: TsunamiCue.h
+// Date Created: 10/17/2026
+//
+//     Comments: Cue list scheduler. Holds commands timestamped in
+//               microseconds from the start of a show, encoded when
+//               they are added, and hands them to Tsunami::update()
+//               when they are due. Cues come from a min-heap in RAM
+//               and/or a time-sorted blob of pre-encoded frames in
+//               flash. How late each cue went out is counted in a
+//               histogram. Cue times are 32 bit microseconds from
+//               start(), so a show lasts at most 71 minutes.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_CUE_H_
+#define _TSUNAMI_CUE_H_
+
+#include <stdint.h>
+#include "TsunamiLatency.h"
+
+// Cues that can be added at run time. The cues of a flash blob do
+// not take any of these
+#ifndef CUE_HEAP_LEN
+#define CUE_HEAP_LEN				32
+#endif
+// Longest frame a cue can hold (CMD_TRACK_FADE)
+#define CUE_FRAME_LEN				12
+
+// **************************************************************
+// Cue blob records: the cue time in microseconds (4 bytes, LSB
+// first) followed by the complete frame. Records must be sorted by
+// time. For example:
+//   const uint8_t show[] PROGMEM = {
+//       TSUNAMI_CUE_PLAY_POLY(0, 1, 0),
+//       TSUNAMI_CUE_FADE(2000000, 1, -40, 1000, 1),
+//       TSUNAMI_CUE_STOP_ALL(5000000)
+//   };
+#define TSUNAMI_CUE_U16(v)			(uint8_t)(v), (uint8_t)((v) >> 8)
+#define TSUNAMI_CUE_TIME(us)		TSUNAMI_CUE_U16((uint32_t)(us)), TSUNAMI_CUE_U16((uint32_t)(us) >> 16)
+#define TSUNAMI_CUE_TRACK(us, code, trk, out, flags) \
+	TSUNAMI_CUE_TIME(us), SOM1, SOM2, 0x0a, CMD_TRACK_CONTROL, (code), \
+	TSUNAMI_CUE_U16(trk), (uint8_t)((out) & 0x07), (flags), EOM
+#define TSUNAMI_CUE_PLAY_SOLO(us, trk, out)	TSUNAMI_CUE_TRACK(us, TRK_PLAY_SOLO, trk, out, 0)
+#define TSUNAMI_CUE_PLAY_POLY(us, trk, out)	TSUNAMI_CUE_TRACK(us, TRK_PLAY_POLY, trk, out, 0)
+#define TSUNAMI_CUE_STOP(us, trk)			TSUNAMI_CUE_TRACK(us, TRK_STOP, trk, 0, 0)
+#define TSUNAMI_CUE_FADE(us, trk, gain, time, stopFlag) \
+	TSUNAMI_CUE_TIME(us), SOM1, SOM2, 0x0c, CMD_TRACK_FADE, TSUNAMI_CUE_U16(trk), \
+	TSUNAMI_CUE_U16(gain), TSUNAMI_CUE_U16(time), (stopFlag), EOM
+#define TSUNAMI_CUE_TRACK_GAIN(us, trk, gain) \
+	TSUNAMI_CUE_TIME(us), SOM1, SOM2, 0x09, CMD_TRACK_VOLUME, TSUNAMI_CUE_U16(trk), \
+	TSUNAMI_CUE_U16(gain), EOM
+#define TSUNAMI_CUE_MASTER_GAIN(us, out, gain) \
+	TSUNAMI_CUE_TIME(us), SOM1, SOM2, 0x08, CMD_MASTER_VOLUME, (uint8_t)((out) & 0x07), \
+	TSUNAMI_CUE_U16(gain), EOM
+#define TSUNAMI_CUE_STOP_ALL(us) \
+	TSUNAMI_CUE_TIME(us), SOM1, SOM2, 0x05, CMD_STOP_ALL, EOM
+
+class TsunamiCueList
+{
+public:
+	TsunamiCueList() : blob(0), blobLen(0) { clear(); }
+	void clear(void);
+	bool add(uint32_t atUs, const uint8_t *frame);
+	bool addTrack(uint32_t atUs, int code, int trk, int out, bool lock);
+	bool addFade(uint32_t atUs, int trk, int gain, int time, bool stopFlag);
+	bool addTrackGain(uint32_t atUs, int trk, int gain);
+	bool addMasterGain(uint32_t atUs, int out, int gain);
+	void loadBlob(const uint8_t *pBlob, uint16_t len);
+	void start(uint32_t nowUs);
+	void stop(void) { running = false; }
+	bool isRunning(void) const { return running; }
+	int pending(void) const;
+	int32_t untilNextUs(uint32_t nowUs);
+	int next(uint32_t nowUs, uint8_t *pDst);
+	uint32_t getDispatched(void) const { return dispatched; }
+
+	// Microseconds between the time a cue was due and the time it
+	// was handed out
+	TsunamiHistogram lateness;
+
+private:
+	struct Cue {
+		uint32_t atUs;
+		// Order of the add() calls, which breaks ties between cues
+		// due at the same time
+		uint32_t seq;
+		uint8_t frame[CUE_FRAME_LEN];
+	};
+
+	static bool before(const Cue &a, const Cue &b);
+	bool blobPeek(uint32_t *pAt);
+	void heapPop(void);
+
+	Cue heap[CUE_HEAP_LEN];
+	// Cue blob in flash and the offset of its next record
+	const uint8_t *blob;
+	uint16_t blobLen;
+	uint16_t blobPos;
+	uint32_t startUs;
+	uint32_t dispatched;
+	uint32_t seqNext;
+	uint8_t heapCount;
+	bool running;
+};
+
+#endif
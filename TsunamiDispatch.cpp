@@ -0,0 +1,132 @@
+// **************************************************************
+//     Filename: TsunamiDispatch.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Event dispatch to several listeners
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+// **************************************************************
+// A dispatcher without listeners
+TsunamiDispatcher::TsunamiDispatcher() {
+
+	memset(func, 0, sizeof(func));
+	memset(trackBits, 0, sizeof(trackBits));
+	used = 0;
+	allTracks = 0;
+	dispatched = 0;
+}
+
+// **************************************************************
+// Adds a listener: pFunc(pCtx, ev) is called for the events of the
+// DISPATCH_* types in eventTypes. Track reports also need a
+// subscription. Returns the listener's id, or -1 if all
+// DISPATCH_LISTENERS are used
+int TsunamiDispatcher::addListener(TsunamiListenerFunc pFunc, void *pCtx, int eventTypes) {
+
+int id;
+
+	for (id = 0; id < DISPATCH_LISTENERS; id++) {
+		if (!(used & (1 << id)))
+			break;
+	}
+	if ((id == DISPATCH_LISTENERS) || !pFunc)
+		return -1;
+	func[id] = pFunc;
+	ctx[id] = pCtx;
+	types[id] = (uint8_t)eventTypes;
+	used |= 1 << id;
+	return id;
+}
+
+// **************************************************************
+// Removes listener id and its subscriptions. It may be called from
+// the listener itself
+void TsunamiDispatcher::removeListener(int id) {
+
+	if ((id < 0) || (id >= DISPATCH_LISTENERS))
+		return;
+	setBits(id, 1, DISPATCH_MAX_TRACKS, false);
+	allTracks &= ~(1 << id);
+	used &= ~(1 << id);
+	func[id] = NULL;
+}
+
+// **************************************************************
+// Subscribes listener id to the reports of tracks first to last
+// (1-DISPATCH_MAX_TRACKS). Returns false if the id or the range is
+// not valid
+bool TsunamiDispatcher::subscribe(int id, int first, int last) {
+
+	if ((id < 0) || (id >= DISPATCH_LISTENERS) || !(used & (1 << id)) ||
+		(first < 1) || (last > DISPATCH_MAX_TRACKS) || (first > last))
+		return false;
+	setBits(id, first, last, true);
+	return true;
+}
+
+// **************************************************************
+// Ends the subscription of listener id to tracks first to last
+void TsunamiDispatcher::unsubscribe(int id, int first, int last) {
+
+	if ((id < 0) || (id >= DISPATCH_LISTENERS))
+		return;
+	if (first < 1)
+		first = 1;
+	if (last > DISPATCH_MAX_TRACKS)
+		last = DISPATCH_MAX_TRACKS;
+	setBits(id, first, last, false);
+}
+
+// **************************************************************
+// Subscribes listener id to the reports of every track, including
+// those above DISPATCH_MAX_TRACKS, or ends that
+void TsunamiDispatcher::subscribeAll(int id, bool enable) {
+
+	if ((id < 0) || (id >= DISPATCH_LISTENERS) || !(used & (1 << id)))
+		return;
+	if (enable)
+		allTracks |= 1 << id;
+	else
+		allTracks &= ~(1 << id);
+}
+
+// **************************************************************
+// Private: sets or clears the bit of listener id for tracks first
+// to last
+void TsunamiDispatcher::setBits(int id, int first, int last, bool set) {
+
+uint8_t bit = 1 << id;
+int i;
+
+	for (i = first - 1; i < last; i++) {
+		if (set)
+			trackBits[i] |= bit;
+		else
+			trackBits[i] &= ~bit;
+	}
+}
+
+// **************************************************************
+// Private: calls the listeners that want ev. A track report looks up
+// its track once; the loop then only visits set bits
+void TsunamiDispatcher::dispatch(const TsunamiDispatchEvent &ev) {
+
+uint8_t mask = used;
+int id;
+
+	if (ev.type == DISPATCH_TRACK_REPORT) {
+		mask &= allTracks;
+		if ((ev.track >= 1) && (ev.track <= DISPATCH_MAX_TRACKS))
+			mask |= trackBits[ev.track - 1];
+	}
+	for (id = 0; mask; id++, mask >>= 1) {
+		// A listener may remove itself or another one meanwhile
+		if ((mask & 1) && func[id] && (types[id] & ev.type)) {
+			func[id](ctx[id], ev);
+			dispatched++;
+		}
+	}
+}
@@ -0,0 +1,93 @@
+// **************************************************************
+//     Filename: TsunamiDispatch.h
+// Date Created: 10/17/2026
+//
+//     Comments: Event dispatch to several listeners. Each listener
+//               is a function with a context pointer, or an object
+//               with operator(), and picks the event types it wants.
+//               Track reports only go to the listeners subscribed to
+//               the track (or to all tracks), found with one lookup
+//               in a table of listener bits per track, so the cost
+//               of a report does not grow with the subscriptions of
+//               other listeners. No heap, no std::function.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_DISPATCH_H_
+#define _TSUNAMI_DISPATCH_H_
+
+#include <stdint.h>
+
+// Listeners per dispatcher, the bits of a uint8_t
+#define DISPATCH_LISTENERS			8
+
+// Highest track number with its own subscriptions. Reports of higher
+// tracks only reach the listeners subscribed to all tracks. The table
+// takes a byte per track, so AVR boards only get the first 256; set
+// it with -D to change that
+#ifndef DISPATCH_MAX_TRACKS
+#if defined(__AVR__) && (TSUNAMI_MAX_TRACKS > 256)
+#define DISPATCH_MAX_TRACKS			256
+#else
+#define DISPATCH_MAX_TRACKS			TSUNAMI_MAX_TRACKS
+#endif
+#endif
+
+// Event types, or'ed together when adding a listener
+#define DISPATCH_TRACK_REPORT		0x01	// track, voice, didStart
+#define DISPATCH_VERSION			0x02	// version (NULL with __TSUNAMI_NO_VERSION__)
+#define DISPATCH_SYSINFO			0x04	// voice: number of voices, track: number of tracks
+#define DISPATCH_RX_ERROR			0x08	// errors: frames given up since the last one
+#define DISPATCH_ALL				0x0f
+
+class Tsunami;
+
+struct TsunamiDispatchEvent {
+	// DISPATCH_TRACK_REPORT ... DISPATCH_RX_ERROR
+	uint8_t type;
+	uint8_t voice;
+	uint16_t track;
+	bool didStart;
+	const char *version;
+	uint32_t errors;
+	// The board the event came from
+	Tsunami *board;
+};
+
+typedef void (*TsunamiListenerFunc)(void *pCtx, const TsunamiDispatchEvent &ev);
+
+class TsunamiDispatcher
+{
+public:
+	TsunamiDispatcher();
+	int addListener(TsunamiListenerFunc pFunc, void *pCtx, int eventTypes);
+	// pObj is called as (*pObj)(ev), and must outlive the listener
+	template <class F>
+	int addListener(F *pObj, int eventTypes) { return addListener(callObject<F>, pObj, eventTypes); }
+	void removeListener(int id);
+	bool subscribe(int id, int first, int last);
+	bool subscribe(int id, int trk) { return subscribe(id, trk, trk); }
+	void unsubscribe(int id, int first, int last);
+	void subscribeAll(int id, bool enable);
+	uint32_t getDispatched(void) const { return dispatched; }
+
+private:
+	friend class Tsunami;
+
+	template <class F>
+	static void callObject(void *pCtx, const TsunamiDispatchEvent &ev) { (*(F *)pCtx)(ev); }
+	void setBits(int id, int first, int last, bool set);
+	void dispatch(const TsunamiDispatchEvent &ev);
+
+	TsunamiListenerFunc func[DISPATCH_LISTENERS];
+	void *ctx[DISPATCH_LISTENERS];
+	uint8_t types[DISPATCH_LISTENERS];
+	// Listeners in use, and those subscribed to every track
+	uint8_t used;
+	uint8_t allTracks;
+	// Listeners subscribed to each track, track n at n - 1
+	uint8_t trackBits[DISPATCH_MAX_TRACKS];
+	uint32_t dispatched;
+};
+
+#endif
@@ -0,0 +1,47 @@
+// **************************************************************
+//     Filename: TsunamiEventQueue.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Lock-free SPSC queue of decoded Tsunami messages
+//
+// **************************************************************
+
+#include "TsunamiEventQueue.h"
+
+// **************************************************************
+// Producer side: appends an event. Returns false if the queue is full
+bool TsunamiEventQueue::push(const TsunamiEvent &ev) {
+
+uint8_t h;
+uint8_t next;
+
+	h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+	next = (h + 1) & EVENT_QUEUE_MASK;
+	if (next == __atomic_load_n(&tail, __ATOMIC_ACQUIRE))
+		return false;
+	buf[h] = ev;
+	__atomic_store_n(&head, next, __ATOMIC_RELEASE);
+	return true;
+}
+
+// **************************************************************
+// Consumer side: removes the oldest event into pEv. Returns false if
+// the queue is empty
+bool TsunamiEventQueue::pop(TsunamiEvent *pEv) {
+
+uint8_t t;
+
+	t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+	if (t == __atomic_load_n(&head, __ATOMIC_ACQUIRE))
+		return false;
+	*pEv = buf[t];
+	__atomic_store_n(&tail, (uint8_t)((t + 1) & EVENT_QUEUE_MASK), __ATOMIC_RELEASE);
+	return true;
+}
+
+// **************************************************************
+// Number of events waiting. Exact only on the consumer side
+int TsunamiEventQueue::pending(void) const {
+
+	return (uint8_t)(__atomic_load_n(&head, __ATOMIC_ACQUIRE) - tail) & EVENT_QUEUE_MASK;
+}
@@ -0,0 +1,54 @@
+// **************************************************************
+//     Filename: TsunamiEventQueue.h
+// Date Created: 10/17/2026
+//
+//     Comments: Decoded Tsunami messages, and the lock-free single
+//               producer / single consumer queue that carries them
+//               from the receive side (serial interrupt, serialEvent
+//               or a reader thread) to the main loop
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_EVENT_QUEUE_H_
+#define _TSUNAMI_EVENT_QUEUE_H_
+
+#include <stdint.h>
+
+// Number of events the queue holds. Must be a power of 2, no more
+// than 256. One entry is always left unused to tell full from empty
+#ifndef EVENT_QUEUE_LEN
+#define EVENT_QUEUE_LEN			16
+#endif
+#define EVENT_QUEUE_MASK		(EVENT_QUEUE_LEN - 1)
+
+// One decoded message from the Tsunami
+struct TsunamiEvent {
+	// RSP_TRACK_REPORT, RSP_VERSION_STRING or RSP_SYSTEM_INFO
+	uint8_t type;
+	// Track report: voice. System info: number of voices
+	uint8_t voice;
+	// Track report: track (1-4096). System info: number of tracks
+	uint16_t track;
+	// Track report: true if the track started, false if it stopped
+	bool didStart;
+};
+
+// head is only written by the producer and tail only by the consumer.
+// Each index is published with release ordering after the entry it
+// covers, and read with acquire ordering, so the queue is safe between
+// an interrupt and the main loop, and between two threads
+class TsunamiEventQueue
+{
+public:
+	TsunamiEventQueue() : head(0), tail(0) {;}
+	bool push(const TsunamiEvent &ev);
+	bool pop(TsunamiEvent *pEv);
+	int pending(void) const;
+
+private:
+	TsunamiEvent buf[EVENT_QUEUE_LEN];
+	uint8_t head;
+	uint8_t tail;
+};
+
+#endif
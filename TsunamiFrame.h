@@ -0,0 +1,151 @@
+// **************************************************************
+//     Filename: TsunamiFrame.h
+// Date Created: 10/17/2026
+//
+//     Comments: Compile-time description of the Tsunami command
+//               frames. Each message type lists its payload fields;
+//               frame length and field offsets are computed by the
+//               compiler and encode() writes the frame straight into
+//               the caller's buffer.
+//
+//               Frame layout: SOM1, SOM2, length, command, fields
+//               (16 bit fields LSB first), EOM
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_FRAME_H_
+#define _TSUNAMI_FRAME_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#define TSUNAMI_PROGMEM					PROGMEM
+#define tsunamiCopyP(dst, src, n)		memcpy_P(dst, src, n)
+#else
+#define TSUNAMI_PROGMEM
+#define tsunamiCopyP(dst, src, n)		memcpy(dst, src, n)
+#endif
+
+// Bytes in every frame besides the fields: SOM1, SOM2, length,
+// command and EOM
+#define TSUNAMI_FRAME_OVERHEAD			5
+
+// **************************************************************
+// Field types
+struct TsunamiU8 {
+	typedef uint8_t type;
+	enum { SIZE = 1 };
+	static void put(uint8_t *p, uint8_t v) { p[0] = v; }
+};
+
+struct TsunamiU16 {
+	typedef uint16_t type;
+	enum { SIZE = 2 };
+	static void put(uint8_t *p, uint16_t v) {
+		p[0] = (uint8_t)v;
+		p[1] = (uint8_t)(v >> 8);
+	}
+};
+
+// **************************************************************
+// Sum of the field sizes
+template <class... F> struct TsunamiFieldSize;
+template <> struct TsunamiFieldSize<> {
+	enum { value = 0 };
+};
+template <class F0, class... F> struct TsunamiFieldSize<F0, F...> {
+	enum { value = F0::SIZE + TsunamiFieldSize<F...>::value };
+};
+
+// Offset of field N within the frame
+template <int N, class... F> struct TsunamiFieldOffset;
+template <class F0, class... F> struct TsunamiFieldOffset<0, F0, F...> {
+	enum { value = 4 };
+};
+template <int N, class F0, class... F> struct TsunamiFieldOffset<N, F0, F...> {
+	enum { value = F0::SIZE + TsunamiFieldOffset<N - 1, F...>::value };
+};
+
+// Writes the fields one after the other
+template <class... F> struct TsunamiFieldPut;
+template <> struct TsunamiFieldPut<> {
+	static void put(uint8_t *p) { (void)p; }
+};
+template <class F0, class... F> struct TsunamiFieldPut<F0, F...> {
+	static void put(uint8_t *p, typename F0::type v0, typename F::type... v) {
+		F0::put(p, v0);
+		TsunamiFieldPut<F...>::put(p + F0::SIZE, v...);
+	}
+};
+
+// **************************************************************
+// One command message: CMD followed by fields F
+template <uint8_t CMD, class... F>
+struct TsunamiMsg {
+	enum { LEN = TSUNAMI_FRAME_OVERHEAD + TsunamiFieldSize<F...>::value };
+
+	template <int N> struct Offset {
+		enum { value = TsunamiFieldOffset<N, F...>::value };
+	};
+
+	// Encodes the frame into p, which must hold LEN bytes
+	static void encode(uint8_t *p, typename F::type... v) {
+		p[0] = SOM1;
+		p[1] = SOM2;
+		p[2] = LEN;
+		p[3] = CMD;
+		TsunamiFieldPut<F...>::put(p + 4, v...);
+		p[LEN - 1] = EOM;
+	}
+};
+
+// **************************************************************
+// Frames without fields never change, so they are stored encoded in
+// flash and only copied out when sent
+template <uint8_t CMD>
+struct TsunamiConstFrame {
+	static const uint8_t data[TSUNAMI_FRAME_OVERHEAD];
+};
+
+template <uint8_t CMD>
+const uint8_t TsunamiConstFrame<CMD>::data[TSUNAMI_FRAME_OVERHEAD] TSUNAMI_PROGMEM =
+	{ SOM1, SOM2, TSUNAMI_FRAME_OVERHEAD, CMD, EOM };
+
+// **************************************************************
+// The Tsunami commands
+typedef TsunamiMsg<CMD_GET_VERSION> MsgGetVersion;
+typedef TsunamiMsg<CMD_GET_SYS_INFO> MsgGetSysInfo;
+// code, track, output, flags
+typedef TsunamiMsg<CMD_TRACK_CONTROL, TsunamiU8, TsunamiU16, TsunamiU8, TsunamiU8> MsgTrackControl;
+typedef TsunamiMsg<CMD_STOP_ALL> MsgStopAll;
+// output, gain
+typedef TsunamiMsg<CMD_MASTER_VOLUME, TsunamiU8, TsunamiU16> MsgMasterVolume;
+// track, gain
+typedef TsunamiMsg<CMD_TRACK_VOLUME, TsunamiU16, TsunamiU16> MsgTrackVolume;
+// track, gain, time, stop flag
+typedef TsunamiMsg<CMD_TRACK_FADE, TsunamiU16, TsunamiU16, TsunamiU16, TsunamiU8> MsgTrackFade;
+typedef TsunamiMsg<CMD_RESUME_ALL_SYNC> MsgResumeAllSync;
+// output, offset
+typedef TsunamiMsg<CMD_SAMPLERATE_OFFSET, TsunamiU8, TsunamiU16> MsgSamplerateOffset;
+// enable
+typedef TsunamiMsg<CMD_SET_REPORTING, TsunamiU8> MsgSetReporting;
+// bank
+typedef TsunamiMsg<CMD_SET_TRIGGER_BANK, TsunamiU8> MsgSetTriggerBank;
+// mix
+typedef TsunamiMsg<CMD_SET_INPUT_MIX, TsunamiU8> MsgSetInputMix;
+// bank
+typedef TsunamiMsg<CMD_SET_MIDI_BANK, TsunamiU8> MsgSetMidiBank;
+
+// The frame lengths the Tsunami firmware expects
+static_assert(MsgGetVersion::LEN == 0x05, "CMD_GET_VERSION frame length");
+static_assert(MsgTrackControl::LEN == 0x0a, "CMD_TRACK_CONTROL frame length");
+static_assert(MsgMasterVolume::LEN == 0x08, "CMD_MASTER_VOLUME frame length");
+static_assert(MsgTrackVolume::LEN == 0x09, "CMD_TRACK_VOLUME frame length");
+static_assert(MsgTrackFade::LEN == 0x0c, "CMD_TRACK_FADE frame length");
+static_assert(MsgSamplerateOffset::LEN == 0x08, "CMD_SAMPLERATE_OFFSET frame length");
+static_assert(MsgSetReporting::LEN == 0x06, "CMD_SET_REPORTING frame length");
+static_assert(MsgTrackFade::Offset<3>::value == 10, "CMD_TRACK_FADE stop flag offset");
+
+#endif
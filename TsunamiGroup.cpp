@@ -0,0 +1,222 @@
+// **************************************************************
+//     Filename: TsunamiGroup.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Drives several Tsunami boards as one
+//
+// **************************************************************
+
+#include "TsunamiGroup.h"
+
+#ifndef __TSUNAMI_USE_HOST__
+#include <Arduino.h>
+#endif
+
+// **************************************************************
+// Adds a started board to the group. Its outputs follow those of
+// the boards added before it. Returns the board number, or -1 if
+// the group is full
+int TsunamiGroup::add(Tsunami *pBoard) {
+
+	if (count >= TSUNAMI_GROUP_MAX)
+		return -1;
+	boards[count] = pBoard;
+	return count++;
+}
+
+// **************************************************************
+// Private internal function that returns the board owning group
+// output out, or NULL if there is none
+Tsunami *TsunamiGroup::boardFor(int out) {
+
+	if ((out < 0) || (out >= (count * TSUNAMI_NUM_OUTPUTS)))
+		return NULL;
+	return boards[out / TSUNAMI_NUM_OUTPUTS];
+}
+
+// **************************************************************
+// Calls update() on every board
+void TsunamiGroup::update(void) {
+
+int b;
+
+	for (b = 0; b < count; b++)
+		boards[b]->update(0, 0);
+}
+
+// **************************************************************
+// Update with a budget shared by all boards: polls the boards in
+// turn until maxBytes received bytes or maxMicros microseconds are
+// used up (0 means no limit). The next call carries on with the
+// board after the last one polled, so a busy board cannot starve the
+// others. Returns the number of bytes parsed
+int TsunamiGroup::update(int maxBytes, uint32_t maxMicros) {
+
+uint32_t t0 = 0;
+uint32_t used;
+int done = 0;
+int left = 0;
+uint32_t leftUs = 0;
+int b;
+int i;
+
+	if (count == 0)
+		return 0;
+	if (maxMicros)
+		t0 = micros();
+	b = (next < count) ? next : 0;
+	for (i = 0; i < count; i++) {
+		if (maxBytes)
+			left = maxBytes - done;
+		if (maxMicros) {
+			used = (uint32_t)(micros() - t0);
+			if (used >= maxMicros)
+				break;
+			leftUs = maxMicros - used;
+		}
+		done += boards[b]->update(left, leftUs);
+		if (++b >= count)
+			b = 0;
+		if (maxBytes && (done >= maxBytes))
+			break;
+	}
+	next = (uint8_t)b;
+	return done;
+}
+
+// **************************************************************
+// Returns the first board track trk is playing on, or -1 if it is
+// not playing anywhere. Needs reporting enabled on the boards
+int TsunamiGroup::findTrack(int trk) {
+
+int b;
+
+	for (b = 0; b < count; b++) {
+		if (boards[b]->trackVoiceCount(trk) > 0)
+			return b;
+	}
+	return -1;
+}
+
+// **************************************************************
+// Commands for the whole group, sent to every board
+void TsunamiGroup::setReporting(bool enable) {
+
+int b;
+
+	for (b = 0; b < count; b++)
+		boards[b]->setReporting(enable);
+}
+
+void TsunamiGroup::stopAllTracks(void) {
+
+int b;
+
+	for (b = 0; b < count; b++)
+		boards[b]->stopAllTracks();
+}
+
+void TsunamiGroup::resumeAllInSync(void) {
+
+int b;
+
+	for (b = 0; b < count; b++)
+		boards[b]->resumeAllInSync();
+}
+
+// **************************************************************
+// Output commands, sent to the board owning group output out
+void TsunamiGroup::masterGain(int out, int gain) {
+
+Tsunami *p = boardFor(out);
+
+	if (p)
+		p->masterGain(out % TSUNAMI_NUM_OUTPUTS, gain);
+}
+
+void TsunamiGroup::samplerateOffset(int out, int offset) {
+
+Tsunami *p = boardFor(out);
+
+	if (p)
+		p->samplerateOffset(out % TSUNAMI_NUM_OUTPUTS, offset);
+}
+
+// **************************************************************
+// Starting a track: sent to the board owning group output out. Solo
+// only stops the other tracks on that board
+void TsunamiGroup::trackPlaySolo(int trk, int out, bool lock) {
+
+Tsunami *p = boardFor(out);
+
+	if (p)
+		p->trackPlaySolo(trk, out % TSUNAMI_NUM_OUTPUTS, lock);
+}
+
+void TsunamiGroup::trackPlayPoly(int trk, int out, bool lock) {
+
+Tsunami *p = boardFor(out);
+
+	if (p)
+		p->trackPlayPoly(trk, out % TSUNAMI_NUM_OUTPUTS, lock);
+}
+
+void TsunamiGroup::trackLoad(int trk, int out, bool lock) {
+
+Tsunami *p = boardFor(out);
+
+	if (p)
+		p->trackLoad(trk, out % TSUNAMI_NUM_OUTPUTS, lock);
+}
+
+// **************************************************************
+// Commands on a running track do not name an output, so they are
+// sent to every board. A board that is not playing the track
+// ignores them
+void TsunamiGroup::trackStop(int trk) {
+
+int b;
+
+	for (b = 0; b < count; b++)
+		boards[b]->trackStop(trk);
+}
+
+void TsunamiGroup::trackPause(int trk) {
+
+int b;
+
+	for (b = 0; b < count; b++)
+		boards[b]->trackPause(trk);
+}
+
+void TsunamiGroup::trackResume(int trk) {
+
+int b;
+
+	for (b = 0; b < count; b++)
+		boards[b]->trackResume(trk);
+}
+
+void TsunamiGroup::trackLoop(int trk, bool enable) {
+
+int b;
+
+	for (b = 0; b < count; b++)
+		boards[b]->trackLoop(trk, enable);
+}
+
+void TsunamiGroup::trackGain(int trk, int gain) {
+
+int b;
+
+	for (b = 0; b < count; b++)
+		boards[b]->trackGain(trk, gain);
+}
+
+void TsunamiGroup::trackFade(int trk, int gain, int time, bool stopFlag) {
+
+int b;
+
+	for (b = 0; b < count; b++)
+		boards[b]->trackFade(trk, gain, time, stopFlag);
+}
@@ -0,0 +1,55 @@
+// **************************************************************
+//     Filename: TsunamiGroup.h
+// Date Created: 10/17/2026
+//
+//     Comments: Drives several Tsunami boards as one. Outputs are
+//               numbered across the boards (board 0 has outputs
+//               0-7, board 1 has 8-15, ...), track commands that
+//               name an output go to the board owning it and
+//               update() polls every board in one pass.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_GROUP_H_
+#define _TSUNAMI_GROUP_H_
+
+#include "Tsunami.h"
+
+#define TSUNAMI_GROUP_MAX			8
+
+class TsunamiGroup
+{
+public:
+	TsunamiGroup() : count(0), next(0) {;}
+	int add(Tsunami *pBoard);
+	int numBoards(void) { return count; }
+	Tsunami *board(int n) { return ((n >= 0) && (n < count)) ? boards[n] : NULL; }
+	int numOutputs(void) { return count * TSUNAMI_NUM_OUTPUTS; }
+	void update(void);
+	int update(int maxBytes, uint32_t maxMicros);
+	int findTrack(int trk);
+	void setReporting(bool enable);
+	void masterGain(int out, int gain);
+	void samplerateOffset(int out, int offset);
+	void stopAllTracks(void);
+	void resumeAllInSync(void);
+	void trackPlaySolo(int trk, int out, bool lock);
+	void trackPlayPoly(int trk, int out, bool lock);
+	void trackLoad(int trk, int out, bool lock);
+	void trackStop(int trk);
+	void trackPause(int trk);
+	void trackResume(int trk);
+	void trackLoop(int trk, bool enable);
+	void trackGain(int trk, int gain);
+	void trackFade(int trk, int gain, int time, bool stopFlag);
+
+private:
+	Tsunami *boardFor(int out);
+
+	Tsunami *boards[TSUNAMI_GROUP_MAX];
+	uint8_t count;
+	// Board the next budgeted update() starts with
+	uint8_t next;
+};
+
+#endif
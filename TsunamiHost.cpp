@@ -0,0 +1,42 @@
+// **************************************************************
+//     Filename: TsunamiHost.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Linux host implementation of the Arduino timing
+//               functions used by the Tsunami library
+//
+// **************************************************************
+
+#ifndef ARDUINO
+
+#include <time.h>
+#include "TsunamiHost.h"
+
+static uint64_t hostEpochUs;
+
+// **************************************************************
+// Reads the monotonic clock in microseconds, relative to the first
+// time it was read
+static uint64_t hostClockUs(void) {
+
+struct timespec ts;
+uint64_t us;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	us = (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+	if (hostEpochUs == 0)
+		hostEpochUs = us;
+	return us - hostEpochUs;
+}
+
+uint32_t millis(void) {
+
+	return (uint32_t)(hostClockUs() / 1000);
+}
+
+uint32_t micros(void) {
+
+	return (uint32_t)hostClockUs();
+}
+
+#endif
@@ -0,0 +1,23 @@
+// **************************************************************
+//     Filename: TsunamiHost.h
+// Date Created: 10/17/2026
+//
+//     Comments: Stand-ins for the parts of the Arduino core used by
+//               the Tsunami library, so it can be compiled and
+//               benchmarked on a Linux host
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_HOST_H_
+#define _TSUNAMI_HOST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Milliseconds / microseconds since the first call, from the
+// monotonic clock. Both wrap exactly like their Arduino versions
+uint32_t millis(void);
+uint32_t micros(void);
+
+#endif
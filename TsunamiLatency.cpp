@@ -0,0 +1,271 @@
+// **************************************************************
+//     Filename: TsunamiLatency.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Command-to-report latency monitor
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+#ifndef __TSUNAMI_USE_HOST__
+#include <Arduino.h>
+#endif
+
+// **************************************************************
+void TsunamiHistogram::clear(void) {
+
+int i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++)
+		buckets[i] = 0;
+	sum = 0;
+	total = 0;
+	lo = 0xffffffff;
+	hi = 0;
+}
+
+// **************************************************************
+// Counts one latency
+void TsunamiHistogram::add(uint32_t us) {
+
+uint32_t n = us / LATENCY_BUCKET_US;
+
+	if (n >= LATENCY_BUCKETS)
+		n = LATENCY_BUCKETS - 1;
+	buckets[n]++;
+	sum += us;
+	total++;
+	if (us < lo)
+		lo = us;
+	if (us > hi)
+		hi = us;
+}
+
+// **************************************************************
+// Returns the latency pct percent of the samples are at or below,
+// to bucket resolution (the upper edge of the bucket, but never
+// more than the maximum seen)
+uint32_t TsunamiHistogram::percentileUs(int pct) const {
+
+uint32_t need;
+uint32_t seen = 0;
+uint32_t edge;
+int n;
+
+	if (total == 0)
+		return 0;
+	need = (uint32_t)(((uint64_t)total * pct + 99) / 100);
+	if (need == 0)
+		need = 1;
+	for (n = 0; n < LATENCY_BUCKETS; n++) {
+		seen += buckets[n];
+		if (seen >= need)
+			break;
+	}
+	if (n >= (LATENCY_BUCKETS - 1))
+		return hi;
+	edge = (uint32_t)(n + 1) * LATENCY_BUCKET_US;
+	return (edge < hi) ? edge : hi;
+}
+
+// **************************************************************
+// Forgets the pending commands and clears both histograms
+void TsunamiLatency::clear(void) {
+
+int i;
+
+	for (i = 0; i < LATENCY_PENDING; i++)
+		pendTrack[i] = 0;
+	unmatched = 0;
+	start.clear();
+	stop.clear();
+}
+
+// **************************************************************
+// Private internal function returning the time in microseconds,
+// from the clock set with setClock() or micros()
+uint32_t TsunamiLatency::now(void) {
+
+	return clock ? clock() : micros();
+}
+
+// **************************************************************
+// Timestamps a track control command. Only the commands the board
+// answers with a track report are kept
+void TsunamiLatency::sent(uint16_t track, uint8_t code) {
+
+int i;
+int slot = -1;
+uint32_t t = now();
+
+	if ((code != TRK_PLAY_SOLO) && (code != TRK_PLAY_POLY) && (code != TRK_STOP))
+		return;
+	expire(t);
+	for (i = 0; i < LATENCY_PENDING; i++) {
+		if (pendTrack[i] == 0) {
+			slot = i;
+			break;
+		}
+		if ((slot < 0) || ((uint32_t)(t - pendUs[i]) > (uint32_t)(t - pendUs[slot])))
+			slot = i;
+	}
+	// No free entry: give up on the oldest command
+	if (pendTrack[slot] != 0)
+		unmatched++;
+	pendTrack[slot] = track;
+	pendStart[slot] = (code != TRK_STOP);
+	pendUs[slot] = t;
+}
+
+// **************************************************************
+// Matches a track report with the oldest pending command of the
+// same kind for that track and counts the latency
+void TsunamiLatency::report(uint16_t track, bool didStart) {
+
+int i;
+int slot = -1;
+uint32_t t = now();
+
+	expire(t);
+	for (i = 0; i < LATENCY_PENDING; i++) {
+		if ((pendTrack[i] != track) || (pendStart[i] != didStart))
+			continue;
+		if ((slot < 0) || ((uint32_t)(t - pendUs[i]) > (uint32_t)(t - pendUs[slot])))
+			slot = i;
+	}
+	// A report nothing asked for: the track ended on its own
+	if (slot < 0)
+		return;
+	pendTrack[slot] = 0;
+	if (didStart)
+		start.add(t - pendUs[slot]);
+	else
+		stop.add(t - pendUs[slot]);
+}
+
+// **************************************************************
+// Private internal function that gives up the commands still not
+// reported LATENCY_TIMEOUT_US after they were sent, so that a later
+// report of their track is not matched with them
+void TsunamiLatency::expire(uint32_t t) {
+
+int i;
+
+	for (i = 0; i < LATENCY_PENDING; i++) {
+		if (pendTrack[i] && ((uint32_t)(t - pendUs[i]) >= LATENCY_TIMEOUT_US)) {
+			pendTrack[i] = 0;
+			unmatched++;
+		}
+	}
+}
+
+// **************************************************************
+// Private: the last play (didStart true) or stop of track was
+// discarded before it went out, so it is forgotten
+void TsunamiLatency::withdrawn(uint16_t track, bool didStart) {
+
+int i;
+int slot = -1;
+uint32_t t = now();
+
+	for (i = 0; i < LATENCY_PENDING; i++) {
+		if ((pendTrack[i] != track) || (pendStart[i] != didStart))
+			continue;
+		if ((slot < 0) || ((uint32_t)(t - pendUs[i]) < (uint32_t)(t - pendUs[slot])))
+			slot = i;
+	}
+	if (slot >= 0)
+		pendTrack[slot] = 0;
+}
+
+// **************************************************************
+// Forgets the queued frames and clears the histograms. Call it
+// while the transmit queue is empty, as the frames already queued
+// would be matched with the wrong times
+void TsunamiTxDelay::clear(void) {
+
+int i;
+
+	for (i = 0; i < TX_PRIO_CLASSES; i++) {
+		pendHead[i] = 0;
+		pendTail[i] = 0;
+		delay[i].clear();
+	}
+}
+
+// **************************************************************
+// Private internal function returning the time in microseconds,
+// from the clock set with setClock() or micros()
+uint32_t TsunamiTxDelay::now(void) {
+
+	return clock ? clock() : micros();
+}
+
+// **************************************************************
+// Private: a frame entered the queue of class cls
+void TsunamiTxDelay::queued(int cls) {
+
+uint8_t h = pendHead[cls];
+
+	pendUs[cls][h] = now();
+	if (++h == TX_DELAY_PENDING)
+		h = 0;
+	pendHead[cls] = h;
+}
+
+// **************************************************************
+// Private: the frame just timed by queued() did not fit the queue
+void TsunamiTxDelay::unqueued(int cls) {
+
+uint8_t h = pendHead[cls];
+
+	if (h == 0)
+		h = TX_DELAY_PENDING;
+	pendHead[cls] = h - 1;
+}
+
+// **************************************************************
+// Private: the oldest frame of class cls was written to the port
+void TsunamiTxDelay::sent(int cls) {
+
+uint8_t t = pendTail[cls];
+
+	if (t == pendHead[cls])
+		return;
+	delay[cls].add(now() - pendUs[cls][t]);
+	dropped(cls);
+}
+
+// **************************************************************
+// Private: the oldest frame of class cls was discarded
+void TsunamiTxDelay::dropped(int cls) {
+
+uint8_t t = pendTail[cls];
+
+	if (t == pendHead[cls])
+		return;
+	if (++t == TX_DELAY_PENDING)
+		t = 0;
+	pendTail[cls] = t;
+}
+
+// **************************************************************
+// Private: the frame of class cls queued after pos others was
+// discarded. The times of the older frames move up over its own
+void TsunamiTxDelay::removed(int cls, int pos) {
+
+uint8_t t = pendTail[cls];
+uint8_t i;
+uint8_t j;
+
+	if (t == pendHead[cls])
+		return;
+	i = (uint8_t)((t + pos) % TX_DELAY_PENDING);
+	while (i != t) {
+		j = i ? i - 1 : TX_DELAY_PENDING - 1;
+		pendUs[cls][i] = pendUs[cls][j];
+		i = j;
+	}
+	dropped(cls);
+}
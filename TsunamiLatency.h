@@ -0,0 +1,124 @@
+// **************************************************************
+//     Filename: TsunamiLatency.h
+// Date Created: 10/17/2026
+//
+//     Comments: Command-to-report latency monitor. Track control
+//               commands are timestamped when they are issued and
+//               matched by track number with the track report the
+//               board sends back. The latencies go into fixed
+//               bucket histograms. The transmit delay monitor times
+//               queued frames from the queue to the port, per
+//               priority class.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_LATENCY_H_
+#define _TSUNAMI_LATENCY_H_
+
+#include <stdint.h>
+#include "TsunamiTxQueue.h"
+
+// Histogram bucket n counts latencies from n * LATENCY_BUCKET_US up to
+// (n + 1) * LATENCY_BUCKET_US. The last bucket also counts everything
+// longer
+#ifndef LATENCY_BUCKET_US
+#define LATENCY_BUCKET_US			250
+#endif
+#ifndef LATENCY_BUCKETS
+#define LATENCY_BUCKETS				64
+#endif
+// Commands waiting for their track report. When all are in use the
+// oldest is given up and counted as unmatched
+#define LATENCY_PENDING				16
+// A command not reported within this time is given up as well: the
+// track is missing or reporting is off
+#ifndef LATENCY_TIMEOUT_US
+#define LATENCY_TIMEOUT_US			500000UL
+#endif
+// Queued frames timed per priority class: the most the largest ring
+// can hold, at 5 bytes for the shortest frame, plus the frame timed
+// while it waits for room, plus the entry that tells full from empty
+#define TX_DELAY_PENDING			(((TX_QUEUE_LEN > TX_QUEUE_PLAY_LEN) ? TX_QUEUE_LEN : TX_QUEUE_PLAY_LEN) / 5 + 2)
+
+class TsunamiHistogram
+{
+public:
+	TsunamiHistogram() { clear(); }
+	void clear(void);
+	void add(uint32_t us);
+	uint32_t count(void) const { return total; }
+	uint32_t minUs(void) const { return total ? lo : 0; }
+	uint32_t maxUs(void) const { return hi; }
+	uint32_t meanUs(void) const { return total ? (uint32_t)(sum / total) : 0; }
+	uint32_t percentileUs(int pct) const;
+	uint32_t bucket(int n) const { return buckets[n]; }
+
+private:
+	uint32_t buckets[LATENCY_BUCKETS];
+	uint64_t sum;
+	uint32_t total;
+	uint32_t lo;
+	uint32_t hi;
+};
+
+class TsunamiLatency
+{
+public:
+	TsunamiLatency() : clock(0) { clear(); }
+	void clear(void);
+	void setClock(uint32_t (*pFunc)(void)) { clock = pFunc; }
+	void sent(uint16_t track, uint8_t code);
+	void report(uint16_t track, bool didStart);
+	uint32_t getUnmatched(void) const { return unmatched; }
+
+	// Play solo / play poly to the track start report
+	TsunamiHistogram start;
+	// Stop to the track stop report
+	TsunamiHistogram stop;
+
+private:
+	friend class Tsunami;
+
+	uint32_t now(void);
+	void expire(uint32_t t);
+	void withdrawn(uint16_t track, bool didStart);
+
+	uint32_t (*clock)(void);
+	uint32_t pendUs[LATENCY_PENDING];
+	// 0 marks a free entry
+	uint16_t pendTrack[LATENCY_PENDING];
+	bool pendStart[LATENCY_PENDING];
+	uint32_t unmatched;
+};
+
+class TsunamiTxDelay
+{
+public:
+	TsunamiTxDelay() : clock(0) { clear(); }
+	void clear(void);
+	void setClock(uint32_t (*pFunc)(void)) { clock = pFunc; }
+
+	// Time from a frame entering its class's queue to its write to
+	// the port, indexed by TX_PRIO_STOP ... TX_PRIO_BULK
+	TsunamiHistogram delay[TX_PRIO_CLASSES];
+
+private:
+	friend class Tsunami;
+
+	uint32_t now(void);
+	void queued(int cls);
+	void unqueued(int cls);
+	void sent(int cls);
+	void dropped(int cls);
+	void removed(int cls, int pos);
+
+	uint32_t (*clock)(void);
+	// Queue times of the frames in each ring, oldest at pendTail.
+	// queued() runs in the main loop and sent() may run in the
+	// TX-empty interrupt, like the rings themselves
+	uint32_t pendUs[TX_PRIO_CLASSES][TX_DELAY_PENDING];
+	volatile uint8_t pendHead[TX_PRIO_CLASSES];
+	volatile uint8_t pendTail[TX_PRIO_CLASSES];
+};
+
+#endif
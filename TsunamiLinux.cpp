@@ -0,0 +1,327 @@
+// **************************************************************
+//     Filename: TsunamiLinux.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Linux tty transport and epoll event loop
+//
+// **************************************************************
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#include "TsunamiLinux.h"
+
+// **************************************************************
+// Opens the tty at pPath (e.g. /dev/ttyS0, /dev/ttyUSB0) and sets
+// it to raw 8N1 at the current baud rate. start() sets it again
+// with the rate it needs. Returns false if the tty cannot be used
+bool TsunamiTtyTransport::open(const char *pPath) {
+
+	close();
+	fd = ::open(pPath, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	if (!setLine()) {
+		close();
+		return false;
+	}
+	overrunBase = lineOverruns();
+	return true;
+}
+
+// **************************************************************
+// Closes the tty, discarding the bytes still held either way
+void TsunamiTtyTransport::close(void) {
+
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+	rxPos = 0;
+	rxLen = 0;
+	txLen = 0;
+}
+
+// **************************************************************
+// Called from Tsunami::start() with the Tsunami baud rate
+void TsunamiTtyTransport::begin(uint32_t baudRate) {
+
+	baud = baudRate;
+	if (fd >= 0)
+		setLine();
+}
+
+// **************************************************************
+// Private: raw mode, 8 data bits, no parity, 1 stop bit, no flow
+// control, reads that never wait
+bool TsunamiTtyTransport::setLine(void) {
+
+struct termios tio;
+speed_t speed;
+
+	switch (baud) {
+		case 9600:
+			speed = B9600;
+		break;
+		case 19200:
+			speed = B19200;
+		break;
+		case 38400:
+			speed = B38400;
+		break;
+		case 115200:
+			speed = B115200;
+		break;
+		case 230400:
+			speed = B230400;
+		break;
+		default:
+			speed = B57600;
+		break;
+	}
+	if (tcgetattr(fd, &tio) < 0)
+		return false;
+	cfmakeraw(&tio);
+	tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+	tio.c_cflag |= CS8 | CLOCAL | CREAD;
+	tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+// **************************************************************
+// Returns the number of bytes that can be read without waiting.
+// Reads the tty only once the bytes from the last read are taken
+int TsunamiTtyTransport::available(void) {
+
+int n;
+
+	if ((rxPos == rxLen) && (fd >= 0)) {
+		rxPos = 0;
+		rxLen = 0;
+		n = ::read(fd, rxBuf, TTY_RX_LEN);
+		if (n > 0)
+			rxLen = n;
+	}
+	return rxLen - rxPos;
+}
+
+// **************************************************************
+// Returns the next received byte, or -1 if there is none
+int TsunamiTtyTransport::read(void) {
+
+	if (!available())
+		return -1;
+	return rxBuf[rxPos++];
+}
+
+// **************************************************************
+// Reads up to len bytes that are already available
+int TsunamiTtyTransport::readBytes(uint8_t *buf, int len) {
+
+int n;
+
+	n = available();
+	if (n > len)
+		n = len;
+	memcpy(buf, rxBuf + rxPos, n);
+	rxPos += n;
+	return n;
+}
+
+// **************************************************************
+// Hands the held bytes to the tty, as many as it takes. Returns
+// the number still held
+int TsunamiTtyTransport::flushOut(void) {
+
+int n;
+
+	if (!txLen)
+		return 0;
+	n = ::write(fd, txBuf, txLen);
+	if (n > 0) {
+		txLen -= n;
+		memmove(txBuf, txBuf + n, txLen);
+	}
+	return txLen;
+}
+
+// **************************************************************
+// Sends len bytes. What the tty does not take right away is held
+// and sent by flushOut(). Once TTY_TX_LEN bytes are held, waits for
+// the tty like a write to a full UART, so no frame is ever cut.
+// Returns the number of bytes accepted, less than len only if the
+// tty fails
+size_t TsunamiTtyTransport::write(const uint8_t *buf, size_t len) {
+
+struct pollfd pfd;
+size_t done = 0;
+int n;
+
+	if (fd < 0)
+		return 0;
+	if (!flushOut()) {
+		n = ::write(fd, buf, len);
+		if (n > 0)
+			done = n;
+	}
+	while (done < len) {
+		n = TTY_TX_LEN - txLen;
+		if (n == 0) {
+			pfd.fd = fd;
+			pfd.events = POLLOUT;
+			if ((poll(&pfd, 1, -1) < 0) || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+				break;
+			flushOut();
+			continue;
+		}
+		if ((size_t)n > (len - done))
+			n = len - done;
+		memcpy(txBuf + txLen, buf + done, n);
+		txLen += n;
+		done += n;
+	}
+	return done;
+}
+
+// **************************************************************
+// Returns the room left under TTY_OUTQ_LIMIT bytes queued in the
+// tty and held here together
+int TsunamiTtyTransport::availableForWrite(void) {
+
+int queued = 0;
+int room;
+
+	if (fd < 0)
+		return 0;
+	if (ioctl(fd, TIOCOUTQ, &queued) < 0)
+		queued = 0;
+	room = TTY_OUTQ_LIMIT - queued - txLen;
+	return (room > 0) ? room : 0;
+}
+
+// **************************************************************
+// Milliseconds for half of TTY_OUTQ_LIMIT bytes to go out at the
+// line rate (10 bits per byte), at least 1
+int TsunamiTtyTransport::drainMs(void) const {
+
+	return 1 + (TTY_OUTQ_LIMIT * 5 * 1000) / baud;
+}
+
+// **************************************************************
+// Private: receive overruns counted by the serial driver, 0 when
+// the tty does not count them (USB adapters, pseudo-terminals)
+uint32_t TsunamiTtyTransport::lineOverruns(void) {
+
+struct serial_icounter_struct icount;
+
+	if (ioctl(fd, TIOCGICOUNT, &icount) < 0)
+		return 0;
+	return icount.overrun + icount.buf_overrun;
+}
+
+// **************************************************************
+// Returns the receive overruns since open()
+uint32_t TsunamiTtyTransport::getOverruns(void) {
+
+	if (fd < 0)
+		return 0;
+	return lineOverruns() - overrunBase;
+}
+
+// **************************************************************
+// Watches the tty of pTty, opened and given to pBoard->start().
+// getFd() can then be added to another epoll set or poll() loop to
+// tell when run() has work to do
+bool TsunamiEpollLoop::begin(Tsunami *pBoard, TsunamiTtyTransport *pTty) {
+
+struct epoll_event ev;
+
+	end();
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0)
+		return false;
+	board = pBoard;
+	tty = pTty;
+	waitOut = false;
+	ev.events = EPOLLIN;
+	ev.data.ptr = tty;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, tty->getFd(), &ev) < 0) {
+		end();
+		return false;
+	}
+	return true;
+}
+
+// **************************************************************
+// Stops watching the tty
+void TsunamiEpollLoop::end(void) {
+
+	if (epfd >= 0)
+		close(epfd);
+	epfd = -1;
+}
+
+// **************************************************************
+// Private: watches the tty for writability as well, or stops
+bool TsunamiEpollLoop::watch(bool out) {
+
+struct epoll_event ev;
+
+	if (out == waitOut)
+		return true;
+	ev.events = out ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+	ev.data.ptr = tty;
+	if (epoll_ctl(epfd, EPOLL_CTL_MOD, tty->getFd(), &ev) < 0)
+		return false;
+	waitOut = out;
+	return true;
+}
+
+// **************************************************************
+// Sleeps until bytes arrive, the tty takes more output or timeoutMs
+// milliseconds pass (-1 for no limit), then runs update() once. The
+// wait is cut short to the board's retry time (see setHandshake())
+// while the start-up handshake needs its retries, and while frames
+// are queued in TX_QUEUED mode, which go out as the tty output queue
+// drains. Pass the longest wait the sketch's own
+// timers (cues, coalescing window) allow. Returns the bytes parsed,
+// or -1 if the tty hung up or failed
+int TsunamiEpollLoop::run(int timeoutMs) {
+
+struct epoll_event ev;
+int hs;
+int retryMs;
+int n;
+
+	if (epfd < 0)
+		return -1;
+	hs = board->getHandshakeState();
+	retryMs = board->getHandshakeRetryMs();
+	if (((hs == HANDSHAKE_AWAIT_VERSION) || (hs == HANDSHAKE_AWAIT_SYSINFO)) &&
+		((timeoutMs < 0) || (timeoutMs > retryMs)))
+		timeoutMs = retryMs;
+	if (board->txPending() && ((timeoutMs < 0) || (timeoutMs > tty->drainMs())))
+		timeoutMs = tty->drainMs();
+	n = epoll_wait(epfd, &ev, 1, timeoutMs);
+	wakeups++;
+	if (n > 0) {
+		if (ev.events & (EPOLLERR | EPOLLHUP))
+			return -1;
+		if (ev.events & EPOLLOUT)
+			tty->flushOut();
+	}
+	n = board->update(0, 0);
+	watch(tty->txBuffered() != 0);
+	return n;
+}
+
+#endif
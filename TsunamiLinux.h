@@ -0,0 +1,94 @@
+// **************************************************************
+//     Filename: TsunamiLinux.h
+// Date Created: 10/17/2026
+//
+//     Comments: Linux serial backend, for driving a Tsunami from a
+//               single-board computer. TsunamiTtyTransport runs a
+//               tty in raw mode (8N1, 57600 baud by default) on a
+//               non-blocking file descriptor. TsunamiEpollLoop waits
+//               on that descriptor with epoll and calls update()
+//               when bytes arrive, and drains the output when the
+//               tty can take more, so nothing is polled.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_LINUX_H_
+#define _TSUNAMI_LINUX_H_
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include "Tsunami.h"
+
+// Bytes read from the tty per read() system call
+#define TTY_RX_LEN					256
+// Bytes written while the tty's output queue was full, held until
+// it drains. write() waits for room beyond that, like a full UART
+#define TTY_TX_LEN					1024
+// Bytes availableForWrite() lets into the tty's output queue. The
+// queued transmit modes only take their next frame once it fits, so
+// a short queue keeps a stop from waiting behind seconds of gains
+#define TTY_OUTQ_LIMIT				64
+
+class TsunamiTtyTransport : public TsunamiTransport
+{
+public:
+	TsunamiTtyTransport() : fd(-1), baud(57600), rxPos(0), rxLen(0), txLen(0), overrunBase(0) {;}
+	~TsunamiTtyTransport() { close(); }
+	bool open(const char *pPath);
+	void close(void);
+	int getFd(void) const { return fd; }
+	int txBuffered(void) const { return txLen; }
+	int flushOut(void);
+	int drainMs(void) const;
+
+	// TsunamiTransport
+	void begin(uint32_t baudRate);
+	int available(void);
+	int read(void);
+	int readBytes(uint8_t *buf, int len);
+	size_t write(const uint8_t *buf, size_t len);
+	int availableForWrite(void);
+	uint32_t getOverruns(void);
+
+private:
+	bool setLine(void);
+	uint32_t lineOverruns(void);
+
+	int fd;
+	uint32_t baud;
+	// Bytes read from the tty and not taken yet
+	uint8_t rxBuf[TTY_RX_LEN];
+	int rxPos;
+	int rxLen;
+	// Bytes the tty did not accept yet
+	uint8_t txBuf[TTY_TX_LEN];
+	int txLen;
+	// Driver overrun count at open()
+	uint32_t overrunBase;
+};
+
+class TsunamiEpollLoop
+{
+public:
+	TsunamiEpollLoop() : epfd(-1), board(0), tty(0), waitOut(false), wakeups(0) {;}
+	~TsunamiEpollLoop() { end(); }
+	bool begin(Tsunami *pBoard, TsunamiTtyTransport *pTty);
+	void end(void);
+	int getFd(void) const { return epfd; }
+	int run(int timeoutMs);
+	uint32_t getWakeups(void) const { return wakeups; }
+
+private:
+	bool watch(bool out);
+
+	int epfd;
+	Tsunami *board;
+	TsunamiTtyTransport *tty;
+	// Set while writability is watched
+	bool waitOut;
+	uint32_t wakeups;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,194 @@
+// **************************************************************
+//     Filename: TsunamiMidi.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: MIDI to Tsunami translation
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+// **************************************************************
+// Sets the board the commands go to and the rules they are mapped
+// through. The rules are not copied and must stay valid
+void TsunamiMidi::begin(Tsunami *pBoard, const TsunamiMidiMap *pMap, int len) {
+
+	board = pBoard;
+	map = pMap;
+	mapLen = (uint8_t)len;
+	reset();
+}
+
+// **************************************************************
+// Forgets the running status and any message in progress, and
+// clears the counters
+void TsunamiMidi::reset(void) {
+
+	status = 0;
+	need = 0;
+	have = 0;
+	sysex = false;
+	messages = 0;
+	unmapped = 0;
+}
+
+// **************************************************************
+// Reads and translates everything available on the MIDI input, in
+// blocks of up to MIDI_CHUNK_LEN bytes. Returns the bytes read
+int TsunamiMidi::update(TsunamiTransport *pIn) {
+
+uint8_t chunk[MIDI_CHUNK_LEN];
+int total = 0;
+int n;
+
+	while ((n = pIn->available()) > 0) {
+		if (n > MIDI_CHUNK_LEN)
+			n = MIDI_CHUNK_LEN;
+		n = pIn->readBytes(chunk, n);
+		if (n <= 0)
+			break;
+		parse(chunk, n);
+		total += n;
+	}
+	return total;
+}
+
+// **************************************************************
+// Translates a block of MIDI bytes. A message may be split across
+// blocks. The frames of the whole block are sent in one write
+void TsunamiMidi::parse(const uint8_t *buf, int len) {
+
+int n;
+uint8_t dat;
+
+	if (!board)
+		return;
+	board->beginBatch(batch, MIDI_BATCH_LEN);
+	for (n = 0; n < len; n++) {
+		dat = buf[n];
+		// Real-time bytes may come anywhere, even inside a message,
+		// and change nothing
+		if (dat >= 0xf8)
+			continue;
+		if (dat & 0x80) {
+			have = 0;
+			sysex = (dat == 0xf0);
+			if (dat < 0xf0) {
+				// Channel message: program change and channel pressure
+				// take one data byte, the others two
+				status = dat;
+				need = ((dat & 0xe0) == 0xc0) ? 1 : 2;
+			}
+			else {
+				// System common ends the running status. The data
+				// bytes of song position (2), song select and time
+				// code (1) are skipped
+				status = dat;
+				need = (dat == 0xf2) ? 2 : 1;
+			}
+			continue;
+		}
+		// Data byte
+		if (sysex || !status)
+			continue;
+		if ((have == 0) && (need == 2)) {
+			data0 = dat;
+			have = 1;
+			continue;
+		}
+		have = 0;
+		if (status >= 0xf0) {
+			status = 0;
+			continue;
+		}
+		if (need == 1)
+			dispatch(status, dat, 0);
+		else
+			dispatch(status, data0, dat);
+	}
+	board->endBatch();
+}
+
+// **************************************************************
+// Private: returns the first rule for a message of type on channel
+// with number num (note, controller or program), or NULL
+const TsunamiMidiMap *TsunamiMidi::find(uint8_t type, uint8_t channel, uint8_t num) const {
+
+int i;
+const TsunamiMidiMap *pRule;
+
+	for (i = 0; i < mapLen; i++) {
+		pRule = &map[i];
+		if ((pRule->type == type) && (num >= pRule->lo) && (num <= pRule->hi) &&
+			((pRule->channel == MIDI_OMNI) || (pRule->channel == channel)))
+			return pRule;
+	}
+	return NULL;
+}
+
+// **************************************************************
+// Gain for a 0-127 value, scaled between the gains of a rule
+static int midiGain(const TsunamiMidiMap *pRule, uint8_t value) {
+
+	return pRule->gainMin + ((pRule->gainMax - pRule->gainMin) * (int)value) / 127;
+}
+
+// **************************************************************
+// Private: translates one complete channel message
+void TsunamiMidi::dispatch(uint8_t status, uint8_t d1, uint8_t d2) {
+
+const TsunamiMidiMap *pRule;
+uint8_t channel = status & 0x0f;
+uint8_t type = status & 0xf0;
+int n;
+
+	messages++;
+	// Note on with velocity 0 is a note off
+	if ((type == 0x90) && (d2 == 0))
+		type = 0x80;
+	switch (type) {
+		case 0x80:
+		case 0x90:
+			pRule = find(MIDI_MAP_NOTE, channel, d1);
+		break;
+		case 0xb0:
+			pRule = find(MIDI_MAP_CC, channel, d1);
+		break;
+		case 0xc0:
+			pRule = find(MIDI_MAP_PROGRAM, channel, d1);
+		break;
+		default:
+			pRule = NULL;
+		break;
+	}
+	if (!pRule) {
+		unmapped++;
+		return;
+	}
+	n = pRule->base + (d1 - pRule->lo);
+	switch (pRule->action) {
+		case MIDI_PLAY_POLY:
+		case MIDI_PLAY_SOLO:
+			if (type == 0x80) {
+				if (pRule->flags & MIDI_OFF_STOPS)
+					board->trackStop(n);
+				break;
+			}
+			if (pRule->flags & MIDI_VELOCITY)
+				board->trackGain(n, midiGain(pRule, d2));
+			if (pRule->action == MIDI_PLAY_SOLO)
+				board->trackPlaySolo(n, pRule->out, pRule->flags & MIDI_LOCK);
+			else
+				board->trackPlayPoly(n, pRule->out, pRule->flags & MIDI_LOCK);
+		break;
+		case MIDI_TRACK_GAIN:
+			board->trackGain(n, midiGain(pRule, d2));
+		break;
+		case MIDI_MASTER_GAIN:
+			board->masterGain(n, midiGain(pRule, d2));
+		break;
+		case MIDI_BANK:
+			board->setMidiBank(n);
+		break;
+	}
+}
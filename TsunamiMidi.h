@@ -0,0 +1,104 @@
+// **************************************************************
+//     Filename: TsunamiMidi.h
+// Date Created: 10/17/2026
+//
+//     Comments: MIDI to Tsunami translation. Parses a raw MIDI byte
+//               stream (running status, real-time bytes and system
+//               exclusive are handled) and maps note on/off, control
+//               change and program change messages through a table
+//               of rules to Tsunami commands. Each block of bytes is
+//               translated in one pass, and the frames it produces
+//               go out in one write.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_MIDI_H_
+#define _TSUNAMI_MIDI_H_
+
+#include <stdint.h>
+
+// Bytes read from the MIDI input per pass of update(), and bytes of
+// frames held back to go out together
+#define MIDI_CHUNK_LEN				32
+#define MIDI_BATCH_LEN				64
+
+// Rule types: the MIDI message a rule matches
+#define MIDI_MAP_NOTE				0
+#define MIDI_MAP_CC					1
+#define MIDI_MAP_PROGRAM			2
+
+// Rule actions
+// Note on plays track base + (note - lo)
+#define MIDI_PLAY_POLY				0
+#define MIDI_PLAY_SOLO				1
+// Control value sets the gain of track base + (cc - lo)
+#define MIDI_TRACK_GAIN				2
+// Control value sets the gain of output base + (cc - lo)
+#define MIDI_MASTER_GAIN			3
+// Program change selects MIDI bank base + (program - lo)
+#define MIDI_BANK					4
+
+// Rule flags
+// Plays with the voice lock
+#define MIDI_LOCK					0x01
+// Note off stops the track
+#define MIDI_OFF_STOPS				0x02
+// Note on velocity sets the track gain before it plays
+#define MIDI_VELOCITY				0x04
+
+// Channel value matching every channel
+#define MIDI_OMNI					0xff
+
+// One translation rule. Rules are tried in order and the first one
+// matching the message type, channel (0-15) and number wins. Gains
+// are scaled linearly from gainMin at value 0 (velocity 1) to
+// gainMax at 127
+struct TsunamiMidiMap {
+	uint8_t type;
+	uint8_t channel;
+	uint8_t lo;
+	uint8_t hi;
+	uint8_t action;
+	uint8_t flags;
+	uint8_t out;
+	int8_t gainMin;
+	int8_t gainMax;
+	uint16_t base;
+};
+
+class Tsunami;
+class TsunamiTransport;
+
+class TsunamiMidi
+{
+public:
+	TsunamiMidi() : board(0), map(0), mapLen(0) { reset(); }
+	void begin(Tsunami *pBoard, const TsunamiMidiMap *pMap, int len);
+	void reset(void);
+	int update(TsunamiTransport *pIn);
+	void parse(const uint8_t *buf, int len);
+	uint32_t getMessages(void) const { return messages; }
+	uint32_t getUnmapped(void) const { return unmapped; }
+
+private:
+	void dispatch(uint8_t status, uint8_t d1, uint8_t d2);
+	const TsunamiMidiMap *find(uint8_t type, uint8_t channel, uint8_t num) const;
+
+	Tsunami *board;
+	const TsunamiMidiMap *map;
+	uint8_t mapLen;
+	// Running status, 0 when none
+	uint8_t status;
+	// Data bytes the current message takes, and those received
+	uint8_t need;
+	uint8_t have;
+	uint8_t data0;
+	// Set inside system exclusive
+	bool sysex;
+	// Channel messages parsed, and those no rule matched
+	uint32_t messages;
+	uint32_t unmapped;
+	uint8_t batch[MIDI_BATCH_LEN];
+};
+
+#endif
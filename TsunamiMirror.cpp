@@ -0,0 +1,425 @@
+// **************************************************************
+//     Filename: TsunamiMirror.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Mirror of the per-track playback state
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+// Flags cleared when a track stops
+#define TRACK_RUN_FLAGS		(TRACK_PLAYING | TRACK_PAUSED | TRACK_LOCKED | \
+							 TRACK_FADING | TRACK_FADE_STOP | TRACK_CONFIRMED)
+
+// **************************************************************
+// Gain sent to the Tsunami, limited to its -70 to +10 dB range
+static int8_t mirrorDb(int16_t gain) {
+
+	if (gain < -70)
+		return -70;
+	if (gain > 10)
+		return 10;
+	return (int8_t)gain;
+}
+
+// **************************************************************
+// Forgets every track
+void TsunamiTrackMirror::clear(void) {
+
+	memset(slotTrack, 0, sizeof(slotTrack));
+	used = 0;
+	overflows = 0;
+}
+
+// **************************************************************
+// Returns the TRACK_* flags of track trk (1-4096), 0 if unknown
+uint8_t TsunamiTrackMirror::getFlags(int trk) const {
+
+int slot = find(trk);
+
+	return (slot < 0) ? 0 : slotFlags[slot];
+}
+
+// **************************************************************
+// Returns the output track trk was last played on, or -1 if no
+// play command was seen for it
+int TsunamiTrackMirror::getOutput(int trk) const {
+
+int slot = find(trk);
+
+	if ((slot < 0) || (slotOut[slot] == 0xff))
+		return -1;
+	return slotOut[slot];
+}
+
+// **************************************************************
+// Returns the number of voices the Tsunami reported playing trk
+int TsunamiTrackMirror::getVoices(int trk) const {
+
+int slot = find(trk);
+
+	return (slot < 0) ? 0 : slotVoices[slot];
+}
+
+// **************************************************************
+// Returns the gain of track trk in dB at time nowMs (millis()).
+// During a fade the gain is interpolated linearly from the gain
+// when the fade began to the target
+int TsunamiTrackMirror::getGain(int trk, uint32_t nowMs) const {
+
+int slot = find(trk);
+uint32_t elapsed;
+
+	if (slot < 0)
+		return 0;
+	if (!(slotFlags[slot] & TRACK_FADING))
+		return slotGain[slot];
+	elapsed = nowMs - slotFadeStart[slot];
+	if (elapsed >= slotFadeMs[slot])
+		return slotTarget[slot];
+	return slotGain[slot] + ((int32_t)(slotTarget[slot] - slotGain[slot]) *
+		(int32_t)elapsed) / (int32_t)slotFadeMs[slot];
+}
+
+// **************************************************************
+// Returns the gain the last fade of trk goes to, or the gain if no
+// fade was sent since the last trackGain()
+int TsunamiTrackMirror::getFadeTarget(int trk) const {
+
+int slot = find(trk);
+
+	if (slot < 0)
+		return 0;
+	return (slotFlags[slot] & TRACK_FADING) ? slotTarget[slot] : slotGain[slot];
+}
+
+// **************************************************************
+// Returns true while a fade of trk is in progress at time nowMs
+bool TsunamiTrackMirror::isFading(int trk, uint32_t nowMs) const {
+
+int slot = find(trk);
+
+	if ((slot < 0) || !(slotFlags[slot] & TRACK_FADING))
+		return false;
+	return (nowMs - slotFadeStart[slot]) < slotFadeMs[slot];
+}
+
+// **************************************************************
+// Returns the millis() time at which the last fade of trk ends, or
+// 0 if no fade was sent since the last trackGain()
+uint32_t TsunamiTrackMirror::getFadeEndMs(int trk) const {
+
+int slot = find(trk);
+
+	if ((slot < 0) || !(slotFlags[slot] & TRACK_FADING))
+		return 0;
+	return slotFadeStart[slot] + slotFadeMs[slot];
+}
+
+// **************************************************************
+// Private internal function called by Tsunami for every command
+// frame it sends. Picks out the commands that change track state
+void TsunamiTrackMirror::sent(const uint8_t *frame, int len, uint32_t nowMs) {
+
+uint16_t trk;
+int16_t gain;
+
+	if (len < TSUNAMI_FRAME_OVERHEAD)
+		return;
+	switch (frame[3]) {
+		case CMD_TRACK_CONTROL:
+			trk = frame[MsgTrackControl::Offset<1>::value] +
+				(frame[MsgTrackControl::Offset<1>::value + 1] << 8);
+			if (frame[MsgTrackControl::Offset<0>::value] == TRK_PLAY_SOLO)
+				stopAll();
+			control(trk, frame[MsgTrackControl::Offset<0>::value],
+				frame[MsgTrackControl::Offset<2>::value],
+				frame[MsgTrackControl::Offset<3>::value]);
+		break;
+		case CMD_TRACK_VOLUME:
+			trk = frame[MsgTrackVolume::Offset<0>::value] +
+				(frame[MsgTrackVolume::Offset<0>::value + 1] << 8);
+			gain = (int16_t)(frame[MsgTrackVolume::Offset<1>::value] +
+				(frame[MsgTrackVolume::Offset<1>::value + 1] << 8));
+			setGain(trk, mirrorDb(gain));
+		break;
+		case CMD_TRACK_FADE:
+			trk = frame[MsgTrackFade::Offset<0>::value] +
+				(frame[MsgTrackFade::Offset<0>::value + 1] << 8);
+			gain = (int16_t)(frame[MsgTrackFade::Offset<1>::value] +
+				(frame[MsgTrackFade::Offset<1>::value + 1] << 8));
+			setFade(trk, mirrorDb(gain),
+				frame[MsgTrackFade::Offset<2>::value] +
+				(frame[MsgTrackFade::Offset<2>::value + 1] << 8),
+				frame[MsgTrackFade::Offset<3>::value] != 0, nowMs);
+		break;
+		case CMD_STOP_ALL:
+			stopAll();
+		break;
+		case CMD_RESUME_ALL_SYNC:
+			resumeAll();
+		break;
+	}
+}
+
+// **************************************************************
+// Private internal function called for every track report. The
+// report of a voice that started after the last play command
+// confirms it; the track stops once its last voice stops. A stop
+// report before the confirmation belongs to an earlier play of the
+// track and leaves the new one alone
+void TsunamiTrackMirror::report(uint16_t trk, bool didStart) {
+
+int slot;
+
+	if (didStart) {
+		slot = insert(trk);
+		if (slot < 0)
+			return;
+		slotFlags[slot] |= TRACK_PLAYING | TRACK_CONFIRMED;
+		slotVoices[slot]++;
+		return;
+	}
+	slot = find(trk);
+	if (slot < 0)
+		return;
+	if (slotVoices[slot])
+		slotVoices[slot]--;
+	if (slotVoices[slot] == 0) {
+		if (slotFlags[slot] & TRACK_CONFIRMED)
+			stopped(slot);
+		release(slot);
+	}
+}
+
+// **************************************************************
+// Private internal function for a CMD_TRACK_CONTROL command
+void TsunamiTrackMirror::control(uint16_t trk, uint8_t code, uint8_t out, uint8_t flags) {
+
+int slot;
+
+	switch (code) {
+		case TRK_PLAY_SOLO:
+		case TRK_PLAY_POLY:
+		case TRK_LOAD:
+			slot = insert(trk);
+			if (slot < 0)
+				return;
+			slotFlags[slot] &= ~(TRACK_PAUSED | TRACK_LOCKED | TRACK_CONFIRMED);
+			slotFlags[slot] |= TRACK_PLAYING;
+			if (code == TRK_LOAD)
+				slotFlags[slot] |= TRACK_PAUSED;
+			if (flags & 0x01)
+				slotFlags[slot] |= TRACK_LOCKED;
+			slotOut[slot] = out;
+		break;
+		case TRK_LOOP_ON:
+			slot = insert(trk);
+			if (slot >= 0)
+				slotFlags[slot] |= TRACK_LOOPING;
+		break;
+		default:
+			slot = find(trk);
+			if (slot < 0)
+				return;
+			if (code == TRK_STOP)
+				stopped(slot);
+			else if ((code == TRK_PAUSE) && (slotFlags[slot] & TRACK_PLAYING))
+				slotFlags[slot] |= TRACK_PAUSED;
+			else if (code == TRK_RESUME)
+				slotFlags[slot] &= ~TRACK_PAUSED;
+			else if (code == TRK_LOOP_OFF)
+				slotFlags[slot] &= ~TRACK_LOOPING;
+			release(slot);
+		break;
+	}
+}
+
+// **************************************************************
+// Private internal function for a CMD_TRACK_VOLUME command
+void TsunamiTrackMirror::setGain(uint16_t trk, int8_t gain) {
+
+int slot;
+
+	slot = (gain == 0) ? find(trk) : insert(trk);
+	if (slot < 0)
+		return;
+	slotGain[slot] = gain;
+	slotFlags[slot] &= ~(TRACK_FADING | TRACK_FADE_STOP);
+	release(slot);
+}
+
+// **************************************************************
+// Private internal function for a CMD_TRACK_FADE command. The fade
+// starts from wherever the gain is now, which may be part way
+// through an earlier fade
+void TsunamiTrackMirror::setFade(uint16_t trk, int8_t gain, uint16_t ms, bool stop, uint32_t nowMs) {
+
+int slot;
+int8_t from;
+
+	from = (int8_t)getGain(trk, nowMs);
+	slot = insert(trk);
+	if (slot < 0)
+		return;
+	slotGain[slot] = from;
+	slotTarget[slot] = gain;
+	slotFadeMs[slot] = ms;
+	slotFadeStart[slot] = nowMs;
+	slotFlags[slot] |= TRACK_FADING;
+	if (stop)
+		slotFlags[slot] |= TRACK_FADE_STOP;
+	else
+		slotFlags[slot] &= ~TRACK_FADE_STOP;
+}
+
+// **************************************************************
+// Private internal function for CMD_STOP_ALL (and play solo)
+void TsunamiTrackMirror::stopAll(void) {
+
+int slot;
+
+	for (slot = 0; slot < TRACK_MIRROR_LEN; slot++) {
+		if (slotTrack[slot])
+			stopped(slot);
+	}
+	// Dropping an entry moves a later one into its slot, so the
+	// slot is looked at again before moving on
+	for (slot = 0; slot < TRACK_MIRROR_LEN; ) {
+		if (slotTrack[slot] && (slotVoices[slot] == 0) &&
+			!(slotFlags[slot] & TRACK_LOOPING) && (slotGain[slot] == 0))
+			erase(slot);
+		else
+			slot++;
+	}
+}
+
+// **************************************************************
+// Private internal function for CMD_RESUME_ALL_SYNC
+void TsunamiTrackMirror::resumeAll(void) {
+
+int slot;
+
+	for (slot = 0; slot < TRACK_MIRROR_LEN; slot++) {
+		if (slotTrack[slot])
+			slotFlags[slot] &= ~TRACK_PAUSED;
+	}
+}
+
+// **************************************************************
+// Private: returns the slot holding trk, or -1
+int TsunamiTrackMirror::find(int trk) const {
+
+int slot;
+
+	if ((trk < 1) || (trk > 4096))
+		return -1;
+	slot = trk & TRACK_MIRROR_MASK;
+	while (slotTrack[slot]) {
+		if (slotTrack[slot] == trk)
+			return slot;
+		slot = (slot + 1) & TRACK_MIRROR_MASK;
+	}
+	return -1;
+}
+
+// **************************************************************
+// Private: returns the slot holding trk, adding it in its default
+// state if needed. When the table is full, a track that is not
+// playing is dropped to make room. Returns -1 if every slot holds
+// a playing track
+int TsunamiTrackMirror::insert(uint16_t trk) {
+
+int slot;
+
+	slot = find(trk);
+	if (slot >= 0)
+		return slot;
+	if ((trk < 1) || (trk > 4096))
+		return -1;
+	if (used >= TRACK_MIRROR_MAX_USED) {
+		overflows++;
+		for (slot = 0; slot < TRACK_MIRROR_LEN; slot++) {
+			if (slotTrack[slot] && !(slotFlags[slot] & TRACK_PLAYING) &&
+				(slotVoices[slot] == 0))
+				break;
+		}
+		if (slot == TRACK_MIRROR_LEN)
+			return -1;
+		erase(slot);
+	}
+	slot = trk & TRACK_MIRROR_MASK;
+	while (slotTrack[slot])
+		slot = (slot + 1) & TRACK_MIRROR_MASK;
+	slotTrack[slot] = trk;
+	slotFlags[slot] = 0;
+	slotOut[slot] = 0xff;
+	slotVoices[slot] = 0;
+	slotGain[slot] = 0;
+	slotTarget[slot] = 0;
+	slotFadeMs[slot] = 0;
+	slotFadeStart[slot] = 0;
+	used++;
+	return slot;
+}
+
+// **************************************************************
+// Private: marks the track in slot stopped. A fade in progress is
+// taken as finished, so the gain is left at its target
+void TsunamiTrackMirror::stopped(int slot) {
+
+	if (slotFlags[slot] & TRACK_FADING)
+		slotGain[slot] = slotTarget[slot];
+	slotFlags[slot] &= ~TRACK_RUN_FLAGS;
+}
+
+// **************************************************************
+// Private: drops the track in slot if it is back in its default
+// state: stopped, not looping, at 0 dB
+void TsunamiTrackMirror::release(int slot) {
+
+	if ((slotVoices[slot] == 0) && (slotGain[slot] == 0) &&
+		!(slotFlags[slot] & (TRACK_PLAYING | TRACK_PAUSED | TRACK_LOOPING | TRACK_FADING)))
+		erase(slot);
+}
+
+// **************************************************************
+// Private: empties a slot, moving later entries of the same probe
+// run back so that every entry stays reachable from its home slot
+void TsunamiTrackMirror::erase(int slot) {
+
+int next;
+int home;
+
+	next = slot;
+	for (;;) {
+		next = (next + 1) & TRACK_MIRROR_MASK;
+		if (slotTrack[next] == 0)
+			break;
+		home = slotTrack[next] & TRACK_MIRROR_MASK;
+		// Entry at next can move to slot unless its home lies
+		// cyclically in (slot, next]
+		if (((next > slot) && ((home <= slot) || (home > next))) ||
+			((next < slot) && ((home <= slot) && (home > next)))) {
+			move(slot, next);
+			slot = next;
+		}
+	}
+	slotTrack[slot] = 0;
+	used--;
+}
+
+// **************************************************************
+// Private: copies the entry in slot src to slot dst
+void TsunamiTrackMirror::move(int dst, int src) {
+
+	slotTrack[dst] = slotTrack[src];
+	slotFlags[dst] = slotFlags[src];
+	slotOut[dst] = slotOut[src];
+	slotVoices[dst] = slotVoices[src];
+	slotGain[dst] = slotGain[src];
+	slotTarget[dst] = slotTarget[src];
+	slotFadeMs[dst] = slotFadeMs[src];
+	slotFadeStart[dst] = slotFadeStart[src];
+}
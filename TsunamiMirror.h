@@ -0,0 +1,104 @@
+// **************************************************************
+//     Filename: TsunamiMirror.h
+// Date Created: 10/17/2026
+//
+//     Comments: Mirror of the playback state of the tracks in use:
+//               playing and paused status, loop flag, output, lock,
+//               gain and fade in progress. Kept current from the
+//               commands sent (whatever sent them: the track
+//               functions, a cue list or a group) and from the track
+//               reports, so it can be read at any time without a
+//               round trip to the Tsunami.
+//
+//               Only tracks away from their default state take a
+//               slot: a track that is stopped, not looping and at
+//               0 dB is dropped from the table.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_MIRROR_H_
+#define _TSUNAMI_MIRROR_H_
+
+#include <stdint.h>
+
+// Slots in the table, a power of 2. At most three quarters of them
+// are used, so that every lookup stays short
+#ifndef TRACK_MIRROR_LEN
+#define TRACK_MIRROR_LEN			32
+#endif
+#if (TRACK_MIRROR_LEN & (TRACK_MIRROR_LEN - 1)) != 0
+#error "TRACK_MIRROR_LEN must be a power of 2"
+#endif
+#define TRACK_MIRROR_MASK			(TRACK_MIRROR_LEN - 1)
+#define TRACK_MIRROR_MAX_USED		(TRACK_MIRROR_LEN - TRACK_MIRROR_LEN / 4)
+
+// Per track flags, see TsunamiTrackMirror::getFlags()
+// Play, poly or load sent, or a start reported, and no stop since
+#define TRACK_PLAYING				0x01
+// Paused, or loaded and not resumed yet
+#define TRACK_PAUSED				0x02
+// Loop enabled
+#define TRACK_LOOPING				0x04
+// Played with the voice lock
+#define TRACK_LOCKED				0x08
+// A fade is in progress (or ended and no other command since)
+#define TRACK_FADING				0x10
+// The fade stops the track when it ends
+#define TRACK_FADE_STOP				0x20
+// The Tsunami reported a voice since the last play command
+#define TRACK_CONFIRMED				0x40
+
+class TsunamiTrackMirror
+{
+public:
+	TsunamiTrackMirror() { clear(); }
+	void clear(void);
+	bool isKnown(int trk) const { return find(trk) >= 0; }
+	bool isPlaying(int trk) const { return (getFlags(trk) & TRACK_PLAYING) != 0; }
+	bool isPaused(int trk) const { return (getFlags(trk) & TRACK_PAUSED) != 0; }
+	bool isLooping(int trk) const { return (getFlags(trk) & TRACK_LOOPING) != 0; }
+	uint8_t getFlags(int trk) const;
+	int getOutput(int trk) const;
+	int getVoices(int trk) const;
+	int getGain(int trk, uint32_t nowMs) const;
+	int getFadeTarget(int trk) const;
+	bool isFading(int trk, uint32_t nowMs) const;
+	uint32_t getFadeEndMs(int trk) const;
+	int getNumKnown(void) const { return used; }
+	uint16_t getOverflows(void) const { return overflows; }
+
+private:
+	friend class Tsunami;
+
+	void sent(const uint8_t *frame, int len, uint32_t nowMs);
+	void report(uint16_t trk, bool didStart);
+	void control(uint16_t trk, uint8_t code, uint8_t out, uint8_t flags);
+	void setGain(uint16_t trk, int8_t gain);
+	void setFade(uint16_t trk, int8_t gain, uint16_t ms, bool stop, uint32_t nowMs);
+	void stopAll(void);
+	void resumeAll(void);
+	int find(int trk) const;
+	int insert(uint16_t trk);
+	void stopped(int slot);
+	void release(int slot);
+	void erase(int slot);
+	void move(int dst, int src);
+
+	// Open addressing with linear probing, 0 marks an empty slot
+	uint16_t slotTrack[TRACK_MIRROR_LEN];
+	uint8_t slotFlags[TRACK_MIRROR_LEN];
+	// Output, 0xff until a play command was seen
+	uint8_t slotOut[TRACK_MIRROR_LEN];
+	// Voices reported playing the track
+	uint8_t slotVoices[TRACK_MIRROR_LEN];
+	// Gain in dB; while fading, the gain when the fade began
+	int8_t slotGain[TRACK_MIRROR_LEN];
+	int8_t slotTarget[TRACK_MIRROR_LEN];
+	uint16_t slotFadeMs[TRACK_MIRROR_LEN];
+	uint32_t slotFadeStart[TRACK_MIRROR_LEN];
+	uint8_t used;
+	// Tracks that could not be added to a full table
+	uint16_t overflows;
+};
+
+#endif
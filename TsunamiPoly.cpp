@@ -0,0 +1,368 @@
+// **************************************************************
+//     Filename: TsunamiPoly.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Host-side polyphony manager
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+#ifndef __TSUNAMI_USE_HOST__
+#include <Arduino.h>
+#endif
+
+// **************************************************************
+// Forgets every track and clears the counters. Tsunami::start()
+// calls it, as the board starts with every voice free
+void TsunamiPolyManager::clear(void) {
+
+int i;
+
+	memset(hash, POLY_NONE, sizeof(hash));
+	for (i = 0; i < POLY_ENTRIES; i++)
+		lruNext[i] = (i + 1 < POLY_ENTRIES) ? i + 1 : POLY_NONE;
+	freeHead = 0;
+	for (i = 0; i < POLY_PRIO_LEVELS; i++) {
+		lruHead[i] = POLY_NONE;
+		lruTail[i] = POLY_NONE;
+	}
+	pendHead = POLY_NONE;
+	pendTail = POLY_NONE;
+	order = 0;
+	limit = MAX_NUM_VOICES;
+	busy = 0;
+	pending = 0;
+	stopping = 0;
+	stolen = 0;
+	rejected = 0;
+	expired = 0;
+}
+
+// **************************************************************
+// Private internal function returning the time in microseconds,
+// from the clock set with setClock() or micros()
+uint32_t TsunamiPolyManager::now(void) {
+
+	return clock ? clock() : micros();
+}
+
+// **************************************************************
+// Returns the priority of track trk (1-4096), or -1 if the track
+// is neither playing nor waiting for its report
+int TsunamiPolyManager::getPriority(int trk) const {
+
+int e = find((uint16_t)trk);
+
+	return (e < 0) ? -1 : entPrio[e];
+}
+
+// **************************************************************
+// Private: returns the entry of trk, or -1
+int TsunamiPolyManager::find(uint16_t trk) const {
+
+int slot = trk & POLY_HASH_MASK;
+
+	while (hash[slot] != POLY_NONE) {
+		if (entTrack[hash[slot]] == trk)
+			return hash[slot];
+		slot = (slot + 1) & POLY_HASH_MASK;
+	}
+	return -1;
+}
+
+// **************************************************************
+// Private: adds an entry for trk, which must not have one. Returns
+// -1 if every entry is taken
+int TsunamiPolyManager::insert(uint16_t trk, uint8_t prio) {
+
+int slot = trk & POLY_HASH_MASK;
+uint8_t e = freeHead;
+
+	if (e == POLY_NONE)
+		return -1;
+	freeHead = lruNext[e];
+	while (hash[slot] != POLY_NONE)
+		slot = (slot + 1) & POLY_HASH_MASK;
+	hash[slot] = e;
+	entTrack[e] = trk;
+	entPrio[e] = prio;
+	entVoices[e] = 0;
+	entPending[e] = 0;
+	lruAppend(e);
+	return e;
+}
+
+// **************************************************************
+// Private: drops entry e, whose voices and plays stop counting
+void TsunamiPolyManager::release(uint8_t e) {
+
+int slot = entTrack[e] & POLY_HASH_MASK;
+int next;
+int home;
+
+	busy -= entVoices[e];
+	if (entPending[e]) {
+		pending -= entPending[e];
+		pendUnlink(e);
+	}
+	lruUnlink(e);
+	while (hash[slot] != e)
+		slot = (slot + 1) & POLY_HASH_MASK;
+	// Close the gap: an entry further on moves back unless its home
+	// slot lies cyclically in (slot, next]
+	next = slot;
+	for (;;) {
+		next = (next + 1) & POLY_HASH_MASK;
+		if (hash[next] == POLY_NONE)
+			break;
+		home = entTrack[hash[next]] & POLY_HASH_MASK;
+		if (((next > slot) && ((home <= slot) || (home > next))) ||
+			((next < slot) && ((home <= slot) && (home > next)))) {
+			hash[slot] = hash[next];
+			slot = next;
+		}
+	}
+	hash[slot] = POLY_NONE;
+	lruNext[e] = freeHead;
+	freeHead = e;
+}
+
+// **************************************************************
+// Private: takes entry e out of the age order of its priority
+void TsunamiPolyManager::lruUnlink(uint8_t e) {
+
+uint8_t p = entPrio[e];
+
+	if (lruPrev[e] != POLY_NONE)
+		lruNext[lruPrev[e]] = lruNext[e];
+	else
+		lruHead[p] = lruNext[e];
+	if (lruNext[e] != POLY_NONE)
+		lruPrev[lruNext[e]] = lruPrev[e];
+	else
+		lruTail[p] = lruPrev[e];
+}
+
+// **************************************************************
+// Private: makes entry e the youngest of its priority
+void TsunamiPolyManager::lruAppend(uint8_t e) {
+
+uint8_t p = entPrio[e];
+
+	lruPrev[e] = lruTail[p];
+	lruNext[e] = POLY_NONE;
+	if (lruTail[p] != POLY_NONE)
+		lruNext[lruTail[p]] = e;
+	else
+		lruHead[p] = e;
+	lruTail[p] = e;
+	entOrder[e] = order++;
+}
+
+// **************************************************************
+// Private: takes entry e out of the waiting plays
+void TsunamiPolyManager::pendUnlink(uint8_t e) {
+
+	if (pendPrev[e] != POLY_NONE)
+		pendNext[pendPrev[e]] = pendNext[e];
+	else
+		pendHead = pendNext[e];
+	if (pendNext[e] != POLY_NONE)
+		pendPrev[pendNext[e]] = pendPrev[e];
+	else
+		pendTail = pendPrev[e];
+}
+
+// **************************************************************
+// Private: entry e waits for a report from now on
+void TsunamiPolyManager::pendAppend(uint8_t e) {
+
+	pendPrev[e] = pendTail;
+	pendNext[e] = POLY_NONE;
+	if (pendTail != POLY_NONE)
+		pendNext[pendTail] = e;
+	else
+		pendHead = e;
+	pendTail = e;
+	pendSince[e] = now();
+}
+
+// **************************************************************
+// Private: plays waiting longer than POLY_CONFIRM_US stop counting.
+// The oldest wait is at the head, so this stops at the first entry
+// still in time. So do stopping voices once the last stop is that
+// old
+void TsunamiPolyManager::expire(void) {
+
+uint32_t t = now();
+uint8_t e;
+
+	while ((pendHead != POLY_NONE) && ((uint32_t)(t - pendSince[pendHead]) >= POLY_CONFIRM_US)) {
+		e = pendHead;
+		expired += entPending[e];
+		pending -= entPending[e];
+		entPending[e] = 0;
+		pendUnlink(e);
+		if (!entVoices[e])
+			release(e);
+	}
+	if (stopping && ((uint32_t)(t - stopSince) >= POLY_CONFIRM_US)) {
+		expired += stopping;
+		stopping = 0;
+	}
+}
+
+// **************************************************************
+// Private: called before a play on a board with voices voices.
+// Returns false, and counts the play refused, if no voice is free
+bool TsunamiPolyManager::admit(int voices) {
+
+	limit = budget;
+	if ((limit == 0) || (limit > voices))
+		limit = voices;
+	expire();
+	if ((busy + pending + stopping) < limit)
+		return true;
+	rejected++;
+	return false;
+}
+
+// **************************************************************
+// Private: called after admit() and before the play of trk with
+// priority prio. Returns a track to stop so that the reserve stays
+// free after the play, or 0 if none is needed or may be stopped. The
+// track's entry is dropped and its voices count as stopping. Voices
+// already stopping are left out of the reserve, as they will be
+// free, so the next call sees the room the track leaves. Looks at
+// the head of each priority list only, and at the next entry when
+// the head is trk
+int TsunamiPolyManager::victim(uint16_t trk, uint8_t prio) {
+
+uint8_t best = POLY_NONE;
+uint8_t e;
+int p;
+
+	if ((mode == POLY_REJECT) || ((busy + pending + 1 + reserve) <= limit))
+		return 0;
+	if (prio >= POLY_PRIO_PROTECTED)
+		prio = POLY_PRIO_PROTECTED - 1;
+	for (p = 0; p <= prio; p++) {
+		e = lruHead[p];
+		if ((e != POLY_NONE) && (entTrack[e] == trk))
+			e = lruNext[e];
+		if (e == POLY_NONE)
+			continue;
+		if ((best == POLY_NONE) || ((int32_t)(entOrder[e] - entOrder[best]) < 0))
+			best = e;
+		if (mode == POLY_STEAL_LOWEST)
+			break;
+	}
+	if (best == POLY_NONE)
+		return 0;
+	if (entVoices[best]) {
+		stopping += entVoices[best];
+		stopSince = now();
+	}
+	trk = entTrack[best];
+	release(best);
+	stolen++;
+	return trk;
+}
+
+// **************************************************************
+// Private: a play of trk with priority prio is being sent. A track
+// already known keeps the higher of its two priorities
+bool TsunamiPolyManager::played(uint16_t trk, uint8_t prio) {
+
+int e = find(trk);
+
+	if (e < 0) {
+		e = insert(trk, prio);
+		if (e < 0) {
+			rejected++;
+			return false;
+		}
+	}
+	else {
+		lruUnlink(e);
+		if (prio > entPrio[e])
+			entPrio[e] = prio;
+		lruAppend(e);
+	}
+	if (!entPending[e])
+		pendAppend(e);
+	entPending[e]++;
+	pending++;
+	return true;
+}
+
+// **************************************************************
+// Private: a play of track was discarded before it went out, and
+// will never be reported
+void TsunamiPolyManager::withdrawn(uint16_t track) {
+
+int e = find(track);
+
+	if ((e < 0) || !entPending[e])
+		return;
+	entPending[e]--;
+	pending--;
+	if (!entPending[e]) {
+		pendUnlink(e);
+		if (!entVoices[e])
+			release(e);
+	}
+}
+
+// **************************************************************
+// Private: a track report started track on a voice that held
+// oldTrack, 0xffff if none. A track the manager did not play gets
+// the default priority
+void TsunamiPolyManager::started(uint16_t track, uint16_t oldTrack) {
+
+int e;
+
+	expire();
+	// A voice taken by the board moves from one track to the other
+	e = (oldTrack != 0xffff) ? find(oldTrack) : -1;
+	if ((e >= 0) && entVoices[e]) {
+		entVoices[e]--;
+		busy--;
+		if (!entVoices[e] && !entPending[e])
+			release(e);
+	}
+	e = find(track);
+	if (e < 0) {
+		e = insert(track, defaultPrio);
+		if (e < 0)
+			return;
+	}
+	if (entPending[e]) {
+		entPending[e]--;
+		pending--;
+		pendUnlink(e);
+		if (entPending[e])
+			pendAppend(e);
+	}
+	entVoices[e]++;
+	busy++;
+}
+
+// **************************************************************
+// Private: a track report stopped track on one of its voices
+void TsunamiPolyManager::stopped(uint16_t track) {
+
+int e = find(track);
+
+	// A voice of a track stopped by victim()
+	if ((e < 0) || !entVoices[e]) {
+		if (stopping)
+			stopping--;
+		return;
+	}
+	entVoices[e]--;
+	busy--;
+	if (!entVoices[e] && !entPending[e])
+		release(e);
+}
@@ -0,0 +1,136 @@
+// **************************************************************
+//     Filename: TsunamiPoly.h
+// Date Created: 10/17/2026
+//
+//     Comments: Host-side polyphony manager. Keeps the voices in use
+//               (from the track reports), the plays sent and not yet
+//               reported and the voices still stopping within a
+//               voice budget, so the board never has to steal. Each
+//               track gets a priority. A play keeps a reserve of free
+//               voices by stopping the oldest track of its priority
+//               or lower ahead of time, and is refused only when no
+//               voice is free. Tracks played with POLY_PRIO_PROTECTED
+//               are never stopped.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_POLY_H_
+#define _TSUNAMI_POLY_H_
+
+#include <stdint.h>
+
+// Track priorities. A play only takes voices from tracks of its own
+// priority or lower. Protected tracks are played with the voice lock
+#define POLY_PRIO_LOW				0
+#define POLY_PRIO_NORMAL			1
+#define POLY_PRIO_HIGH				2
+#define POLY_PRIO_PROTECTED			3
+#define POLY_PRIO_LEVELS			4
+
+// Which track a play stops to keep the reserve free
+#define POLY_STEAL_LRU				0	// the track played longest ago
+#define POLY_STEAL_LOWEST			1	// the oldest track of the lowest priority
+#define POLY_REJECT					2	// none: plays are refused once the budget is full
+
+// Voices kept free by default. A stopped voice is only free again
+// once the board reports it, so this many plays can come within the
+// report latency (about 3 ms) without being refused
+#define POLY_RESERVE				1
+
+// Tracks known at once: every voice busy with another track and as
+// many plays waiting for their report
+#define POLY_ENTRIES				(2 * MAX_NUM_VOICES)
+// Track lookup table length, a power of 2 at least twice POLY_ENTRIES
+#define POLY_HASH_LEN				128
+#define POLY_HASH_MASK				(POLY_HASH_LEN - 1)
+// A play not reported within this time (the track is missing, or
+// reporting is off), or a stop whose reports did not come, stops
+// counting against the budget
+#define POLY_CONFIRM_US				200000UL
+
+#define POLY_NONE					0xff
+
+class TsunamiPolyManager
+{
+public:
+	TsunamiPolyManager() : clock(0), mode(POLY_STEAL_LRU), budget(0), reserve(POLY_RESERVE),
+		defaultPrio(POLY_PRIO_NORMAL) { clear(); }
+	void clear(void);
+	void setClock(uint32_t (*pFunc)(void)) { clock = pFunc; }
+	void setMode(int m) { mode = (uint8_t)m; }
+	void setBudget(int n) { budget = (uint8_t)n; }
+	int getBudget(void) const { return budget; }
+	void setReserve(int n) { reserve = (uint8_t)n; }
+	void setDefaultPriority(int prio) { defaultPrio = (uint8_t)prio; }
+	int getPriority(int trk) const;
+	int getUsed(void) const { return busy + pending + stopping; }
+	int getBusy(void) const { return busy; }
+	int getPending(void) const { return pending; }
+	int getStopping(void) const { return stopping; }
+	uint32_t getStolen(void) const { return stolen; }
+	uint32_t getRejected(void) const { return rejected; }
+	uint32_t getExpired(void) const { return expired; }
+
+private:
+	friend class Tsunami;
+
+	uint32_t now(void);
+	int find(uint16_t trk) const;
+	int insert(uint16_t trk, uint8_t prio);
+	void release(uint8_t e);
+	void lruUnlink(uint8_t e);
+	void lruAppend(uint8_t e);
+	void pendUnlink(uint8_t e);
+	void pendAppend(uint8_t e);
+	void expire(void);
+	bool admit(int voices);
+	int victim(uint16_t trk, uint8_t prio);
+	bool played(uint16_t trk, uint8_t prio);
+	void withdrawn(uint16_t track);
+	void started(uint16_t track, uint16_t oldTrack);
+	void stopped(uint16_t track);
+
+	uint32_t (*clock)(void);
+	uint8_t mode;
+	// Voices the manager may fill, 0 for all the board has
+	uint8_t budget;
+	uint8_t reserve;
+	// Budget in force, from the last admit()
+	uint8_t limit;
+	// Priority of tracks the manager did not play
+	uint8_t defaultPrio;
+	// Per track entry: track number, priority, voices reported and
+	// plays waiting for their report
+	uint16_t entTrack[POLY_ENTRIES];
+	uint8_t entPrio[POLY_ENTRIES];
+	uint8_t entVoices[POLY_ENTRIES];
+	uint8_t entPending[POLY_ENTRIES];
+	// Age order within each priority, oldest at the head. The order
+	// number breaks ties between priorities in POLY_STEAL_LRU mode
+	uint8_t lruPrev[POLY_ENTRIES];
+	uint8_t lruNext[POLY_ENTRIES];
+	uint32_t entOrder[POLY_ENTRIES];
+	uint8_t lruHead[POLY_PRIO_LEVELS];
+	uint8_t lruTail[POLY_PRIO_LEVELS];
+	// Entries with plays waiting, oldest wait first, and its start
+	uint8_t pendPrev[POLY_ENTRIES];
+	uint8_t pendNext[POLY_ENTRIES];
+	uint32_t pendSince[POLY_ENTRIES];
+	uint8_t pendHead;
+	uint8_t pendTail;
+	// Unused entries, chained through lruNext
+	uint8_t freeHead;
+	// Entry of each track, POLY_NONE for empty
+	uint8_t hash[POLY_HASH_LEN];
+	uint32_t order;
+	uint8_t busy;
+	uint8_t pending;
+	// Voices of stopped tracks not reported free yet, and since when
+	uint8_t stopping;
+	uint32_t stopSince;
+	uint32_t stolen;
+	uint32_t rejected;
+	uint32_t expired;
+};
+
+#endif
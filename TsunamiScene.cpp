@@ -0,0 +1,124 @@
+// **************************************************************
+//     Filename: TsunamiScene.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Mixer scenes
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+// Little-endian 16 bit field at p
+static int16_t sceneField(const uint8_t *p) {
+
+	return (int16_t)(p[0] | (p[1] << 8));
+}
+
+// **************************************************************
+// Records the setting carried by frame, if it is a master gain,
+// samplerate offset or input mix frame
+void TsunamiOutputState::sent(const uint8_t *frame) {
+
+uint8_t out;
+
+	switch (frame[3]) {
+		case CMD_MASTER_VOLUME:
+			out = frame[MsgMasterVolume::Offset<0>::value] & 0x07;
+			gain[out] = sceneField(frame + MsgMasterVolume::Offset<1>::value);
+			known |= 1UL << out;
+		break;
+		case CMD_SAMPLERATE_OFFSET:
+			out = frame[MsgSamplerateOffset::Offset<0>::value] & 0x07;
+			rate[out] = sceneField(frame + MsgSamplerateOffset::Offset<1>::value);
+			known |= SCENE_KNOWN_RATE(out);
+		break;
+		case CMD_SET_INPUT_MIX:
+			mix = frame[MsgSetInputMix::Offset<0>::value];
+			known |= SCENE_KNOWN_MIX;
+		break;
+	}
+}
+
+// **************************************************************
+// A scene with every output at 0 dB, no samplerate offset and the
+// input mixed to no output
+TsunamiScene::TsunamiScene() {
+
+int i;
+
+	for (i = 0; i < TSUNAMI_NUM_OUTPUTS; i++) {
+		MsgMasterVolume::encode(blob + SCENE_GAIN_OFS + i * MsgMasterVolume::LEN, i, 0);
+		MsgSamplerateOffset::encode(blob + SCENE_RATE_OFS + i * MsgSamplerateOffset::LEN, i, 0);
+	}
+	MsgSetInputMix::encode(blob + SCENE_MIX_OFS, 0);
+}
+
+// **************************************************************
+// Sets the master gain of output out (0-7) to gain dB
+void TsunamiScene::setGain(int out, int gain) {
+
+	out &= 0x07;
+	MsgMasterVolume::encode(blob + SCENE_GAIN_OFS + out * MsgMasterVolume::LEN, out, (uint16_t)gain);
+}
+
+// **************************************************************
+// Sets the samplerate offset of output out (0-7), see
+// Tsunami::samplerateOffset()
+void TsunamiScene::setRate(int out, int offset) {
+
+	out &= 0x07;
+	MsgSamplerateOffset::encode(blob + SCENE_RATE_OFS + out * MsgSamplerateOffset::LEN, out, (uint16_t)offset);
+}
+
+// **************************************************************
+// Sets the input mix, IMIX_OUT1 ... IMIX_OUT4 or'ed together
+void TsunamiScene::setInputMix(int mix) {
+
+	MsgSetInputMix::encode(blob + SCENE_MIX_OFS, mix);
+}
+
+// **************************************************************
+// Returns the master gain of output out (0-7)
+int TsunamiScene::getGain(int out) const {
+
+	return sceneField(blob + SCENE_GAIN_OFS + (out & 0x07) * MsgMasterVolume::LEN +
+		MsgMasterVolume::Offset<1>::value);
+}
+
+// **************************************************************
+// Returns the samplerate offset of output out (0-7)
+int TsunamiScene::getRate(int out) const {
+
+	return sceneField(blob + SCENE_RATE_OFS + (out & 0x07) * MsgSamplerateOffset::LEN +
+		MsgSamplerateOffset::Offset<1>::value);
+}
+
+// **************************************************************
+// Copies to pDst (SCENE_BLOB_LEN bytes) the frames of the settings
+// that are not known in pState to hold the scene's value, one after
+// the other. pState NULL copies them all. Returns the bytes copied
+int TsunamiScene::delta(const TsunamiOutputState *pState, uint8_t *pDst) const {
+
+const uint8_t *p;
+int len = 0;
+int i;
+
+	for (i = 0; i < TSUNAMI_NUM_OUTPUTS; i++) {
+		if (!pState || !(pState->known & (1UL << i)) || (pState->gain[i] != getGain(i))) {
+			memcpy(pDst + len, blob + SCENE_GAIN_OFS + i * MsgMasterVolume::LEN, MsgMasterVolume::LEN);
+			len += MsgMasterVolume::LEN;
+		}
+	}
+	for (i = 0; i < TSUNAMI_NUM_OUTPUTS; i++) {
+		if (!pState || !(pState->known & SCENE_KNOWN_RATE(i)) || (pState->rate[i] != getRate(i))) {
+			memcpy(pDst + len, blob + SCENE_RATE_OFS + i * MsgSamplerateOffset::LEN, MsgSamplerateOffset::LEN);
+			len += MsgSamplerateOffset::LEN;
+		}
+	}
+	p = blob + SCENE_MIX_OFS;
+	if (!pState || !(pState->known & SCENE_KNOWN_MIX) || (pState->mix != p[MsgSetInputMix::Offset<0>::value])) {
+		memcpy(pDst + len, p, MsgSetInputMix::LEN);
+		len += MsgSetInputMix::LEN;
+	}
+	return len;
+}
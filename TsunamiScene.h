@@ -0,0 +1,66 @@
+// **************************************************************
+//     Filename: TsunamiScene.h
+// Date Created: 10/17/2026
+//
+//     Comments: Mixer scenes. A TsunamiScene holds the master gain
+//               and samplerate offset of every output and the input
+//               mix, kept encoded as one block of frames that is
+//               updated in place by the setters. Tsunami::applyScene()
+//               sends only the frames whose value differs from what
+//               was last sent to the board (TsunamiOutputState), in
+//               a single write.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_SCENE_H_
+#define _TSUNAMI_SCENE_H_
+
+#include <stdint.h>
+
+// Layout of the frame block: the master gain of each output, the
+// samplerate offset of each output, then the input mix
+#define SCENE_GAIN_OFS			0
+#define SCENE_RATE_OFS			(SCENE_GAIN_OFS + TSUNAMI_NUM_OUTPUTS * MsgMasterVolume::LEN)
+#define SCENE_MIX_OFS			(SCENE_RATE_OFS + TSUNAMI_NUM_OUTPUTS * MsgSamplerateOffset::LEN)
+#define SCENE_BLOB_LEN			(SCENE_MIX_OFS + MsgSetInputMix::LEN)
+
+// Bits of TsunamiOutputState::known: bit n for the gain of output n,
+// bit 8 + n for its samplerate offset, SCENE_KNOWN_MIX for the mix
+#define SCENE_KNOWN_RATE(n)		(1UL << (TSUNAMI_NUM_OUTPUTS + (n)))
+#define SCENE_KNOWN_MIX			(1UL << (2 * TSUNAMI_NUM_OUTPUTS))
+#define SCENE_KNOWN_ALL			((SCENE_KNOWN_MIX << 1) - 1)
+
+// The output settings last sent to a board, taken from every master
+// gain, samplerate offset and input mix frame it is sent
+class TsunamiOutputState
+{
+public:
+	TsunamiOutputState() { clear(); }
+	void clear(void) { known = 0; }
+	void sent(const uint8_t *frame);
+
+	int16_t gain[TSUNAMI_NUM_OUTPUTS];
+	int16_t rate[TSUNAMI_NUM_OUTPUTS];
+	uint8_t mix;
+	// Which of the above were sent since start()
+	uint32_t known;
+};
+
+class TsunamiScene
+{
+public:
+	TsunamiScene();
+	void setGain(int out, int gain);
+	void setRate(int out, int offset);
+	void setInputMix(int mix);
+	int getGain(int out) const;
+	int getRate(int out) const;
+	int getInputMix(void) const { return blob[SCENE_MIX_OFS + MsgSetInputMix::Offset<0>::value]; }
+	const uint8_t *getFrames(void) const { return blob; }
+	int delta(const TsunamiOutputState *pState, uint8_t *pDst) const;
+
+private:
+	uint8_t blob[SCENE_BLOB_LEN];
+};
+
+#endif
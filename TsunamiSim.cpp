@@ -0,0 +1,541 @@
+// **************************************************************
+//     Filename: TsunamiSim.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: In-process Tsunami simulator
+//
+// **************************************************************
+
+#include "TsunamiSim.h"
+
+#define SIM_RX_MASK		(TSUNAMI_SIM_RX_LEN - 1)
+
+// Signed difference between two wrapping microsecond timestamps
+#define SIM_ELAPSED(now, t)	((int32_t)((uint32_t)(now) - (uint32_t)(t)))
+
+// **************************************************************
+// Default track length callback: every track is the same length
+static uint32_t simDefaultTrackLength(uint16_t track) {
+
+	(void)track;
+	return TSUNAMI_SIM_TRACK_LEN_MS;
+}
+
+// **************************************************************
+// The simulator starts with the configuration of a board holding
+// 4096 tracks, answering after one audio buffer
+TsunamiSim::TsunamiSim() {
+
+	trackLength = simDefaultTrackLength;
+	latencyUs = TSUNAMI_SIM_LATENCY_US;
+	bootUs = 0;
+	booted = false;
+	stealReports = false;
+	numTracks = TSUNAMI_SIM_MAX_TRACKS;
+	numVoices = MAX_NUM_VOICES;
+	nowUs = 0;
+	setVersion("Tsunami Sim v1.0");
+	reset();
+}
+
+// **************************************************************
+// Powers the simulated board down and up again: all voices are
+// freed, loop flags, reporting and both byte streams are cleared.
+// The configuration (version, tracks, voices, timing) is kept
+void TsunamiSim::reset(void) {
+
+int i;
+
+	for (i = 0; i < MAX_NUM_VOICES; i++)
+		voices[i].state = VOICE_FREE;
+	memset(loopFlags, 0, sizeof(loopFlags));
+	voiceSeq = 0;
+	overruns = 0;
+	rxHead = 0;
+	rxTail = 0;
+	cmdCount = 0;
+	cmdLen = 0;
+	reporting = false;
+}
+
+// **************************************************************
+// Sets the version string returned for CMD_GET_VERSION. The string
+// is space padded to the fixed length the board sends
+void TsunamiSim::setVersion(const char *pStr) {
+
+int i;
+
+	for (i = 0; i < (VERSION_STRING_LEN - 1); i++) {
+		if (*pStr)
+			version[i] = *pStr++;
+		else
+			version[i] = ' ';
+	}
+	version[VERSION_STRING_LEN - 1] = 0;
+}
+
+// **************************************************************
+// Sets the number of tracks reported in the system info
+void TsunamiSim::setNumTracks(int n) {
+
+	numTracks = (uint16_t)n;
+}
+
+// **************************************************************
+// Sets the number of voices the simulated firmware can play at once
+void TsunamiSim::setNumVoices(int n) {
+
+	if (n < 1)
+		n = 1;
+	if (n > MAX_NUM_VOICES)
+		n = MAX_NUM_VOICES;
+	numVoices = (uint8_t)n;
+}
+
+// **************************************************************
+// Sets the delay between a command and the resulting track report
+void TsunamiSim::setLatency(uint32_t us) {
+
+	latencyUs = us;
+}
+
+// **************************************************************
+// Sets the function that gives the length in milliseconds of each
+// track. NULL restores the default of TSUNAMI_SIM_TRACK_LEN_MS
+void TsunamiSim::setTrackLengthCallback(uint32_t (*pFunc)(uint16_t track)) {
+
+	if (pFunc)
+		trackLength = pFunc;
+	else
+		trackLength = simDefaultTrackLength;
+}
+
+// **************************************************************
+// Advances the virtual clock by us microseconds. Voices that became
+// audible, reached the end of their track or finished a stop-fade
+// in that time change state and send their track reports
+void TsunamiSim::advance(uint32_t us) {
+
+int i;
+Voice *pV;
+
+	nowUs += us;
+	for (i = 0; i < numVoices; i++) {
+		pV = &voices[i];
+		switch (pV->state) {
+			case VOICE_STARTING:
+				if (SIM_ELAPSED(nowUs, pV->startUs) < 0)
+					break;
+				// Loaded tracks hold at the start until resumed
+				if (pV->loaded) {
+					pV->state = VOICE_PAUSED;
+					pV->posUs = 0;
+				}
+				else
+					pV->state = VOICE_PLAYING;
+				sendTrackReport(pV->track, i, true);
+				// Very short tracks may also have ended already
+				// Fall through
+			case VOICE_PLAYING:
+				if (pV->state != VOICE_PLAYING)
+					break;
+				if (pV->stopAtFade && (SIM_ELAPSED(nowUs, pV->fadeEndUs) >= 0)) {
+					freeVoice(i);
+					break;
+				}
+				if (loopFlags[(pV->track - 1) >> 3] & (1 << ((pV->track - 1) & 0x07))) {
+					// Looping: wrap the start time for every completed pass
+					while ((pV->lenUs > 0) && ((uint32_t)SIM_ELAPSED(nowUs, pV->startUs) >= pV->lenUs))
+						pV->startUs += pV->lenUs;
+				}
+				else if ((uint32_t)SIM_ELAPSED(nowUs, pV->startUs) >= pV->lenUs)
+					freeVoice(i);
+			break;
+			case VOICE_STOPPING:
+				if (SIM_ELAPSED(nowUs, pV->startUs) >= 0)
+					freeVoice(i);
+			break;
+		}
+	}
+}
+
+// **************************************************************
+// Returns the number of voices currently allocated to a track, in
+// any state
+int TsunamiSim::activeVoices(void) {
+
+int i;
+int n = 0;
+
+	for (i = 0; i < numVoices; i++) {
+		if (voices[i].state != VOICE_FREE)
+			n++;
+	}
+	return n;
+}
+
+// **************************************************************
+// Returns true if the loop flag of track trk (1-4096) is set
+bool TsunamiSim::isLooping(int trk) {
+
+	if ((trk < 1) || (trk > TSUNAMI_SIM_MAX_TRACKS))
+		return false;
+	trk--;
+	return (loopFlags[trk >> 3] & (1 << (trk & 0x07))) != 0;
+}
+
+// **************************************************************
+// Appends raw bytes to the stream towards the library, as if the
+// board had sent them. Returns the number of bytes that fit
+size_t TsunamiSim::inject(const uint8_t *buf, size_t len) {
+
+size_t i;
+uint32_t lost = overruns;
+
+	for (i = 0; i < len; i++)
+		putByte(buf[i]);
+	return len - (overruns - lost);
+}
+
+// **************************************************************
+// Queues a track report regardless of the reporting setting and of
+// the simulated voice state. Used to generate report floods
+bool TsunamiSim::injectTrackReport(int trk, int voice, bool didStart) {
+
+uint8_t payload[4];
+uint16_t t;
+uint32_t lost = overruns;
+
+	t = (uint16_t)(trk - 1);
+	payload[0] = (uint8_t)t;
+	payload[1] = (uint8_t)(t >> 8);
+	payload[2] = (uint8_t)voice;
+	payload[3] = didStart;
+	sendFrame(RSP_TRACK_REPORT, payload, 4);
+	return overruns == lost;
+}
+
+// **************************************************************
+// TsunamiTransport: number of bytes the board has sent that the
+// library has not read yet
+int TsunamiSim::available(void) {
+
+	return (uint16_t)(rxHead - rxTail) & SIM_RX_MASK;
+}
+
+// **************************************************************
+// TsunamiTransport: next byte sent by the board, or -1
+int TsunamiSim::read(void) {
+
+uint8_t dat;
+
+	if (rxHead == rxTail)
+		return -1;
+	dat = rxBuf[rxTail];
+	rxTail = (rxTail + 1) & SIM_RX_MASK;
+	return dat;
+}
+
+// **************************************************************
+// TsunamiTransport: up to len bytes sent by the board
+int TsunamiSim::readBytes(uint8_t *buf, int len) {
+
+int n;
+int part;
+
+	n = available();
+	if (n > len)
+		n = len;
+	// Copy up to the end of the ring, then from its start
+	part = TSUNAMI_SIM_RX_LEN - rxTail;
+	if (part > n)
+		part = n;
+	memcpy(buf, &rxBuf[rxTail], part);
+	memcpy(buf + part, rxBuf, n - part);
+	rxTail = (rxTail + n) & SIM_RX_MASK;
+	return n;
+}
+
+// **************************************************************
+// TsunamiTransport: bytes written by the library are framed the
+// same way the board firmware frames them, and each complete
+// command is executed at the current virtual time
+size_t TsunamiSim::write(const uint8_t *buf, size_t len) {
+
+size_t i;
+uint8_t dat;
+
+	// Still booting: the bytes are lost
+	if (!booted) {
+		if (SIM_ELAPSED(nowUs, bootUs) < 0)
+			return len;
+		booted = true;
+	}
+	for (i = 0; i < len; i++) {
+		dat = buf[i];
+		if (cmdCount == 0) {
+			if (dat == SOM1)
+				cmdBuf[cmdCount++] = dat;
+		}
+		else if (cmdCount == 1) {
+			if (dat == SOM2)
+				cmdBuf[cmdCount++] = dat;
+			else
+				cmdCount = 0;
+		}
+		else if (cmdCount == 2) {
+			if ((dat >= 5) && (dat <= MAX_MESSAGE_LEN)) {
+				cmdLen = dat;
+				cmdBuf[cmdCount++] = dat;
+			}
+			else
+				cmdCount = 0;
+		}
+		else if (cmdCount < (cmdLen - 1)) {
+			cmdBuf[cmdCount++] = dat;
+		}
+		else {
+			// Last byte of the frame must be EOM
+			if (dat == EOM)
+				command(&cmdBuf[3], cmdLen - 4);
+			cmdCount = 0;
+		}
+	}
+	return len;
+}
+
+// **************************************************************
+// Executes one command. msg points at the command byte and len is
+// the number of bytes between the length byte and the EOM
+void TsunamiSim::command(const uint8_t *msg, int len) {
+
+int i;
+uint16_t trk;
+uint8_t payload[VERSION_STRING_LEN];
+
+	switch (msg[0]) {
+		case CMD_GET_VERSION:
+			for (i = 0; i < (VERSION_STRING_LEN - 1); i++)
+				payload[i] = version[i];
+			sendFrame(RSP_VERSION_STRING, payload, VERSION_STRING_LEN - 1);
+		break;
+		case CMD_GET_SYS_INFO:
+			payload[0] = numVoices;
+			payload[1] = (uint8_t)numTracks;
+			payload[2] = (uint8_t)(numTracks >> 8);
+			sendFrame(RSP_SYSTEM_INFO, payload, 3);
+		break;
+		case CMD_TRACK_CONTROL:
+			if (len >= 6)
+				trackControl(msg[1], msg[2] + (msg[3] << 8), msg[4], msg[5]);
+		break;
+		case CMD_STOP_ALL:
+			for (i = 0; i < numVoices; i++)
+				stopVoice(i);
+		break;
+		case CMD_RESUME_ALL_SYNC:
+			// All paused voices restart in the same audio buffer
+			for (i = 0; i < numVoices; i++) {
+				if (voices[i].state == VOICE_PAUSED) {
+					voices[i].state = VOICE_PLAYING;
+					voices[i].loaded = false;
+					voices[i].startUs = nowUs + latencyUs - voices[i].posUs;
+				}
+			}
+		break;
+		case CMD_TRACK_FADE:
+			if ((len >= 8) && msg[7]) {
+				trk = msg[1] + (msg[2] << 8);
+				for (i = 0; i < numVoices; i++) {
+					if ((voices[i].state != VOICE_FREE) && (voices[i].track == trk)) {
+						voices[i].stopAtFade = true;
+						voices[i].fadeEndUs = nowUs + (uint32_t)(msg[5] + (msg[6] << 8)) * 1000;
+					}
+				}
+			}
+		break;
+		case CMD_SET_REPORTING:
+			if (len >= 2)
+				reporting = (msg[1] != 0);
+		break;
+		// Gain, samplerate, bank and input mix commands have no effect
+		// on voice allocation or timing
+		default:
+		break;
+	}
+}
+
+// **************************************************************
+// Executes a CMD_TRACK_CONTROL command on track trk (1-4096)
+void TsunamiSim::trackControl(int code, int trk, int out, int flags) {
+
+int i;
+int v;
+Voice *pV;
+
+	if ((trk < 1) || (trk > numTracks))
+		return;
+	switch (code) {
+		case TRK_PLAY_SOLO:
+			for (i = 0; i < numVoices; i++)
+				stopVoice(i);
+		// Fall through
+		case TRK_PLAY_POLY:
+		case TRK_LOAD:
+			v = allocVoice();
+			if (v >= 0)
+				startVoice(v, trk, out, flags & 0x01, code == TRK_LOAD);
+		break;
+		case TRK_PAUSE:
+		case TRK_RESUME:
+		case TRK_STOP:
+			for (i = 0; i < numVoices; i++) {
+				pV = &voices[i];
+				if ((pV->state == VOICE_FREE) || (pV->track != trk))
+					continue;
+				if (code == TRK_STOP)
+					stopVoice(i);
+				else if ((code == TRK_PAUSE) && (pV->state == VOICE_PLAYING)) {
+					pV->state = VOICE_PAUSED;
+					pV->posUs = nowUs - pV->startUs;
+				}
+				else if ((code == TRK_RESUME) && (pV->state == VOICE_PAUSED)) {
+					pV->state = VOICE_PLAYING;
+					pV->loaded = false;
+					pV->startUs = nowUs - pV->posUs;
+				}
+			}
+		break;
+		case TRK_LOOP_ON:
+			loopFlags[(trk - 1) >> 3] |= (1 << ((trk - 1) & 0x07));
+		break;
+		case TRK_LOOP_OFF:
+			loopFlags[(trk - 1) >> 3] &= ~(1 << ((trk - 1) & 0x07));
+			// Voices in a later pass finish the pass they are in
+			for (i = 0; i < numVoices; i++) {
+				pV = &voices[i];
+				if ((pV->state == VOICE_PLAYING) && (pV->track == trk) && (pV->lenUs > 0)) {
+					while ((uint32_t)SIM_ELAPSED(nowUs, pV->startUs) >= pV->lenUs)
+						pV->startUs += pV->lenUs;
+				}
+			}
+		break;
+	}
+}
+
+// **************************************************************
+// Finds a voice for a new track. When all voices are busy the oldest
+// unlocked voice is stolen, like the firmware does. Returns -1 if
+// every voice is locked
+int TsunamiSim::allocVoice(void) {
+
+int i;
+int oldest = -1;
+
+	for (i = 0; i < numVoices; i++) {
+		if (voices[i].state == VOICE_FREE)
+			return i;
+	}
+	for (i = 0; i < numVoices; i++) {
+		if (voices[i].lock || (voices[i].state == VOICE_STOPPING))
+			continue;
+		if ((oldest < 0) || ((int32_t)(voices[i].seq - voices[oldest].seq) < 0))
+			oldest = i;
+	}
+	if (oldest >= 0) {
+		if (stealReports)
+			freeVoice(oldest);
+		else
+			voices[oldest].state = VOICE_FREE;
+	}
+	return oldest;
+}
+
+// **************************************************************
+// Starts track trk on voice v. The track becomes audible and is
+// reported one latency period later
+void TsunamiSim::startVoice(int v, int trk, int out, bool lock, bool loaded) {
+
+Voice *pV = &voices[v];
+
+	pV->track = (uint16_t)trk;
+	pV->state = VOICE_STARTING;
+	pV->out = (uint8_t)out;
+	pV->lock = lock;
+	pV->loaded = loaded;
+	pV->stopAtFade = false;
+	pV->seq = voiceSeq++;
+	pV->startUs = nowUs + latencyUs;
+	pV->posUs = 0;
+	pV->lenUs = trackLength((uint16_t)trk) * 1000;
+}
+
+// **************************************************************
+// Stops voice v at the end of the current audio buffer
+void TsunamiSim::stopVoice(int v) {
+
+Voice *pV = &voices[v];
+
+	if ((pV->state == VOICE_FREE) || (pV->state == VOICE_STOPPING))
+		return;
+	// A voice that was never heard is released without a report
+	if (pV->state == VOICE_STARTING) {
+		pV->state = VOICE_FREE;
+		return;
+	}
+	pV->state = VOICE_STOPPING;
+	pV->startUs = nowUs + latencyUs;
+}
+
+// **************************************************************
+// Releases voice v and reports that its track stopped
+void TsunamiSim::freeVoice(int v) {
+
+Voice *pV = &voices[v];
+
+	if (pV->state == VOICE_FREE)
+		return;
+	if (pV->state != VOICE_STARTING)
+		sendTrackReport(pV->track, v, false);
+	pV->state = VOICE_FREE;
+}
+
+// **************************************************************
+// Queues one byte towards the library, counting an overrun when
+// the buffer is full
+void TsunamiSim::putByte(uint8_t dat) {
+
+uint16_t next = (rxHead + 1) & SIM_RX_MASK;
+
+	if (next == rxTail) {
+		overruns++;
+		return;
+	}
+	rxBuf[rxHead] = dat;
+	rxHead = next;
+}
+
+// **************************************************************
+// Queues a complete response frame: SOM1, SOM2, length, type,
+// payload and EOM
+void TsunamiSim::sendFrame(uint8_t type, const uint8_t *payload, int len) {
+
+int i;
+
+	putByte(SOM1);
+	putByte(SOM2);
+	putByte((uint8_t)(len + 5));
+	putByte(type);
+	for (i = 0; i < len; i++)
+		putByte(payload[i]);
+	putByte(EOM);
+}
+
+// **************************************************************
+// Queues a RSP_TRACK_REPORT for track trk (1-4096) on voice v, if
+// reporting has been enabled with CMD_SET_REPORTING
+void TsunamiSim::sendTrackReport(int trk, int v, bool didStart) {
+
+	if (reporting)
+		injectTrackReport(trk, v, didStart);
+}
@@ -0,0 +1,111 @@
+// **************************************************************
+//     Filename: TsunamiSim.h
+// Date Created: 10/17/2026
+//
+//     Comments: In-process Tsunami simulator. Implements the
+//               TsunamiTransport interface, decodes the commands the
+//               library writes and answers the way the board does:
+//               version string, system info and track reports with
+//               play/stop/loop timing driven by a virtual clock.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_SIM_H_
+#define _TSUNAMI_SIM_H_
+
+#include "Tsunami.h"
+
+// Bytes buffered from the simulated board towards the library. When the
+// library does not drain it in time, bytes are dropped like a UART overrun.
+// Must be a power of 2
+#define TSUNAMI_SIM_RX_LEN			1024
+// Default track length, used when no track length callback is set
+#define TSUNAMI_SIM_TRACK_LEN_MS	10000
+// Delay between a command and the start of playback (about one audio buffer)
+#define TSUNAMI_SIM_LATENCY_US		2900
+#define TSUNAMI_SIM_MAX_TRACKS		4096
+
+class TsunamiSim : public TsunamiTransport
+{
+public:
+	TsunamiSim();
+	~TsunamiSim() {;}
+	void reset(void);
+	void setVersion(const char *pStr);
+	void setNumTracks(int n);
+	void setNumVoices(int n);
+	void setLatency(uint32_t us);
+	void setBootTime(uint32_t us) { bootUs = us; booted = false; }
+	void setStealReports(bool enable) { stealReports = enable; }
+	void setTrackLengthCallback(uint32_t (*pFunc)(uint16_t track));
+	void advance(uint32_t us);
+	uint32_t now(void) { return nowUs; }
+	int activeVoices(void);
+	bool isLooping(int trk);
+	size_t inject(const uint8_t *buf, size_t len);
+	bool injectTrackReport(int trk, int voice, bool didStart);
+	uint32_t getOverruns(void) { return overruns; }
+
+	// TsunamiTransport
+	int available(void);
+	int read(void);
+	int readBytes(uint8_t *buf, int len);
+	size_t write(const uint8_t *buf, size_t len);
+
+private:
+	enum { VOICE_FREE, VOICE_STARTING, VOICE_PLAYING, VOICE_PAUSED, VOICE_STOPPING };
+
+	struct Voice {
+		uint16_t track;
+		uint8_t state;
+		uint8_t out;
+		bool lock;
+		bool loaded;
+		bool stopAtFade;
+		uint32_t seq;
+		uint32_t startUs;
+		uint32_t posUs;
+		uint32_t lenUs;
+		uint32_t fadeEndUs;
+	};
+
+	void command(const uint8_t *msg, int len);
+	void trackControl(int code, int trk, int out, int flags);
+	int allocVoice(void);
+	void startVoice(int v, int trk, int out, bool lock, bool loaded);
+	void stopVoice(int v);
+	void freeVoice(int v);
+	void putByte(uint8_t dat);
+	void sendFrame(uint8_t type, const uint8_t *payload, int len);
+	void sendTrackReport(int trk, int v, bool didStart);
+
+	uint32_t (*trackLength)(uint16_t track);
+
+	Voice voices[MAX_NUM_VOICES];
+	// One loop flag per track (1-4096)
+	uint8_t loopFlags[TSUNAMI_SIM_MAX_TRACKS / 8];
+	uint8_t rxBuf[TSUNAMI_SIM_RX_LEN];
+	uint8_t cmdBuf[MAX_MESSAGE_LEN];
+	char version[VERSION_STRING_LEN];
+	uint32_t nowUs;
+	uint32_t latencyUs;
+	// Commands written before this time are lost, like on a board
+	// that is still booting
+	uint32_t bootUs;
+	// Set once bootUs has passed, so the clock can wrap afterwards
+	bool booted;
+	// Send a stop report for a voice taken by a new track. Off by
+	// default, like the board, which only reports the start
+	bool stealReports;
+	uint32_t voiceSeq;
+	uint32_t overruns;
+	uint16_t rxHead;
+	uint16_t rxTail;
+	uint16_t numTracks;
+	uint8_t numVoices;
+	uint8_t cmdCount;
+	uint8_t cmdLen;
+	bool reporting;
+};
+
+#endif
@@ -0,0 +1,68 @@
+// **************************************************************
+//     Filename: TsunamiSync.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Sync group of tracks started together
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+// **************************************************************
+// Removes all members. Must not be called while the group is loading
+void TsunamiSyncGroup::clear(void) {
+
+	count = 0;
+	missing = 0;
+	state = SYNC_IDLE;
+	confirmMs = 0;
+}
+
+// **************************************************************
+// Adds track trk, to be played on output out. Returns false if the
+// group is full or is loading
+bool TsunamiSyncGroup::add(int trk, int out, bool lock) {
+
+	if ((count >= SYNC_GROUP_MAX) || (state == SYNC_LOADING))
+		return false;
+	tracks[count] = (uint16_t)trk;
+	outs[count] = (uint8_t)(out & 0x07);
+	locks[count] = lock;
+	voices[count] = 0xff;
+	count++;
+	return true;
+}
+
+// **************************************************************
+// Private internal function called by Tsunami::syncStart() once the
+// loads are sent
+void TsunamiSyncGroup::begin(uint32_t nowMs, uint16_t timeout) {
+
+int i;
+
+	for (i = 0; i < count; i++)
+		voices[i] = 0xff;
+	missing = (uint8_t)((1 << count) - 1);
+	state = SYNC_LOADING;
+	startMs = nowMs;
+	timeoutMs = timeout;
+	confirmMs = 0;
+}
+
+// **************************************************************
+// Private internal function that marks the first unconfirmed
+// member playing trk as loaded on voice. Returns true when that was
+// the last member missing
+bool TsunamiSyncGroup::confirm(uint16_t trk, uint8_t voice) {
+
+int i;
+
+	for (i = 0; i < count; i++) {
+		if ((missing & (1 << i)) && (tracks[i] == trk)) {
+			voices[i] = voice;
+			missing &= ~(1 << i);
+			return (missing == 0);
+		}
+	}
+	return false;
+}
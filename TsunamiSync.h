@@ -0,0 +1,60 @@
+// **************************************************************
+//     Filename: TsunamiSync.h
+// Date Created: 10/17/2026
+//
+//     Comments: Sync group: tracks that are loaded paused and then
+//               started together with resumeAllInSync(). The track
+//               reports confirm each load got a voice, and the
+//               resume is sent as soon as the last one is confirmed
+//               instead of after a fixed delay.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_SYNC_H_
+#define _TSUNAMI_SYNC_H_
+
+#include <stdint.h>
+
+#define SYNC_GROUP_MAX				8
+
+// Sync group states, see TsunamiSyncGroup::getState()
+#define SYNC_IDLE					0
+#define SYNC_LOADING				1
+#define SYNC_STARTED				2
+#define SYNC_TIMED_OUT				3
+
+class TsunamiSyncGroup
+{
+public:
+	TsunamiSyncGroup() { clear(); }
+	void clear(void);
+	bool add(int trk, int out, bool lock);
+	int numMembers(void) const { return count; }
+	int memberTrack(int n) const { return tracks[n]; }
+	int memberVoice(int n) const { return voices[n]; }
+	int getState(void) const { return state; }
+	uint8_t getMissing(void) const { return missing; }
+	uint32_t getConfirmMs(void) const { return confirmMs; }
+
+private:
+	friend class Tsunami;
+
+	void begin(uint32_t nowMs, uint16_t timeout);
+	bool confirm(uint16_t trk, uint8_t voice);
+
+	uint16_t tracks[SYNC_GROUP_MAX];
+	uint8_t outs[SYNC_GROUP_MAX];
+	bool locks[SYNC_GROUP_MAX];
+	// Voice each member was loaded on, 0xff until confirmed
+	uint8_t voices[SYNC_GROUP_MAX];
+	// Bit n is set while member n is not confirmed
+	uint8_t missing;
+	uint8_t count;
+	uint8_t state;
+	uint16_t timeoutMs;
+	uint32_t startMs;
+	// Milliseconds from the loads to the resume (or the time out)
+	uint32_t confirmMs;
+};
+
+#endif
@@ -0,0 +1,104 @@
+// **************************************************************
+//     Filename: TsunamiTrackIndex.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Reverse index from track number to voices
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+// **************************************************************
+// Empties the index: no track is playing
+void TsunamiTrackIndex::clear(void) {
+
+	memset(slotTrack, 0, sizeof(slotTrack));
+}
+
+// **************************************************************
+// Records that track (1-4096) plays on voice
+void TsunamiTrackIndex::add(uint16_t track, uint8_t voice) {
+
+int slot;
+
+	if ((track < 1) || (track > TSUNAMI_MAX_TRACKS))
+		return;
+	slot = find(track);
+	if (slot < 0) {
+		// Not playing yet: take the first empty slot along the probe
+		// sequence. At most MAX_NUM_VOICES slots are ever in use
+		slot = track & TRACK_INDEX_MASK;
+		while (slotTrack[slot])
+			slot = (slot + 1) & TRACK_INDEX_MASK;
+		slotTrack[slot] = track;
+		slotVoices[slot] = 0;
+	}
+	slotVoices[slot] |= (TsunamiVoiceMask)1 << voice;
+}
+
+// **************************************************************
+// Records that track (1-4096) no longer plays on voice
+void TsunamiTrackIndex::remove(uint16_t track, uint8_t voice) {
+
+int slot;
+
+	slot = find(track);
+	if (slot < 0)
+		return;
+	slotVoices[slot] &= ~((TsunamiVoiceMask)1 << voice);
+	if (slotVoices[slot] == 0)
+		erase(slot);
+}
+
+// **************************************************************
+// Returns the voices track (1-4096) is playing on, one bit per voice
+TsunamiVoiceMask TsunamiTrackIndex::voices(uint16_t track) const {
+
+int slot = find(track);
+
+	return (slot < 0) ? 0 : slotVoices[slot];
+}
+
+// **************************************************************
+// Private: returns the slot holding track, or -1. The probe ends at
+// the first empty slot, and the table is at most half full
+int TsunamiTrackIndex::find(uint16_t track) const {
+
+int slot;
+
+	if (track == 0)
+		return -1;
+	slot = track & TRACK_INDEX_MASK;
+	while (slotTrack[slot]) {
+		if (slotTrack[slot] == track)
+			return slot;
+		slot = (slot + 1) & TRACK_INDEX_MASK;
+	}
+	return -1;
+}
+
+// **************************************************************
+// Private: empties a slot, moving later entries of the same probe
+// run back so that every entry stays reachable from its home slot
+void TsunamiTrackIndex::erase(int slot) {
+
+int next;
+int home;
+
+	next = slot;
+	for (;;) {
+		next = (next + 1) & TRACK_INDEX_MASK;
+		if (slotTrack[next] == 0)
+			break;
+		home = slotTrack[next] & TRACK_INDEX_MASK;
+		// Entry at next can move to slot unless its home lies
+		// cyclically in (slot, next]
+		if (((next > slot) && ((home <= slot) || (home > next))) ||
+			((next < slot) && ((home <= slot) && (home > next)))) {
+			slotTrack[slot] = slotTrack[next];
+			slotVoices[slot] = slotVoices[next];
+			slot = next;
+		}
+	}
+	slotTrack[slot] = 0;
+}
@@ -0,0 +1,62 @@
+// **************************************************************
+//     Filename: TsunamiTrackIndex.h
+// Date Created: 10/17/2026
+//
+//     Comments: Reverse index from track number to the voices
+//               playing it, kept current from track reports. A small
+//               hash table, sized by the voice count, holds the voice
+//               mask of each track that is playing; a track without
+//               an entry is not playing.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_TRACK_INDEX_H_
+#define _TSUNAMI_TRACK_INDEX_H_
+
+#include <stdint.h>
+
+// Highest track number the index takes
+#ifndef TSUNAMI_MAX_TRACKS
+#define TSUNAMI_MAX_TRACKS			4096
+#endif
+
+// Hash slots for the playing tracks: at most MAX_NUM_VOICES tracks
+// play at once, so twice the voice count, rounded up to a power of 2,
+// keeps the table at most half full
+#if MAX_NUM_VOICES > 32
+#error "TsunamiTrackIndex voice masks hold at most 32 voices"
+#endif
+#if MAX_NUM_VOICES <= 4
+#define TRACK_INDEX_SLOTS			8
+#elif MAX_NUM_VOICES <= 8
+#define TRACK_INDEX_SLOTS			16
+#elif MAX_NUM_VOICES <= 16
+#define TRACK_INDEX_SLOTS			32
+#else
+#define TRACK_INDEX_SLOTS			64
+#endif
+#define TRACK_INDEX_MASK			(TRACK_INDEX_SLOTS - 1)
+
+// One bit per voice (bit n = voice n)
+typedef uint32_t TsunamiVoiceMask;
+
+class TsunamiTrackIndex
+{
+public:
+	TsunamiTrackIndex() { clear(); }
+	void clear(void);
+	void add(uint16_t track, uint8_t voice);
+	void remove(uint16_t track, uint8_t voice);
+	bool isPlaying(uint16_t track) const { return find(track) >= 0; }
+	TsunamiVoiceMask voices(uint16_t track) const;
+
+private:
+	int find(uint16_t track) const;
+	void erase(int slot);
+
+	// Open addressing with linear probing, 0 marks an empty slot
+	uint16_t slotTrack[TRACK_INDEX_SLOTS];
+	TsunamiVoiceMask slotVoices[TRACK_INDEX_SLOTS];
+};
+
+#endif
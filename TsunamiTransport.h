@@ -0,0 +1,68 @@
+// **************************************************************
+//     Filename: TsunamiTransport.h
+// Date Created: 10/17/2026
+//
+//     Comments: Byte-stream transport used by the Tsunami class.
+//               Anything that can move bytes to and from a Tsunami
+//               (a hardware UART, AltSoftSerial, a simulator or a
+//               Linux tty) is wrapped in a TsunamiTransport.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_TRANSPORT_H_
+#define _TSUNAMI_TRANSPORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+class TsunamiTransport
+{
+public:
+	virtual ~TsunamiTransport() {;}
+	// Called once from Tsunami::start() with the Tsunami baud rate
+	virtual void begin(uint32_t baud) { (void)baud; }
+	// Number of received bytes that can be read without blocking
+	virtual int available(void) = 0;
+	// Returns the next received byte, or -1 if there is none
+	virtual int read(void) = 0;
+	// Reads up to len bytes that are already available, returns the
+	// number of bytes read. Never waits for more bytes to arrive
+	virtual int readBytes(uint8_t *buf, int len) {
+		int n;
+		int dat;
+		for (n = 0; n < len; n++) {
+			if ((dat = read()) < 0)
+				break;
+			buf[n] = (uint8_t)dat;
+		}
+		return n;
+	}
+	// Sends len bytes, returns the number of bytes accepted
+	virtual size_t write(const uint8_t *buf, size_t len) = 0;
+	// Number of bytes that can be written without blocking
+	virtual int availableForWrite(void) { return 0x7fff; }
+	// Number of received bytes lost because they were not read in
+	// time, 0 if the transport cannot tell
+	virtual uint32_t getOverruns(void) { return 0; }
+};
+
+// **************************************************************
+// Adapter for Arduino serial classes (HardwareSerial, Uart,
+// AltSoftSerial, ...). Anything with begin(), available(), read(),
+// write(buf, len) and availableForWrite() can be wrapped.
+template <class T>
+class TsunamiStreamTransport : public TsunamiTransport
+{
+public:
+	TsunamiStreamTransport(T &s) : stream(s) {;}
+	void begin(uint32_t baud) { stream.begin(baud); }
+	int available(void) { return stream.available(); }
+	int read(void) { return stream.read(); }
+	size_t write(const uint8_t *buf, size_t len) { return stream.write(buf, len); }
+	int availableForWrite(void) { return stream.availableForWrite(); }
+
+private:
+	T &stream;
+};
+
+#endif
@@ -0,0 +1,144 @@
+// **************************************************************
+//     Filename: TsunamiTxQueue.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Fixed-size ring of complete command frames
+//
+// **************************************************************
+
+#include "TsunamiTxQueue.h"
+
+// **************************************************************
+// Sets the storage of the ring, len bytes, a power of 2 no more
+// than 256, and empties it
+void TsunamiTxQueue::init(uint8_t *pBuf, int len) {
+
+	buf = pBuf;
+	mask = (uint8_t)(len - 1);
+	head = 0;
+	tail = 0;
+}
+
+// **************************************************************
+// Returns the length of the oldest queued frame, or 0 if the queue
+// is empty
+int TsunamiTxQueue::peekLen(void) const {
+
+uint8_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+
+	if (t == __atomic_load_n(&head, __ATOMIC_ACQUIRE))
+		return 0;
+	return buf[(t + 2) & mask];
+}
+
+// **************************************************************
+// Appends a complete frame. Returns false, leaving the queue as it
+// was, if the frame does not fit
+bool TsunamiTxQueue::push(const uint8_t *frame, int len) {
+
+int i;
+uint8_t h;
+
+	if (len > space())
+		return false;
+	h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+	for (i = 0; i < len; i++) {
+		buf[h] = frame[i];
+		h = (h + 1) & mask;
+	}
+	// Publish the frame only once all its bytes are in place
+	__atomic_store_n(&head, h, __ATOMIC_RELEASE);
+	return true;
+}
+
+// **************************************************************
+// Copies the oldest frame to pDst and removes it. Returns the frame
+// length, or 0 if the queue is empty
+int TsunamiTxQueue::pop(uint8_t *pDst) {
+
+int i;
+int len;
+uint8_t t;
+
+	len = peekLen();
+	t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+	for (i = 0; i < len; i++) {
+		pDst[i] = buf[t];
+		t = (t + 1) & mask;
+	}
+	// The bytes are copied before the producer may reuse them
+	__atomic_store_n(&tail, t, __ATOMIC_RELEASE);
+	return len;
+}
+
+// **************************************************************
+// Discards the oldest frame
+void TsunamiTxQueue::drop(void) {
+
+	__atomic_store_n(&tail, (uint8_t)((tail + peekLen()) & mask), __ATOMIC_RELEASE);
+}
+
+// **************************************************************
+// Returns true if pMatch returns true for any queued frame, oldest
+// first. pMatch is given the first TX_QUEUE_SCAN_LEN bytes of the
+// queued frame (the rest is undefined if shorter) and frame. Only
+// call from the side that pushes: frames popped during the scan
+// were queued before it, so seeing them or not changes nothing
+bool TsunamiTxQueue::scan(bool (*pMatch)(const uint8_t *queued, const uint8_t *frame), const uint8_t *frame) const {
+
+uint8_t queued[TX_QUEUE_SCAN_LEN];
+uint8_t t = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+uint8_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+int i;
+int len;
+
+	while (t != h) {
+		len = buf[(t + 2) & mask];
+		for (i = 0; i < TX_QUEUE_SCAN_LEN; i++)
+			queued[i] = buf[(t + i) & mask];
+		if (pMatch(queued, frame))
+			return true;
+		t = (t + len) & mask;
+	}
+	return false;
+}
+
+// **************************************************************
+// Removes the frames pMatch returns true for (called as for scan())
+// and keeps the others in order. pRemoved(pCtx, queued, pos) is
+// called for each frame removed, oldest first, with its first
+// TX_QUEUE_SCAN_LEN bytes and the number of frames kept before it.
+// Returns the number of frames removed
+int TsunamiTxQueue::remove(bool (*pMatch)(const uint8_t *queued, const uint8_t *frame), const uint8_t *frame,
+	void (*pRemoved)(void *pCtx, const uint8_t *queued, int pos), void *pCtx) {
+
+uint8_t queued[TX_QUEUE_SCAN_LEN];
+uint8_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+uint8_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+uint8_t w = t;
+int i;
+int len;
+int kept = 0;
+int removed = 0;
+
+	while (t != h) {
+		len = buf[(t + 2) & mask];
+		for (i = 0; i < TX_QUEUE_SCAN_LEN; i++)
+			queued[i] = buf[(t + i) & mask];
+		if (pMatch(queued, frame)) {
+			pRemoved(pCtx, queued, kept);
+			removed++;
+			t = (t + len) & mask;
+			continue;
+		}
+		// The frames kept move back over the ones removed
+		for (i = 0; i < len; i++) {
+			buf[w] = buf[t];
+			w = (w + 1) & mask;
+			t = (t + 1) & mask;
+		}
+		kept++;
+	}
+	__atomic_store_n(&head, w, __ATOMIC_RELEASE);
+	return removed;
+}
@@ -0,0 +1,83 @@
+// **************************************************************
+//     Filename: TsunamiTxQueue.h
+// Date Created: 10/17/2026
+//
+//     Comments: Fixed-size ring of complete command frames, used by
+//               the Tsunami class in queued transmit mode. There is
+//               one ring per priority class
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_TX_QUEUE_H_
+#define _TSUNAMI_TX_QUEUE_H_
+
+#include <stdint.h>
+
+// Priority classes of the queued frames, most urgent first. The
+// queued modes always send the oldest frame of the most urgent
+// class that has one
+// Stop all, track stop and track pause
+#define TX_PRIO_STOP		0
+// Track play, load, resume and loop, resume all in sync
+#define TX_PRIO_PLAY		1
+// Gains, fades, samplerate and everything else
+#define TX_PRIO_BULK		2
+#define TX_PRIO_CLASSES		3
+
+// Size of each class's ring in bytes. Each must be a power of 2, no
+// more than 256. One byte is always left unused to tell full from
+// empty
+#ifndef TX_QUEUE_STOP_LEN
+#define TX_QUEUE_STOP_LEN	32
+#endif
+#ifndef TX_QUEUE_PLAY_LEN
+#define TX_QUEUE_PLAY_LEN	128
+#endif
+#ifndef TX_QUEUE_LEN
+#define TX_QUEUE_LEN		128
+#endif
+#if ((TX_QUEUE_STOP_LEN & (TX_QUEUE_STOP_LEN - 1)) != 0) || \
+	((TX_QUEUE_PLAY_LEN & (TX_QUEUE_PLAY_LEN - 1)) != 0) || ((TX_QUEUE_LEN & (TX_QUEUE_LEN - 1)) != 0)
+#error "TX_QUEUE_STOP_LEN, TX_QUEUE_PLAY_LEN and TX_QUEUE_LEN must be powers of 2"
+#endif
+
+// Leading bytes of a queued frame handed to the scan() match
+// function: start of message, length, command and the first three
+// data bytes
+#define TX_QUEUE_SCAN_LEN	7
+
+// The ring only ever holds whole frames, so the oldest frame always
+// starts at tail and its length is in the frame's own length byte.
+// push() is called from the main loop and pop() may be called from
+// the TX-empty interrupt: each index is only written by one side,
+// published with release ordering after the bytes it covers and read
+// with acquire ordering, like TsunamiEventQueue. drop(), clear()
+// and remove() also move tail or rewrite queued bytes, so the main
+// loop calls them with the interrupt held off. The storage is given
+// by init(), so that every class can have its own size
+class TsunamiTxQueue
+{
+public:
+	TsunamiTxQueue() : buf(0), mask(0), head(0), tail(0) {;}
+	void init(uint8_t *pBuf, int len);
+	void clear(void) { __atomic_store_n(&tail, __atomic_load_n(&head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE); }
+	int pending(void) const {
+		return (uint8_t)(__atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) & mask;
+	}
+	int space(void) const { return mask - pending(); }
+	int peekLen(void) const;
+	bool push(const uint8_t *frame, int len);
+	int pop(uint8_t *pDst);
+	void drop(void);
+	bool scan(bool (*pMatch)(const uint8_t *queued, const uint8_t *frame), const uint8_t *frame) const;
+	int remove(bool (*pMatch)(const uint8_t *queued, const uint8_t *frame), const uint8_t *frame,
+		void (*pRemoved)(void *pCtx, const uint8_t *queued, int pos), void *pCtx);
+
+private:
+	uint8_t *buf;
+	uint8_t mask;
+	uint8_t head;
+	uint8_t tail;
+};
+
+#endif
@@ -0,0 +1,155 @@
+// **************************************************************
+//     Filename: TsunamiVoices.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Voice occupancy and voice steal telemetry
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+#ifndef __TSUNAMI_USE_HOST__
+#include <Arduino.h>
+#endif
+
+// **************************************************************
+// Clears the counters and the times. Voices busy now stay busy and
+// are timed from now on
+void TsunamiVoiceStats::clear(void) {
+
+int i;
+
+	lastUs = now();
+	active = 0;
+	for (i = 0; i < MAX_NUM_VOICES; i++) {
+		busyUs[i] = 0;
+		voiceStarts[i] = 0;
+		voiceSteals[i] = 0;
+		if (busy[i])
+			active++;
+	}
+	for (i = 0; i <= MAX_NUM_VOICES; i++)
+		timeAt[i] = 0;
+	steals = 0;
+	peak = active;
+}
+
+// **************************************************************
+// Private: every voice is free, as after start(). Clears as well
+void TsunamiVoiceStats::idle(void) {
+
+int i;
+
+	for (i = 0; i < MAX_NUM_VOICES; i++)
+		busy[i] = false;
+	clear();
+}
+
+// **************************************************************
+// Private internal function returning the time in microseconds,
+// from the clock set with setClock() or micros()
+uint32_t TsunamiVoiceStats::now(void) {
+
+	return clock ? clock() : micros();
+}
+
+// **************************************************************
+// Private: adds the time since the last event to the current
+// polyphony and to every busy voice, so that no total is kept in
+// 32 bits. Events or queries must come at least every 71 minutes,
+// the period of the 32 bit microsecond clock
+void TsunamiVoiceStats::advance(void) {
+
+uint32_t t = now();
+uint32_t dt = t - lastUs;
+int i;
+
+	timeAt[active] += dt;
+	lastUs = t;
+	if (!active)
+		return;
+	for (i = 0; i < MAX_NUM_VOICES; i++) {
+		if (busy[i])
+			busyUs[i] += dt;
+	}
+}
+
+// **************************************************************
+// Private: a track report started track on voice. oldTrack is the
+// track the voice held until then, 0xffff if none. A track that
+// restarts on its own voice is not a steal
+void TsunamiVoiceStats::started(uint8_t voice, uint16_t oldTrack, uint16_t track) {
+
+	advance();
+	voiceStarts[voice]++;
+	if ((oldTrack != 0xffff) && (oldTrack != track)) {
+		steals++;
+		voiceSteals[voice]++;
+		if (stealCallback)
+			stealCallback(oldTrack, track, voice);
+	}
+	// A stolen voice stays busy
+	if (busy[voice])
+		return;
+	busy[voice] = true;
+	if (++active > peak)
+		peak = active;
+}
+
+// **************************************************************
+// Private: a track report stopped the track on voice
+void TsunamiVoiceStats::stopped(uint8_t voice) {
+
+	if (!busy[voice])
+		return;
+	advance();
+	busy[voice] = false;
+	active--;
+}
+
+// **************************************************************
+// Returns how long voice has been busy since clear(), including
+// the time it has been busy now
+uint64_t TsunamiVoiceStats::getBusyUs(int voice) {
+
+	advance();
+	return busyUs[voice];
+}
+
+// **************************************************************
+// Returns the time since clear()
+uint64_t TsunamiVoiceStats::getElapsedUs(void) {
+
+uint64_t sum = 0;
+int i;
+
+	advance();
+	for (i = 0; i <= MAX_NUM_VOICES; i++)
+		sum += timeAt[i];
+	return sum;
+}
+
+// **************************************************************
+// Returns the time spent with exactly n voices busy since clear()
+uint64_t TsunamiVoiceStats::getTimeAtUs(int n) {
+
+	advance();
+	return timeAt[n];
+}
+
+// **************************************************************
+// Returns the time-weighted mean polyphony since clear(), in
+// thousandths of a voice
+uint32_t TsunamiVoiceStats::getMeanMilli(void) {
+
+uint64_t sum = 0;
+uint64_t total = 0;
+int i;
+
+	advance();
+	for (i = 0; i <= MAX_NUM_VOICES; i++) {
+		sum += timeAt[i] * i;
+		total += timeAt[i];
+	}
+	return total ? (uint32_t)(sum * 1000 / total) : 0;
+}
@@ -0,0 +1,61 @@
+// **************************************************************
+//     Filename: TsunamiVoices.h
+// Date Created: 10/17/2026
+//
+//     Comments: Voice occupancy and voice steal telemetry, derived
+//               from the track reports. Counts the starts on every
+//               voice and the steals (a start on a voice that still
+//               holds another track, which the board does without a
+//               stop report), adds up the busy time of every voice and
+//               the time spent at each polyphony.
+//
+// **************************************************************
+
+#ifndef _TSUNAMI_VOICES_H_
+#define _TSUNAMI_VOICES_H_
+
+#include <stdint.h>
+
+class TsunamiVoiceStats
+{
+public:
+	TsunamiVoiceStats() : clock(0), stealCallback(0) { idle(); }
+	void clear(void);
+	void setClock(uint32_t (*pFunc)(void)) { clock = pFunc; }
+	void setStealCallback(void (*pFunc)(uint16_t oldTrack, uint16_t newTrack, uint8_t voice)) { stealCallback = pFunc; }
+	uint32_t getSteals(void) const { return steals; }
+	uint32_t getVoiceSteals(int voice) const { return voiceSteals[voice]; }
+	uint32_t getVoiceStarts(int voice) const { return voiceStarts[voice]; }
+	uint64_t getBusyUs(int voice);
+	uint64_t getElapsedUs(void);
+	uint64_t getTimeAtUs(int n);
+	int getActive(void) const { return active; }
+	int getPeak(void) const { return peak; }
+	uint32_t getMeanMilli(void);
+
+private:
+	friend class Tsunami;
+
+	uint32_t now(void);
+	void idle(void);
+	void advance(void);
+	void started(uint8_t voice, uint16_t oldTrack, uint16_t track);
+	void stopped(uint8_t voice);
+
+	uint32_t (*clock)(void);
+	void (*stealCallback)(uint16_t oldTrack, uint16_t newTrack, uint8_t voice);
+	// Time of the last event or query
+	uint32_t lastUs;
+	// Time each voice has been busy, added up by advance()
+	uint64_t busyUs[MAX_NUM_VOICES];
+	uint32_t voiceStarts[MAX_NUM_VOICES];
+	uint32_t voiceSteals[MAX_NUM_VOICES];
+	bool busy[MAX_NUM_VOICES];
+	// Time spent with n voices busy, n = 0 ... MAX_NUM_VOICES
+	uint64_t timeAt[MAX_NUM_VOICES + 1];
+	uint32_t steals;
+	uint8_t active;
+	uint8_t peak;
+};
+
+#endif
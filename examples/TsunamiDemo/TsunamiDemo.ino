@@ -71,14 +71,28 @@ void setup() {
   pinMode(LED,OUTPUT);
   digitalWrite(LED,gLedState);
 
-  // We should wait for the Tsunami to finish reset before trying to send
-  // commands.
-  delay(1000);
-
-  // Tsunami startup at 57600
+  // Tsunami startup at 57600. start() returns right away; update() keeps
+  //  asking for the version string and number of tracks until the Tsunami
+  //  has finished its reset and answers, then calls tsunamiReady().
+  tsunami.setReadyCallback(tsunamiReady);
   tsunami.start();
-  delay(10);
   
+}
+
+
+// ****************************************************************************
+// Called from tsunami.update() once the Tsunami has answered the start-up
+//  handshake, or with ready false if it never did.
+void tsunamiReady(bool ready) {
+
+  if (!ready) {
+    Serial.print("Tsunami not responding\n");
+    return;
+  }
+  Serial.print("Tsunami ready after ");
+  Serial.print(tsunami.getReadyMs());
+  Serial.print(" ms\n");
+
   // Send a stop-all command and reset the sample-rate offset, in case we have
   //  reset while the Tsunami was already playing.
   tsunami.stopAllTracks();
@@ -86,11 +100,6 @@ void setup() {
   
   // Enable track reporting from the Tsunami
   tsunami.setReporting(true);
-  
-  // Allow time for the Tsunami to respond with the version string and
-  //  number of tracks.
-  delay(100); 
-  
 }
 
 
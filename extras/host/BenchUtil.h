@@ -0,0 +1,77 @@
+// **************************************************************
+//     Filename: BenchUtil.h
+// Date Created: 10/17/2026
+//
+//     Comments: Helpers shared by the host benchmarks
+//
+// **************************************************************
+
+#ifndef _BENCH_UTIL_H_
+#define _BENCH_UTIL_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <string.h>
+#include "TsunamiTransport.h"
+
+// Monotonic time in nanoseconds
+static inline uint64_t benchNs(void) {
+
+struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Transport that swallows everything written to it and never
+// receives anything. Used to time the command encoders
+class BenchNullTransport : public TsunamiTransport
+{
+public:
+	BenchNullTransport() : bytes(0), frames(0) {;}
+	int available(void) { return 0; }
+	int read(void) { return -1; }
+	size_t write(const uint8_t *buf, size_t len) {
+		(void)buf;
+		bytes += len;
+		frames++;
+		return len;
+	}
+
+	uint64_t bytes;
+	uint64_t frames;
+};
+
+// Transport that delivers a prepared buffer as the received bytes
+// and swallows everything written to it
+class BenchMemTransport : public TsunamiTransport
+{
+public:
+	BenchMemTransport() : buf(NULL), len(0), pos(0) {;}
+	void load(const uint8_t *p, size_t n) { buf = p; len = n; pos = 0; }
+	int available(void) { return (int)((len - pos) > 0x7fff ? 0x7fff : (len - pos)); }
+	int read(void) { return (pos < len) ? buf[pos++] : -1; }
+	int readBytes(uint8_t *p, int n) {
+		if ((size_t)n > (len - pos))
+			n = (int)(len - pos);
+		memcpy(p, buf + pos, n);
+		pos += n;
+		return n;
+	}
+	size_t write(const uint8_t *p, size_t n) { (void)p; return n; }
+
+	const uint8_t *buf;
+	size_t len;
+	size_t pos;
+};
+
+// Prints one result line: name, rate and time per operation
+static inline void benchReport(const char *name, uint64_t ops, uint64_t ns, const char *unit) {
+
+	printf("%-36s %12.0f %s/s %9.1f ns/%s\n", name,
+		ns ? (double)ops * 1e9 / (double)ns : 0.0, unit,
+		ops ? (double)ns / (double)ops : 0.0, unit);
+}
+
+#endif
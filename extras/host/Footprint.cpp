@@ -0,0 +1,13 @@
+// **************************************************************
+//     Filename: Footprint.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: One Tsunami object, built by "make footprint" under
+//               each footprint option. The size of the object is the
+//               RAM the library takes per board
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+Tsunami footprint;
@@ -0,0 +1,86 @@
+// **************************************************************
+//     Filename: FrameBench.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Compares the template frame encoders with the
+//               hand-rolled ones: identical output, time per frame
+//
+// **************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "Tsunami.h"
+#include "BenchUtil.h"
+
+#define BENCH_FRAMES	20000000
+
+int legacyTrackControl(uint8_t *txbuf, int trk, int code, int out, int flags);
+int legacyTrackFade(uint8_t *txbuf, int trk, int gain, int time, bool stopFlag);
+int legacyMasterGain(uint8_t *txbuf, int out, int gain);
+int legacyStopAll(uint8_t *txbuf);
+int frameTrackControl(uint8_t *txbuf, int trk, int code, int out, int flags);
+int frameTrackFade(uint8_t *txbuf, int trk, int gain, int time, bool stopFlag);
+int frameMasterGain(uint8_t *txbuf, int out, int gain);
+int frameStopAll(uint8_t *txbuf);
+
+// Keeps the encoded bytes alive so the loops are not optimized away
+static volatile uint8_t gSink;
+
+// **************************************************************
+// Both encoder sets must produce the same bytes for every input
+static int checkSame(void) {
+
+uint8_t a[MAX_MESSAGE_LEN];
+uint8_t b[MAX_MESSAGE_LEN];
+int i;
+int la;
+int lb;
+
+	for (i = -40000; i < 40000; i += 7) {
+		la = legacyTrackControl(a, i, i & 7, i, i >> 3);
+		lb = frameTrackControl(b, i, i & 7, i, i >> 3);
+		if ((la != lb) || memcmp(a, b, la))
+			return 1;
+		la = legacyTrackFade(a, i, -i, i * 3, i & 1);
+		lb = frameTrackFade(b, i, -i, i * 3, i & 1);
+		if ((la != lb) || memcmp(a, b, la))
+			return 1;
+		la = legacyMasterGain(a, i, -i);
+		lb = frameMasterGain(b, i, -i);
+		if ((la != lb) || memcmp(a, b, la))
+			return 1;
+	}
+	la = legacyStopAll(a);
+	lb = frameStopAll(b);
+	return (la != lb) || memcmp(a, b, la);
+}
+
+#define TIME_ENCODER(name, call)							\
+	t0 = benchNs();											\
+	for (i = 0; i < BENCH_FRAMES; i++) {					\
+		call;												\
+		gSink = buf[3];										\
+	}														\
+	benchReport(name, BENCH_FRAMES, benchNs() - t0, "frame");
+
+int main(void) {
+
+uint8_t buf[MAX_MESSAGE_LEN];
+uint64_t t0;
+int i;
+
+	if (checkSame()) {
+		printf("frame: template and hand-rolled encoders differ\n");
+		return 1;
+	}
+	printf("frame: template encoders match the hand-rolled ones\n");
+	TIME_ENCODER("frame: legacy trackControl", legacyTrackControl(buf, i, TRK_PLAY_POLY, i, 0));
+	TIME_ENCODER("frame: template trackControl", frameTrackControl(buf, i, TRK_PLAY_POLY, i, 0));
+	TIME_ENCODER("frame: legacy trackFade", legacyTrackFade(buf, i, -i, 1000, false));
+	TIME_ENCODER("frame: template trackFade", frameTrackFade(buf, i, -i, 1000, false));
+	TIME_ENCODER("frame: legacy masterGain", legacyMasterGain(buf, i, -i));
+	TIME_ENCODER("frame: template masterGain", frameMasterGain(buf, i, -i));
+	TIME_ENCODER("frame: legacy stopAll", legacyStopAll(buf));
+	TIME_ENCODER("frame: flash stopAll", frameStopAll(buf));
+	return 0;
+}
@@ -0,0 +1,104 @@
+// **************************************************************
+//     Filename: FrameEncoders.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: The hand-rolled txbuf encoders the library used
+//               before TsunamiFrame.h, next to the template versions.
+//               Built for the host by FrameBench and cross-compiled
+//               by "make sizes" to compare code size per target.
+//
+// **************************************************************
+
+#include "Tsunami.h"
+
+// **************************************************************
+// Hand-rolled encoders
+int legacyTrackControl(uint8_t *txbuf, int trk, int code, int out, int flags) {
+
+uint8_t o;
+
+	o = out & 0x07;
+	txbuf[0] = SOM1;
+	txbuf[1] = SOM2;
+	txbuf[2] = 0x0a;
+	txbuf[3] = CMD_TRACK_CONTROL;
+	txbuf[4] = (uint8_t)code;
+	txbuf[5] = (uint8_t)trk;
+	txbuf[6] = (uint8_t)(trk >> 8);
+	txbuf[7] = (uint8_t)o;
+	txbuf[8] = (uint8_t)flags;
+	txbuf[9] = EOM;
+	return 10;
+}
+
+int legacyTrackFade(uint8_t *txbuf, int trk, int gain, int time, bool stopFlag) {
+
+unsigned short vol;
+
+	txbuf[0] = SOM1;
+	txbuf[1] = SOM2;
+	txbuf[2] = 0x0c;
+	txbuf[3] = CMD_TRACK_FADE;
+	txbuf[4] = (uint8_t)trk;
+	txbuf[5] = (uint8_t)(trk >> 8);
+	vol = (unsigned short)gain;
+	txbuf[6] = (uint8_t)vol;
+	txbuf[7] = (uint8_t)(vol >> 8);
+	txbuf[8] = (uint8_t)time;
+	txbuf[9] = (uint8_t)(time >> 8);
+	txbuf[10] = stopFlag;
+	txbuf[11] = EOM;
+	return 12;
+}
+
+int legacyMasterGain(uint8_t *txbuf, int out, int gain) {
+
+unsigned short vol;
+
+	txbuf[0] = SOM1;
+	txbuf[1] = SOM2;
+	txbuf[2] = 0x08;
+	txbuf[3] = CMD_MASTER_VOLUME;
+	txbuf[4] = out & 0x07;
+	vol = (unsigned short)gain;
+	txbuf[5] = (uint8_t)vol;
+	txbuf[6] = (uint8_t)(vol >> 8);
+	txbuf[7] = EOM;
+	return 8;
+}
+
+int legacyStopAll(uint8_t *txbuf) {
+
+	txbuf[0] = SOM1;
+	txbuf[1] = SOM2;
+	txbuf[2] = 0x05;
+	txbuf[3] = CMD_STOP_ALL;
+	txbuf[4] = EOM;
+	return 5;
+}
+
+// **************************************************************
+// Template encoders
+int frameTrackControl(uint8_t *txbuf, int trk, int code, int out, int flags) {
+
+	MsgTrackControl::encode(txbuf, code, trk, out & 0x07, flags);
+	return MsgTrackControl::LEN;
+}
+
+int frameTrackFade(uint8_t *txbuf, int trk, int gain, int time, bool stopFlag) {
+
+	MsgTrackFade::encode(txbuf, trk, (uint16_t)gain, time, stopFlag);
+	return MsgTrackFade::LEN;
+}
+
+int frameMasterGain(uint8_t *txbuf, int out, int gain) {
+
+	MsgMasterVolume::encode(txbuf, out & 0x07, (uint16_t)gain);
+	return MsgMasterVolume::LEN;
+}
+
+int frameStopAll(uint8_t *txbuf) {
+
+	tsunamiCopyP(txbuf, TsunamiConstFrame<CMD_STOP_ALL>::data, TSUNAMI_FRAME_OVERHEAD);
+	return TSUNAMI_FRAME_OVERHEAD;
+}
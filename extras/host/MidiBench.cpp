@@ -0,0 +1,210 @@
+// **************************************************************
+//     Filename: MidiBench.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Checks and benchmarks of the MIDI translation.
+//               Checks running status, real-time and system
+//               exclusive bytes, note off forms and every action
+//               against the frames written, then measures the
+//               throughput over a long generated stream and the
+//               time from a message's arrival to its frames being
+//               written.
+//
+// **************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Tsunami.h"
+#include "BenchUtil.h"
+
+// Bytes in the generated stream
+#define STREAM_LEN		(4 * 1024 * 1024)
+// Messages timed one by one for the latency figures
+#define LATENCY_MSGS	200000
+
+static uint8_t gStream[STREAM_LEN + 8];
+static uint64_t gLatency[LATENCY_MSGS];
+
+// Transport that keeps what is written to it and counts the writes
+class BenchRecTransport : public TsunamiTransport
+{
+public:
+	BenchRecTransport() : len(0), writes(0) {;}
+	int available(void) { return 0; }
+	int read(void) { return -1; }
+	size_t write(const uint8_t *p, size_t n) {
+		if ((len + n) <= sizeof(buf)) {
+			memcpy(buf + len, p, n);
+			len += n;
+		}
+		writes++;
+		return n;
+	}
+
+	uint8_t buf[256];
+	size_t len;
+	uint32_t writes;
+};
+
+// Drums on channel 10 play polyphonic tracks 101-116 with the
+// velocity as gain, keys on channel 1 play and stop 201-261 locked,
+// CC 7 sets the gain of track 1, CC 20-27 the output gains, and
+// program changes select the MIDI bank
+static const TsunamiMidiMap gMap[] = {
+	{ MIDI_MAP_NOTE, 9, 36, 51, MIDI_PLAY_POLY, MIDI_VELOCITY, 0, -40, 0, 101 },
+	{ MIDI_MAP_NOTE, 0, 36, 96, MIDI_PLAY_POLY, MIDI_LOCK | MIDI_OFF_STOPS, 1, 0, 0, 201 },
+	{ MIDI_MAP_CC, MIDI_OMNI, 7, 7, MIDI_TRACK_GAIN, 0, 0, -70, 10, 1 },
+	{ MIDI_MAP_CC, MIDI_OMNI, 20, 27, MIDI_MASTER_GAIN, 0, 0, -70, 0, 0 },
+	{ MIDI_MAP_PROGRAM, MIDI_OMNI, 0, 31, MIDI_BANK, 0, 0, 0, 0, 1 }
+};
+
+// **************************************************************
+// Translates in and compares the frames written with expected
+static int check(const char *name, const uint8_t *in, int len, const uint8_t *expect, int expectLen,
+	uint32_t writes) {
+
+Tsunami tsunami;
+TsunamiMidi midi;
+BenchRecTransport rec;
+
+	tsunami.start(&rec);
+	rec.len = 0;
+	rec.writes = 0;
+	midi.begin(&tsunami, gMap, sizeof(gMap) / sizeof(gMap[0]));
+	midi.parse(in, len);
+	if ((rec.len != (size_t)expectLen) || memcmp(rec.buf, expect, expectLen) ||
+		(rec.writes != writes)) {
+		printf("midi: %s: wrong frames (%u bytes in %u writes)\n", name, (unsigned)rec.len, rec.writes);
+		return 1;
+	}
+	return 0;
+}
+
+static int checks(void) {
+
+uint8_t ex[128];
+int n;
+
+	// Two drum hits, the second with running status and a clock in
+	// the middle of it, then the same note off: not mapped to a stop
+	static const uint8_t drums[] = { 0x99, 36, 127, 38, 0xf8, 64, 0x89, 36, 0 };
+	n = 0;
+	MsgTrackVolume::encode(ex + n, 101, 0); n += MsgTrackVolume::LEN;
+	MsgTrackControl::encode(ex + n, TRK_PLAY_POLY, 101, 0, 0); n += MsgTrackControl::LEN;
+	MsgTrackVolume::encode(ex + n, 103, (uint16_t)-20); n += MsgTrackVolume::LEN;
+	MsgTrackControl::encode(ex + n, TRK_PLAY_POLY, 103, 0, 0); n += MsgTrackControl::LEN;
+	if (check("running status", drums, sizeof(drums), ex, n, 1))
+		return 1;
+
+	// Key down, system exclusive, then note on with velocity 0
+	static const uint8_t keys[] = { 0x90, 60, 100, 0xf0, 0x7e, 0x10, 0x90, 0xf7, 0x90, 60, 0 };
+	n = 0;
+	MsgTrackControl::encode(ex + n, TRK_PLAY_POLY, 225, 1, 1); n += MsgTrackControl::LEN;
+	MsgTrackControl::encode(ex + n, TRK_STOP, 225, 0, 0); n += MsgTrackControl::LEN;
+	if (check("sysex and note off", keys, sizeof(keys), ex, n, 1))
+		return 1;
+
+	// Controllers and program change, with an unmapped pitch bend
+	// and a song position in between
+	static const uint8_t ctl[] = { 0xb3, 7, 127, 21, 0, 0xe0, 0, 64, 0xf2, 1, 2, 0xc5, 4 };
+	n = 0;
+	MsgTrackVolume::encode(ex + n, 1, 10); n += MsgTrackVolume::LEN;
+	MsgMasterVolume::encode(ex + n, 1, (uint16_t)-70); n += MsgMasterVolume::LEN;
+	MsgSetMidiBank::encode(ex + n, 5); n += MsgSetMidiBank::LEN;
+	if (check("controllers", ctl, sizeof(ctl), ex, n, 1))
+		return 1;
+	printf("midi: ok\n");
+	return 0;
+}
+
+// **************************************************************
+// Generated stream: drum hits with running status, key presses and
+// releases, controller sweeps and MIDI clock. Returns its length
+static int generate(void) {
+
+int len = 0;
+int i;
+uint32_t r;
+
+	srand(1);
+	while (len < STREAM_LEN) {
+		r = rand() % 10;
+		if (r < 5) {
+			gStream[len++] = 0x99;
+			for (i = 0; i < 4; i++) {
+				gStream[len++] = 36 + rand() % 16;
+				gStream[len++] = 1 + rand() % 127;
+			}
+		}
+		else if (r < 7) {
+			gStream[len++] = 0x90;
+			gStream[len++] = 36 + rand() % 61;
+			gStream[len++] = (r == 5) ? 100 : 0;
+		}
+		else if (r < 9) {
+			gStream[len++] = 0xb0;
+			gStream[len++] = 7;
+			gStream[len++] = rand() % 128;
+		}
+		else
+			gStream[len++] = 0xf8;
+	}
+	return len;
+}
+
+static int cmpU64(const void *a, const void *b) {
+
+	return (*(const uint64_t *)a > *(const uint64_t *)b) - (*(const uint64_t *)a < *(const uint64_t *)b);
+}
+
+static void bench(void) {
+
+Tsunami tsunami;
+TsunamiMidi midi;
+BenchNullTransport null;
+uint64_t t0;
+uint64_t ns;
+int len;
+int pos;
+int i;
+uint8_t msg[3] = { 0x99, 36, 100 };
+
+	len = generate();
+	tsunami.start(&null);
+	midi.begin(&tsunami, gMap, sizeof(gMap) / sizeof(gMap[0]));
+	null.bytes = 0;
+	null.frames = 0;
+	t0 = benchNs();
+	for (pos = 0; pos < len; pos += MIDI_CHUNK_LEN)
+		midi.parse(gStream + pos, (len - pos) < MIDI_CHUNK_LEN ? len - pos : MIDI_CHUNK_LEN);
+	ns = benchNs() - t0;
+	benchReport("midi: stream in 32 byte windows", len, ns, "byte");
+	benchReport("midi: messages", midi.getMessages(), ns, "msg");
+	printf("midi: %u messages, %u unmapped, %llu frame bytes in %llu writes\n",
+		midi.getMessages(), midi.getUnmapped(), (unsigned long long)null.bytes,
+		(unsigned long long)null.frames);
+
+	// One drum hit per window: the time from the message to the
+	// write of its frames
+	for (i = 0; i < LATENCY_MSGS; i++) {
+		msg[1] = 36 + (i & 0x0f);
+		t0 = benchNs();
+		midi.parse(msg, sizeof(msg));
+		gLatency[i] = benchNs() - t0;
+	}
+	qsort(gLatency, LATENCY_MSGS, sizeof(gLatency[0]), cmpU64);
+	printf("midi: message to write  p50 %llu ns  p99 %llu ns  p99.9 %llu ns  max %llu ns\n",
+		(unsigned long long)gLatency[LATENCY_MSGS / 2],
+		(unsigned long long)gLatency[LATENCY_MSGS * 99 / 100],
+		(unsigned long long)gLatency[LATENCY_MSGS * 999 / 1000],
+		(unsigned long long)gLatency[LATENCY_MSGS - 1]);
+}
+
+int main(void) {
+
+	if (checks())
+		return 1;
+	bench();
+	return 0;
+}
@@ -0,0 +1,253 @@
+// **************************************************************
+//     Filename: ParserBench.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Micro-benchmark of the receive parser behind
+//               update(), over clean, noisy and damaged streams.
+//               For each scenario it reports the parse cost per
+//               byte, the frames recovered and lost, and the frames
+//               accepted with damaged contents. Lost frames are
+//               also given per injected error. Truncated and
+//               oversize frames do not count as sent, so there the
+//               figure is the loss beyond the damaged frame itself.
+//
+//               parser_bench [flip rate ...]
+//
+//               The bit-flip scenarios use the given rates (bit
+//               errors per bit), 1e-5 1e-4 1e-3 by default.
+//
+// **************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Tsunami.h"
+#include "BenchUtil.h"
+
+// Bytes per generated stream
+#define STREAM_LEN		(4 * 1024 * 1024)
+
+static uint8_t gStream[STREAM_LEN + 64];
+static size_t gLen;
+static uint32_t gSent;
+static uint32_t gErrors;
+static uint32_t gGood;
+static uint32_t gBogus;
+
+// xorshift32, so every run generates the same streams
+static uint32_t gSeed;
+
+static uint32_t rnd(void) {
+
+	gSeed ^= gSeed << 13;
+	gSeed ^= gSeed >> 17;
+	gSeed ^= gSeed << 5;
+	return gSeed;
+}
+
+// **************************************************************
+// Generated track reports check themselves: the voice and the
+// started flag are derived from the track number
+static void onReport(uint16_t track, uint8_t voice, bool didStart) {
+
+	if ((voice == (track % MAX_NUM_VOICES)) && (didStart == ((track >> 5) & 1)))
+		gGood++;
+	else
+		gBogus++;
+}
+
+static void putFrame(uint8_t type, const uint8_t *payload, int len) {
+
+	gStream[gLen++] = SOM1;
+	gStream[gLen++] = SOM2;
+	gStream[gLen++] = (uint8_t)(len + TSUNAMI_FRAME_OVERHEAD);
+	gStream[gLen++] = type;
+	memcpy(gStream + gLen, payload, len);
+	gLen += len;
+	gStream[gLen++] = EOM;
+	gSent++;
+}
+
+static void putTrackReport(void) {
+
+uint8_t p[4];
+uint16_t trk = (uint16_t)(rnd() % 4096 + 1);
+
+	p[0] = (uint8_t)(trk - 1);
+	p[1] = (uint8_t)((trk - 1) >> 8);
+	p[2] = trk % MAX_NUM_VOICES;
+	p[3] = (trk >> 5) & 1;
+	putFrame(RSP_TRACK_REPORT, p, 4);
+}
+
+static void putVersion(void) {
+
+static const char ver[VERSION_STRING_LEN - 1] = "Tsunami v1.10 mono   ";
+
+	putFrame(RSP_VERSION_STRING, (const uint8_t *)ver, VERSION_STRING_LEN - 1);
+}
+
+static void putSysInfo(void) {
+
+static const uint8_t info[3] = { MAX_NUM_VOICES, 0x00, 0x01 };
+
+	putFrame(RSP_SYSTEM_INFO, info, 3);
+}
+
+// **************************************************************
+// Stream generators, one per scenario
+static void genClean(int arg) {
+
+	(void)arg;
+	while (gLen < STREAM_LEN)
+		putTrackReport();
+}
+
+static void genMixed(int arg) {
+
+uint32_t r;
+
+	(void)arg;
+	while (gLen < STREAM_LEN) {
+		r = rnd() % 10;
+		if (r < 6)
+			putTrackReport();
+		else if (r < 8)
+			putVersion();
+		else
+			putSysInfo();
+	}
+}
+
+static void genNoise(int arg) {
+
+	(void)arg;
+	while (gLen < STREAM_LEN)
+		gStream[gLen++] = (uint8_t)rnd();
+}
+
+// Track reports with bursts of 1-16 noise bytes between them
+static void genInterleaved(int arg) {
+
+int n;
+
+	(void)arg;
+	while (gLen < STREAM_LEN) {
+		putTrackReport();
+		for (n = rnd() % 16 + 1; n > 0; n--)
+			gStream[gLen++] = (uint8_t)rnd();
+		gErrors++;
+	}
+}
+
+// One frame in arg cut short at a random point
+static void genTruncated(int arg) {
+
+size_t start;
+
+	while (gLen < STREAM_LEN) {
+		start = gLen;
+		putTrackReport();
+		if ((rnd() % arg) == 0) {
+			gLen = start + 1 + rnd() % 8;
+			gSent--;
+			gErrors++;
+		}
+	}
+}
+
+// One frame in arg with a length byte above MAX_MESSAGE_LEN
+static void genOversize(int arg) {
+
+size_t start;
+
+	while (gLen < STREAM_LEN) {
+		start = gLen;
+		putTrackReport();
+		if ((rnd() % arg) == 0) {
+			gStream[start + 2] = (uint8_t)(MAX_MESSAGE_LEN + 1 + rnd() % (255 - MAX_MESSAGE_LEN));
+			gSent--;
+			gErrors++;
+		}
+	}
+}
+
+// Clean track reports, then every bit flipped with probability
+// 1 / arg. Frames hit by a flip still count as sent, so frames lost
+// and bogus frames show how the parser copes
+static void genFlips(int arg) {
+
+size_t i;
+uint32_t bit;
+
+	genClean(0);
+	for (i = 0; i < gLen * 8; i += bit) {
+		bit = (uint32_t)(-log1p(-(double)(rnd() % 0xffffff + 1) / 0x1000000) * arg) + 1;
+		if ((i + bit) < (gLen * 8)) {
+			gStream[(i + bit) >> 3] ^= 1 << ((i + bit) & 7);
+			gErrors++;
+		}
+	}
+}
+
+// **************************************************************
+// Runs one scenario: generates its stream and parses it through
+// update()
+static void run(const char *name, void (*gen)(int), int arg) {
+
+static Tsunami tsunami;
+BenchMemTransport mem;
+TsunamiRxStats st;
+uint64_t t0;
+uint64_t ns;
+uint32_t frames;
+uint32_t lost;
+
+	gSeed = 0x2545f491;
+	gLen = 0;
+	gSent = 0;
+	gErrors = 0;
+	gen(arg);
+	tsunami.start(&mem);
+	tsunami.setTrackReportCallback(onReport);
+	tsunami.resetRxStats();
+	gGood = 0;
+	gBogus = 0;
+	mem.load(gStream, gLen);
+	t0 = benchNs();
+	while (mem.available())
+		tsunami.update();
+	ns = benchNs() - t0;
+	tsunami.getRxStats(&st);
+	frames = st.trackReports + st.versions + st.sysInfos;
+	lost = (gSent > (frames - gBogus)) ? gSent - (frames - gBogus) : 0;
+	printf("%-26s %6.2f ns/byte  sent %7u  recovered %7u  lost %6u (%5.2f%%, %4.2f/error)  bogus %5u  discarded %8u bytes\n",
+		name, (double)ns / gLen, gSent, frames - gBogus, lost,
+		gSent ? 100.0 * lost / gSent : 0.0, gErrors ? (double)lost / gErrors : 0.0,
+		gBogus, st.bytesDiscarded);
+}
+
+int main(int argc, char **argv) {
+
+static const double defRates[] = { 1e-5, 1e-4, 1e-3 };
+char name[32];
+double rate;
+int i;
+int n = (argc > 1) ? argc - 1 : 3;
+
+	run("clean track reports", genClean, 0);
+	run("mixed version/sysinfo", genMixed, 0);
+	run("random noise", genNoise, 0);
+	run("noise between frames", genInterleaved, 0);
+	run("truncated 1 in 20", genTruncated, 20);
+	run("oversize length 1 in 20", genOversize, 20);
+	for (i = 0; i < n; i++) {
+		rate = (argc > 1) ? atof(argv[i + 1]) : defRates[i];
+		if ((rate <= 0) || (rate > 0.5))
+			continue;
+		snprintf(name, sizeof(name), "bit flips %g", rate);
+		run(name, genFlips, (int)(1 / rate));
+	}
+	return 0;
+}
@@ -0,0 +1,286 @@
+// **************************************************************
+//     Filename: Replay.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Host replayer for TsunamiCapture logs. Pushes the
+//               received side of a log through Tsunami::update()
+//               at full speed and prints the track report sequence
+//               and the final voice table, or compares them with a
+//               trace saved from an earlier run.
+//
+//               tsunami_replay                 record a simulated
+//                                              show, replay it and
+//                                              time the replay
+//               tsunami_replay -r LOG          same, and save the
+//                                              log of the show
+//               tsunami_replay LOG             print the trace
+//               tsunami_replay LOG TRACE       compare with TRACE
+//
+// **************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Tsunami.h"
+#include "TsunamiSim.h"
+#include "BenchUtil.h"
+
+// Growing in-memory log
+class MemLog : public TsunamiTransport
+{
+public:
+	MemLog() : buf(NULL), len(0), cap(0) {;}
+	~MemLog() { free(buf); }
+	int available(void) { return 0; }
+	int read(void) { return -1; }
+	size_t write(const uint8_t *p, size_t n) {
+		if ((len + n) > cap) {
+			cap = (len + n) * 2;
+			buf = (uint8_t *)realloc(buf, cap);
+		}
+		memcpy(buf + len, p, n);
+		len += n;
+		return n;
+	}
+
+	uint8_t *buf;
+	size_t len;
+	size_t cap;
+};
+
+// Track reports seen by the callback, with the replay time stamp
+struct TraceEvent {
+	uint32_t us;
+	uint16_t track;
+	uint8_t voice;
+	bool didStart;
+};
+
+#define TRACE_MAX		200000
+
+static TraceEvent gTrace[TRACE_MAX];
+static int gTraceLen;
+static TsunamiReplay *gReplay;
+
+static void onReport(uint16_t track, uint8_t voice, bool didStart) {
+
+	if (gTraceLen >= TRACE_MAX)
+		return;
+	gTrace[gTraceLen].us = gReplay ? gReplay->getTimeUs() : 0;
+	gTrace[gTraceLen].track = track;
+	gTrace[gTraceLen].voice = voice;
+	gTrace[gTraceLen].didStart = didStart;
+	gTraceLen++;
+}
+
+// **************************************************************
+// Replays a log into a fresh Tsunami, filling gTrace
+static void replay(Tsunami *pT, TsunamiReplay *pR) {
+
+	gTraceLen = 0;
+	gReplay = pR;
+	// start() flushes whatever the transport has, so the log is
+	// rewound after it
+	pT->start(pR);
+	pR->rewind();
+	pT->setTrackReportCallback(onReport);
+	while (!pR->done())
+		pT->update();
+	gReplay = NULL;
+}
+
+// **************************************************************
+// Writes the trace and the final voice table as text
+static void printTrace(FILE *f, Tsunami *pT) {
+
+int i;
+
+	for (i = 0; i < gTraceLen; i++)
+		fprintf(f, "%10u us  track %4u  voice %2u  %s\n", gTrace[i].us,
+			gTrace[i].track, gTrace[i].voice, gTrace[i].didStart ? "on" : "off");
+	for (i = 0; i < MAX_NUM_VOICES; i++)
+		fprintf(f, "voice %2d  track %d\n", i, pT->getVoiceTrack(i));
+}
+
+static uint8_t *readFile(const char *name, size_t *pLen) {
+
+FILE *f = fopen(name, "rb");
+uint8_t *p;
+long n;
+
+	if (!f)
+		return NULL;
+	fseek(f, 0, SEEK_END);
+	n = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	p = (uint8_t *)malloc(n + 1);
+	if (fread(p, 1, n, f) != (size_t)n)
+		n = 0;
+	fclose(f);
+	p[n] = 0;
+	*pLen = n;
+	return p;
+}
+
+// **************************************************************
+// Replays LOG and prints or compares the trace
+static int replayFile(const char *logName, const char *traceName) {
+
+static Tsunami tsunami;
+uint8_t *log;
+uint8_t *ref;
+size_t logLen;
+size_t refLen;
+char *out;
+size_t outLen;
+FILE *f;
+size_t i;
+int line = 1;
+
+	if (!(log = readFile(logName, &logLen))) {
+		fprintf(stderr, "cannot read %s\n", logName);
+		return 2;
+	}
+	TsunamiReplay rep(log, logLen);
+	if (!rep.isValid()) {
+		fprintf(stderr, "%s is not a capture log\n", logName);
+		return 2;
+	}
+	replay(&tsunami, &rep);
+	if (!traceName) {
+		printTrace(stdout, &tsunami);
+		return 0;
+	}
+	if (!(ref = readFile(traceName, &refLen))) {
+		fprintf(stderr, "cannot read %s\n", traceName);
+		return 2;
+	}
+	f = open_memstream(&out, &outLen);
+	printTrace(f, &tsunami);
+	fclose(f);
+	for (i = 0; (i < outLen) && (i < refLen) && (out[i] == (char)ref[i]); i++) {
+		if (out[i] == '\n')
+			line++;
+	}
+	if ((i == outLen) && (i == refLen)) {
+		printf("%s: matches %s\n", logName, traceName);
+		return 0;
+	}
+	printf("%s: differs from %s at line %d\n", logName, traceName, line);
+	return 1;
+}
+
+// **************************************************************
+// Records a simulated show through a TsunamiCapture, replays the
+// log and checks the replay sees the same track reports as the
+// live run. Then times replaying the log
+static TsunamiSim *gSim;
+
+static uint32_t simClock(void) {
+
+	return gSim->now();
+}
+
+static int selfTest(const char *saveName) {
+
+static TraceEvent live[TRACE_MAX];
+static Tsunami tsunami;
+static Tsunami player;
+TsunamiSim sim;
+MemLog mem;
+TsunamiCapture cap(&sim, &mem);
+uint8_t bad[CAPTURE_HEADER_LEN + 9];
+uint64_t t0;
+uint64_t ns;
+uint64_t bytes = 0;
+FILE *f;
+int liveLen;
+int pass;
+int i;
+int j;
+
+	gSim = &sim;
+	cap.setClock(simClock);
+	sim.setNumTracks(200);
+	tsunami.start(&cap);
+	tsunami.setReporting(true);
+	tsunami.setTrackReportCallback(onReport);
+	gTraceLen = 0;
+	srand(7);
+	for (i = 0; i < 20000; i++) {
+		j = rand() % 100;
+		if (j < 60)
+			tsunami.trackPlayPoly(rand() % 200 + 1, rand() & 0x07, false);
+		else if (j < 90)
+			tsunami.trackStop(rand() % 200 + 1);
+		else
+			tsunami.trackLoop(rand() % 200 + 1, rand() & 1);
+		sim.advance(rand() % 20000);
+		tsunami.update();
+	}
+	liveLen = gTraceLen;
+	memcpy(live, gTrace, sizeof(TraceEvent) * liveLen);
+	if (saveName) {
+		if (!(f = fopen(saveName, "wb")) || (fwrite(mem.buf, 1, mem.len, f) != mem.len)) {
+			fprintf(stderr, "cannot write %s\n", saveName);
+			return 2;
+		}
+		fclose(f);
+	}
+
+	TsunamiReplay rep(mem.buf, mem.len);
+	replay(&player, &rep);
+	if ((gTraceLen != liveLen) || (rep.getTxBytes() == 0)) {
+		printf("replay: %d track reports live, %d replayed\n", liveLen, gTraceLen);
+		return 1;
+	}
+	for (i = 0; i < liveLen; i++) {
+		if ((live[i].track != gTrace[i].track) || (live[i].voice != gTrace[i].voice) ||
+				(live[i].didStart != gTrace[i].didStart)) {
+			printf("replay: track report %d differs\n", i);
+			return 1;
+		}
+	}
+	for (i = 0; i < MAX_NUM_VOICES; i++) {
+		if (player.getVoiceTrack(i) != tsunami.getVoiceTrack(i)) {
+			printf("replay: voice %d differs\n", i);
+			return 1;
+		}
+	}
+	// A time with more continuation bytes than 32 bits need ends the
+	// log like a record cut short
+	memcpy(bad, mem.buf, CAPTURE_HEADER_LEN);
+	i = CAPTURE_HEADER_LEN;
+	bad[i++] = 0x00;
+	for (j = 0; j < 6; j++)
+		bad[i++] = 0xff;
+	bad[i++] = 0x01;
+	bad[i++] = 0x55;
+	TsunamiReplay damaged(bad, i);
+	if (damaged.read() != -1) {
+		printf("replay: record with an overlong time read\n");
+		return 1;
+	}
+	printf("replay: ok (%u log bytes, %d track reports, %.1f s of show)\n",
+		(unsigned)mem.len, liveLen, gTrace[liveLen - 1].us / 1e6);
+
+	t0 = benchNs();
+	for (pass = 0; pass < 50; pass++) {
+		player.start(&rep);
+		rep.rewind();
+		while (!rep.done())
+			bytes += player.update(0, 0);
+	}
+	ns = benchNs() - t0;
+	benchReport("replay: bytes through update()", bytes, ns, "byte");
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	if ((argc > 2) && !strcmp(argv[1], "-r"))
+		return selfTest(argv[2]);
+	if (argc > 1)
+		return replayFile(argv[1], (argc > 2) ? argv[2] : NULL);
+	return selfTest(NULL);
+}
@@ -0,0 +1,113 @@
+// **************************************************************
+//     Filename: RxThreadBench.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Drives both sides of RX_DEFERRED mode at once: a
+//               receive thread stands in for the serial interrupt
+//               (simulated board + rxService()) while the main
+//               thread drains the event queue with update(). Checks
+//               that every event arrives exactly once and in order,
+//               or is counted as dropped.
+//
+// **************************************************************
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include "Tsunami.h"
+#include "TsunamiSim.h"
+#include "BenchUtil.h"
+
+#define RX_EVENTS		5000000
+
+static Tsunami gTsunami;
+static TsunamiSim gSim;
+static volatile bool gDone;
+static uint32_t gNext;
+static uint32_t gReceived;
+static uint32_t gOutOfOrder;
+
+// Sequence number k is sent as track (k % 4096) + 1 on voice k % 32
+static void onReport(uint16_t track, uint8_t voice, bool didStart) {
+
+uint32_t k;
+
+	(void)didStart;
+	// Find the next sequence number with this track and voice: events
+	// may have been dropped in between, but never reordered
+	k = gNext;
+	while ((((k & 0x0fff) + 1) != track) || ((k % MAX_NUM_VOICES) != voice)) {
+		k++;
+		if ((k - gNext) > (1 << 20)) {
+			gOutOfOrder++;
+			return;
+		}
+	}
+	gNext = k + 1;
+	gReceived++;
+}
+
+// Receive side: plays the board and the RX interrupt. Each pass
+// delivers a burst of up to burst frames, never more than the
+// simulated UART can hold, so no frame is lost before rxService().
+// Yielding after each burst stands in for the gaps between bytes on
+// a real serial line (and lets the test run on a single CPU)
+static void *rxThread(void *arg) {
+
+uint32_t sent = 0;
+int burst = *(int *)arg;
+int i;
+
+	while (sent < RX_EVENTS) {
+		for (i = 0; (i < burst) && (sent < RX_EVENTS); i++, sent++) {
+			if (gSim.available() > (TSUNAMI_SIM_RX_LEN - 16))
+				break;
+			gSim.injectTrackReport((sent & 0x0fff) + 1, sent % MAX_NUM_VOICES, true);
+		}
+		gTsunami.rxService();
+		sched_yield();
+	}
+	gTsunami.rxService();
+	gDone = true;
+	return NULL;
+}
+
+static void run(const char *name, int burst, int consumerDelay) {
+
+pthread_t thread;
+uint64_t t0;
+uint64_t ns;
+int n = 0;
+
+	gSim.reset();
+	gTsunami.start(&gSim);
+	gTsunami.setRxMode(RX_DEFERRED);
+	gTsunami.setTrackReportCallback(onReport);
+	gDone = false;
+	gNext = 0;
+	gReceived = 0;
+	gOutOfOrder = 0;
+	t0 = benchNs();
+	pthread_create(&thread, NULL, rxThread, &burst);
+	while (!gDone) {
+		gTsunami.update();
+		// A busy main loop only gets back to update() every so often
+		if (!consumerDelay || ((++n % consumerDelay) == 0))
+			sched_yield();
+	}
+	pthread_join(thread, NULL);
+	gTsunami.update();
+	ns = benchNs() - t0;
+	printf("%-34s %6.0f kevent/s  received %u  dropped %u  lost %u  out of order %u  %s\n", name,
+		(double)gReceived * 1e6 / (double)ns, gReceived, gTsunami.getEventsDropped(),
+		RX_EVENTS - gReceived - gTsunami.getEventsDropped(), gOutOfOrder,
+		((gReceived + gTsunami.getEventsDropped() == RX_EVENTS) && !gOutOfOrder) ? "ok" : "FAIL");
+}
+
+int main(void) {
+
+	run("deferred: bursts of 4", 4, 0);
+	run("deferred: bursts of 4, slow loop", 4, 8);
+	run("deferred: bursts of 64", 64, 0);
+	return 0;
+}
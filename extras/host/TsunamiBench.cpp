@@ -0,0 +1,1736 @@
+// **************************************************************
+//     Filename: TsunamiBench.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Host benchmark of the Tsunami library against the
+//               simulator: RX parsing through update(), the TX
+//               command encoders, multi-board groups, the
+//               latency monitor, the cue scheduler, sync groups
+//               and the start-up handshake
+//
+// **************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "Tsunami.h"
+#include "TsunamiSim.h"
+#include "TsunamiGroup.h"
+#include "BenchUtil.h"
+
+#define BENCH_FRAMES	2000000
+
+static uint32_t gReports;
+
+static void countReport(uint16_t track, uint8_t voice, bool didStart) {
+
+	(void)track;
+	(void)voice;
+	(void)didStart;
+	gReports++;
+}
+
+// **************************************************************
+// Start-up handshake, play, loop and stop against the simulator
+static int benchSmoke(void) {
+
+Tsunami tsunami;
+TsunamiSim sim;
+char version[VERSION_STRING_LEN];
+
+	sim.setNumTracks(100);
+	tsunami.start(&sim);
+	tsunami.setReporting(true);
+	if (!tsunami.getVersion(version, VERSION_STRING_LEN) || (tsunami.getNumTracks() != 100)) {
+		printf("smoke: handshake failed\n");
+		return 1;
+	}
+	tsunami.trackLoop(7, true);
+	tsunami.trackPlayPoly(7, 0, false);
+	tsunami.trackPlayPoly(8, 0, false);
+	sim.advance(TSUNAMI_SIM_LATENCY_US);
+	if ((tsunami.isTrackPlaying(7) < 0) || (tsunami.isTrackPlaying(8) < 0)) {
+		printf("smoke: tracks did not start\n");
+		return 1;
+	}
+	// Track 8 ends on its own, looping track 7 keeps going
+	sim.advance(TSUNAMI_SIM_TRACK_LEN_MS * 1000);
+	if ((tsunami.isTrackPlaying(7) < 0) || (tsunami.isTrackPlaying(8) >= 0)) {
+		printf("smoke: loop / end of track timing wrong\n");
+		return 1;
+	}
+	tsunami.trackStop(7);
+	sim.advance(TSUNAMI_SIM_LATENCY_US);
+	if (tsunami.isTrackPlaying(7) >= 0) {
+		printf("smoke: track did not stop\n");
+		return 1;
+	}
+	// The same track poly on three voices
+	tsunami.trackPlayPoly(9, 0, false);
+	tsunami.trackPlayPoly(9, 1, false);
+	tsunami.trackPlayPoly(9, 2, false);
+	sim.advance(TSUNAMI_SIM_LATENCY_US);
+	tsunami.update();
+	if (tsunami.trackVoiceCount(9) != 3) {
+		printf("smoke: poly voice count wrong\n");
+		return 1;
+	}
+	printf("smoke: ok (%s)\n", version);
+	return 0;
+}
+
+// **************************************************************
+// Receive statistics for a stream with every kind of framing error
+static int benchRxStats(void) {
+
+Tsunami tsunami;
+TsunamiSim sim;
+TsunamiRxStats st;
+static const uint8_t bad[] = {
+	0x00, 0x55,										// noise
+	SOM1, 0x00,										// bad SOM2
+	SOM1, SOM2, MAX_MESSAGE_LEN + 1,				// oversize
+	SOM1, SOM2, 0x00,								// undersize
+	SOM1, SOM2, 0x06, RSP_TRACK_REPORT,				// bad length for the type
+	SOM1, SOM2, 0x09, RSP_TRACK_REPORT,				// bad EOM
+	0x00, 0x00, 0x00, 0x00, 0x00,
+	SOM1, SOM2, 0x09, RSP_TRACK_REPORT,				// cut short, the next
+	SOM1, SOM2, 0x09, RSP_TRACK_REPORT,				// frame is found inside
+	0x01, 0x00, 0x01, 0x01, EOM,
+	SOM1, SOM2, 0x06, 0x99, 0x00, EOM,				// unknown type
+	SOM1, SOM2, 0x05, RSP_STATUS, EOM				// status
+};
+
+	tsunami.start(&sim);
+	tsunami.update();
+	tsunami.resetRxStats();
+	sim.inject(bad, sizeof(bad));
+	sim.injectTrackReport(1, 0, true);
+	tsunami.update();
+	tsunami.getRxStats(&st);
+	// Every rejected byte that is not a SOM1 is rescanned as noise
+	if ((st.noise != 7) || (st.badSom2 != 1) || (st.oversize != 1) || (st.undersize != 1) ||
+		(st.badLength != 1) || (st.badEom != 2) || (st.resyncs != 1) ||
+		(st.unknownType != 1) || (st.status != 1) ||
+		(st.trackReports != 2) || (st.bytesDiscarded != 27) || (st.overruns != 0)) {
+		printf("rx stats: wrong counts\n");
+		return 1;
+	}
+	// Overfill the simulated UART
+	while (sim.injectTrackReport(2, 0, true))
+		;
+	tsunami.update();
+	tsunami.getRxStats(&st);
+	printf("rx stats: ok (%u reports, %u bytes overrun)\n", st.trackReports, st.overruns);
+	return (st.overruns == 0);
+}
+
+// **************************************************************
+// Sync group of four stems, then a group that cannot get its voices
+// because every voice is held by a locked track
+static int benchSync(void) {
+
+Tsunami tsunami;
+TsunamiSim sim;
+TsunamiSyncGroup stems;
+TsunamiSyncGroup late;
+uint32_t t0;
+int i;
+
+	sim.setNumVoices(6);
+	tsunami.start(&sim);
+	tsunami.setReporting(true);
+	for (i = 0; i < 4; i++)
+		stems.add(20 + i, i, true);
+	if (!tsunami.syncStart(&stems, 100) || tsunami.syncStart(&stems, 100)) {
+		printf("sync: start refused or started twice\n");
+		return 1;
+	}
+	// Confirmed one report at a time, as the loads get their voices
+	for (i = 0; (i < 100) && (stems.getState() == SYNC_LOADING); i++) {
+		sim.advance(100);
+		tsunami.update();
+	}
+	sim.advance(TSUNAMI_SIM_LATENCY_US);
+	tsunami.update();
+	if ((stems.getState() != SYNC_STARTED) || (sim.activeVoices() != 4)) {
+		printf("sync: group did not start\n");
+		return 1;
+	}
+	for (i = 0; i < 4; i++) {
+		if (tsunami.isTrackPlaying(20 + i) != stems.memberVoice(i)) {
+			printf("sync: member %d not on its voice\n", i);
+			return 1;
+		}
+	}
+
+	// Two locked tracks take the last voices, so none can be stolen
+	tsunami.trackPlayPoly(30, 0, true);
+	tsunami.trackPlayPoly(31, 0, true);
+	late.add(40, 0, false);
+	tsunami.syncStart(&late, 2);
+	while (late.getState() == SYNC_LOADING) {
+		sim.advance(1000);
+		tsunami.update();
+	}
+	if ((late.getState() != SYNC_TIMED_OUT) || (late.getMissing() != 0x01)) {
+		printf("sync: missing member not reported\n");
+		return 1;
+	}
+	tsunami.syncCancel(&late);
+
+	// Reports already received when the time runs out still count
+	tsunami.stopAllTracks();
+	sim.advance(TSUNAMI_SIM_LATENCY_US);
+	tsunami.update();
+	late.clear();
+	late.add(41, 0, false);
+	tsunami.syncStart(&late, 1);
+	sim.advance(TSUNAMI_SIM_LATENCY_US);
+	t0 = millis();
+	while ((uint32_t)(millis() - t0) < 3)
+		;
+	tsunami.update();
+	if (late.getState() != SYNC_STARTED) {
+		printf("sync: buffered report came after the time out, wrong\n");
+		return 1;
+	}
+	// A cancel before any load is confirmed leaves nothing loaded
+	tsunami.stopAllTracks();
+	late.clear();
+	late.add(42, 0, false);
+	late.add(43, 1, false);
+	tsunami.syncStart(&late, 100);
+	tsunami.syncCancel(&late);
+	for (i = 0; i < 4; i++) {
+		sim.advance(TSUNAMI_SIM_LATENCY_US);
+		tsunami.update();
+	}
+	if (sim.activeVoices() != 0) {
+		printf("sync: cancelled loads left on %d voices, wrong\n", sim.activeVoices());
+		return 1;
+	}
+	printf("sync: ok (%u ms to confirm)\n", stems.getConfirmMs());
+	return 0;
+}
+
+// **************************************************************
+// Track state mirror: loop, gain, output, fade, pause and stop, from
+// the commands sent and the reports, then the cost of a query
+static int benchMirror(void) {
+
+Tsunami tsunami;
+TsunamiSim sim;
+TsunamiTrackMirror mirror;
+uint32_t fadeEnd;
+uint64_t t0;
+uint64_t ns;
+int sum = 0;
+int i;
+
+	tsunami.start(&sim);
+	tsunami.setReporting(true);
+	tsunami.setTrackMirror(&mirror);
+	tsunami.trackLoop(812, true);
+	tsunami.trackGain(812, -12);
+	tsunami.trackPlayPoly(812, 3, false);
+	if (!mirror.isPlaying(812) || (mirror.getFlags(812) & TRACK_CONFIRMED)) {
+		printf("mirror: play not seen\n");
+		return 1;
+	}
+	sim.advance(TSUNAMI_SIM_LATENCY_US);
+	tsunami.update();
+	if (!(mirror.getFlags(812) & TRACK_CONFIRMED) || (mirror.getVoices(812) != 1) ||
+		!mirror.isLooping(812) || (mirror.getOutput(812) != 3) ||
+		(mirror.getGain(812, millis()) != -12)) {
+		printf("mirror: wrong state after start report\n");
+		return 1;
+	}
+	tsunami.trackFade(812, -40, 1000, false);
+	fadeEnd = mirror.getFadeEndMs(812);
+	if ((mirror.getGain(812, fadeEnd - 500) != -26) || (mirror.getGain(812, fadeEnd) != -40) ||
+		!mirror.isFading(812, fadeEnd - 1) || mirror.isFading(812, fadeEnd)) {
+		printf("mirror: wrong fade\n");
+		return 1;
+	}
+	tsunami.trackPause(812);
+	if (!mirror.isPaused(812)) {
+		printf("mirror: pause not seen\n");
+		return 1;
+	}
+	tsunami.resumeAllInSync();
+	tsunami.trackStop(812);
+	sim.advance(TSUNAMI_SIM_LATENCY_US);
+	tsunami.update();
+	if (mirror.isPlaying(812) || (mirror.getVoices(812) != 0) || !mirror.isLooping(812)) {
+		printf("mirror: wrong state after stop\n");
+		return 1;
+	}
+	// Back to the default state: the track leaves the table
+	tsunami.trackLoop(812, false);
+	tsunami.trackGain(812, 0);
+	if (mirror.isKnown(812) || (mirror.getNumKnown() != 0)) {
+		printf("mirror: idle track kept\n");
+		return 1;
+	}
+	// A track that ends by itself is dropped on its stop report
+	tsunami.trackPlaySolo(5, 0, false);
+	sim.advance(TSUNAMI_SIM_LATENCY_US);
+	tsunami.update();
+	sim.advance((TSUNAMI_SIM_TRACK_LEN_MS + 10) * 1000);
+	tsunami.update();
+	if (mirror.isKnown(5)) {
+		printf("mirror: ended track kept\n");
+		return 1;
+	}
+
+	// Query cost with the table at its limit
+	for (i = 0; i < TRACK_MIRROR_MAX_USED; i++)
+		tsunami.trackGain(i * 97 + 1, -6);
+	t0 = benchNs();
+	for (i = 0; i < BENCH_FRAMES; i++)
+		sum += mirror.getGain(((i % TRACK_MIRROR_MAX_USED) * 97) + 1, 0);
+	ns = benchNs() - t0;
+	if (sum != -6 * BENCH_FRAMES) {
+		printf("mirror: wrong gain in full table\n");
+		return 1;
+	}
+	benchReport("mirror: getGain, full table", BENCH_FRAMES, ns, "query");
+	printf("mirror: ok\n");
+	return 0;
+}
+
+// **************************************************************
+// Cold start against a simulator that ignores commands for its
+// first 150 ms, in real time, then a board that never answers
+static int gReadyCalls;
+static bool gReadyOk;
+
+static void onReady(bool ready) {
+
+	gReadyCalls++;
+	gReadyOk = ready;
+}
+
+static int benchHandshake(void) {
+
+Tsunami tsunami;
+TsunamiSim sim;
+struct timespec ms = { 0, 1000000 };
+char ver[5];
+
+	sim.setNumTracks(321);
+	sim.setBootTime(150000);
+	tsunami.setReadyCallback(onReady);
+	tsunami.start(&sim);
+	if ((tsunami.getNumTracks() != -1) || tsunami.getVersion(ver, sizeof(ver))) {
+		printf("handshake: answers before the board booted\n");
+		return 1;
+	}
+	while (tsunami.getHandshakeState() < HANDSHAKE_READY) {
+		nanosleep(&ms, NULL);
+		sim.advance(1000);
+		tsunami.update();
+	}
+	if (!tsunami.isReady() || (gReadyCalls != 1) || !gReadyOk || (tsunami.getNumTracks() != 321) ||
+			!tsunami.getVersion(ver, sizeof(ver)) || strcmp(ver, "Tsun")) {
+		printf("handshake: cold start failed\n");
+		return 1;
+	}
+	printf("handshake: ready %u ms after start, board booted after 150 ms\n", tsunami.getReadyMs());
+
+	sim.reset();
+	sim.setBootTime(sim.now() + 0x7fffffff);
+	tsunami.setHandshake(2, 3);
+	tsunami.requestInfo();
+	while (tsunami.getHandshakeState() < HANDSHAKE_READY) {
+		nanosleep(&ms, NULL);
+		tsunami.update();
+	}
+	if ((tsunami.getHandshakeState() != HANDSHAKE_FAILED) || (gReadyCalls != 2) || gReadyOk) {
+		printf("handshake: silent board not reported\n");
+		return 1;
+	}
+	printf("handshake: silent board failed after %u ms\n", tsunami.getReadyMs());
+	return 0;
+}
+
+// **************************************************************
+// Track report flood through update()
+static void benchRx(void) {
+
+Tsunami tsunami;
+TsunamiSim sim;
+uint64_t t0;
+uint64_t ns = 0;
+uint32_t sent = 0;
+int i;
+
+	tsunami.start(&sim);
+	tsunami.update();
+	tsunami.setTrackReportCallback(countReport);
+	gReports = 0;
+	while (sent < BENCH_FRAMES) {
+		// Fill the simulated UART, then time draining it
+		for (i = 0; i < (TSUNAMI_SIM_RX_LEN / 9); i++, sent++)
+			sim.injectTrackReport((sent & 0x0fff) + 1, sent % MAX_NUM_VOICES, sent & 1);
+		t0 = benchNs();
+		tsunami.update();
+		ns += benchNs() - t0;
+	}
+	benchReport("rx: track report frames", gReports, ns, "frame");
+	benchReport("rx: bytes", (uint64_t)gReports * 9, ns, "byte");
+}
+
+// **************************************************************
+// Time per update() call while the simulated UART is kept full of
+// track reports, with and without a budget. The maximum includes
+// host scheduler noise, so the 99.9th percentile is shown as well
+#define BUDGET_CALLS	200000
+
+static int cmpU64(const void *a, const void *b) {
+
+	return (*(const uint64_t *)a > *(const uint64_t *)b) - (*(const uint64_t *)a < *(const uint64_t *)b);
+}
+
+static void benchRxBudget(const char *name, int maxBytes, uint32_t maxMicros) {
+
+static uint64_t dt[BUDGET_CALLS];
+Tsunami tsunami;
+TsunamiSim sim;
+uint64_t t0;
+uint64_t total = 0;
+uint64_t bytes = 0;
+uint32_t sent = 0;
+int calls;
+
+	tsunami.start(&sim);
+	tsunami.update();
+	for (calls = 0; calls < BUDGET_CALLS; calls++) {
+		// Top the UART up to full before every call
+		while (sim.injectTrackReport((sent & 0x0fff) + 1, sent % MAX_NUM_VOICES, sent & 1))
+			sent++;
+		t0 = benchNs();
+		bytes += tsunami.update(maxBytes, maxMicros);
+		dt[calls] = benchNs() - t0;
+		total += dt[calls];
+	}
+	qsort(dt, BUDGET_CALLS, sizeof(dt[0]), cmpU64);
+	printf("%-36s %12.0f byte/s  p50 %6.0f  p99.9 %6.0f  max %8.0f ns/call\n", name,
+		(double)bytes * 1e9 / (double)total, (double)dt[BUDGET_CALLS / 2],
+		(double)dt[BUDGET_CALLS - BUDGET_CALLS / 1000], (double)dt[BUDGET_CALLS - 1]);
+}
+
+// **************************************************************
+// Polling isTrackPlaying() for many tracks with every voice busy
+static void benchQuery(void) {
+
+Tsunami tsunami;
+TsunamiSim sim;
+uint64_t t0;
+uint32_t hits = 0;
+int i;
+int n;
+
+	tsunami.start(&sim);
+	tsunami.update();
+	for (i = 0; i < MAX_NUM_VOICES; i++)
+		sim.injectTrackReport(i * 97 + 1, i, true);
+	tsunami.update();
+	t0 = benchNs();
+	for (n = 0; n < BENCH_FRAMES / 4; n++) {
+		for (i = 1; i <= 48; i++)
+			hits += (tsunami.isTrackPlaying(i * 97 - 96) >= 0);
+	}
+	benchReport("query: isTrackPlaying", (uint64_t)n * 48, benchNs() - t0, "call");
+	printf("query: %u hits\n", hits);
+}
+
+// **************************************************************
+// Command encoders into a transport that discards the bytes
+static void benchTx(void) {
+
+Tsunami tsunami;
+BenchNullTransport null;
+uint64_t t0;
+int i;
+
+	tsunami.start(&null);
+	null.frames = 0;
+	t0 = benchNs();
+	for (i = 0; i < BENCH_FRAMES; i++)
+		tsunami.trackPlayPoly((i & 0x0fff) + 1, i & 0x07, false);
+	benchReport("tx: trackPlayPoly", null.frames, benchNs() - t0, "frame");
+
+	null.frames = 0;
+	t0 = benchNs();
+	for (i = 0; i < BENCH_FRAMES; i++)
+		tsunami.trackFade((i & 0x0fff) + 1, -(i & 0x3f), 1000, false);
+	benchReport("tx: trackFade", null.frames, benchNs() - t0, "frame");
+
+	null.frames = 0;
+	t0 = benchNs();
+	for (i = 0; i < BENCH_FRAMES; i++)
+		tsunami.masterGain(i & 0x07, -(i & 0x3f));
+	benchReport("tx: masterGain", null.frames, benchNs() - t0, "frame");
+
+	// Bursts of 12 cues (120 bytes) queued, then drained by update()
+	tsunami.setTxMode(TX_QUEUED, TX_OVERFLOW_DROP);
+	null.frames = 0;
+	t0 = benchNs();
+	for (i = 0; i < BENCH_FRAMES; i++) {
+		tsunami.trackPlayPoly((i & 0x0fff) + 1, i & 0x07, false);
+		if ((i % 12) == 11)
+			tsunami.update();
+	}
+	tsunami.update();
+	benchReport("tx: queued trackPlayPoly", null.frames, benchNs() - t0, "frame");
+	printf("tx: queued frames dropped %u\n", tsunami.getTxDropped());
+}
+
+// **************************************************************
+// Knobs and LFOs sending gains and samplerate offsets at loop rate,
+// with and without the coalescing stage
+static void benchCoalesce(void) {
+
+Tsunami tsunami;
+BenchNullTransport null;
+TsunamiCoalesceStats stats;
+uint64_t raw[2];
+int pass;
+int i;
+int o;
+double lfo;
+
+	tsunami.start(&null);
+	for (pass = 0; pass < 2; pass++) {
+		tsunami.setCoalescing(pass == 1, 0);
+		tsunami.resetCoalesceStats();
+		null.bytes = 0;
+		for (i = 0; i < 100000; i++) {
+			lfo = sin(i / 2000.0);
+			for (o = 0; o < TSUNAMI_NUM_OUTPUTS; o++)
+				tsunami.masterGain(o, -10 + (int)(6 * lfo));
+			tsunami.samplerateOffset(0, (int)(lfo * 4) * 256);
+			tsunami.trackGain(1 + (i & 3), -(i / 25000));
+			tsunami.update();
+		}
+		raw[pass] = null.bytes;
+	}
+	tsunami.getCoalesceStats(&stats);
+	printf("coalesce: %llu bytes without, %llu with (%.1fx), %u suppressed, %u merged\n",
+		(unsigned long long)raw[0], (unsigned long long)raw[1],
+		raw[1] ? (double)raw[0] / (double)raw[1] : 0.0, stats.suppressed, stats.merged);
+}
+
+// **************************************************************
+// Cost of one group update() as boards are added: idle, and with
+// every board receiving 8 track reports between calls
+#define GROUP_CALLS		200000
+
+static void benchGroup(void) {
+
+static Tsunami boards[TSUNAMI_GROUP_MAX];
+static TsunamiSim sims[TSUNAMI_GROUP_MAX];
+TsunamiGroup group;
+char name[48];
+uint64_t t0;
+uint64_t ns;
+uint32_t sent = 0;
+int n;
+int b;
+int i;
+int calls;
+
+	for (n = 1; n <= TSUNAMI_GROUP_MAX; n <<= 1) {
+		while (group.numBoards() < n) {
+			b = group.numBoards();
+			boards[b].start(&sims[b]);
+			boards[b].update();
+			group.add(&boards[b]);
+		}
+		t0 = benchNs();
+		for (calls = 0; calls < GROUP_CALLS; calls++)
+			group.update();
+		snprintf(name, sizeof(name), "group: %d boards, idle", n);
+		benchReport(name, GROUP_CALLS, benchNs() - t0, "call");
+
+		ns = 0;
+		for (calls = 0; calls < GROUP_CALLS / n; calls++) {
+			for (b = 0; b < n; b++) {
+				for (i = 0; i < 8; i++, sent++)
+					sims[b].injectTrackReport((sent & 0x0fff) + 1, sent % MAX_NUM_VOICES, sent & 1);
+			}
+			t0 = benchNs();
+			group.update();
+			ns += benchNs() - t0;
+		}
+		snprintf(name, sizeof(name), "group: %d boards, 8 reports each", n);
+		benchReport(name, (uint64_t)calls * n * 8, ns, "frame");
+	}
+	// Cues spread over every output of the group
+	t0 = benchNs();
+	for (i = 0; i < BENCH_FRAMES; i++)
+		group.trackPlayPoly((i & 0x0fff) + 1, i % group.numOutputs(), false);
+	benchReport("group: trackPlayPoly", BENCH_FRAMES, benchNs() - t0, "frame");
+}
+
+// **************************************************************
+// Latency monitor against the simulator, whose latency is varied
+// per command. The monitor runs on the simulator's virtual clock,
+// which is advanced in 50 us steps with an update() after each
+static TsunamiSim *gLatencySim;
+
+static uint32_t simClock(void) {
+
+	return gLatencySim->now();
+}
+
+static void printHistogram(const char *name, const TsunamiHistogram &h) {
+
+	printf("%-36s %6u  min %5u  p50 %5u  p99 %5u  max %5u  mean %5u us\n", name,
+		h.count(), h.minUs(), h.percentileUs(50), h.percentileUs(99), h.maxUs(), h.meanUs());
+}
+
+static int benchLatency(void) {
+
+Tsunami tsunami;
+TsunamiSim sim;
+TsunamiLatency mon;
+BenchNullTransport null;
+uint64_t t0;
+uint64_t ns[2];
+int pass;
+int i;
+int t;
+
+	gLatencySim = &sim;
+	mon.setClock(simClock);
+	tsunami.start(&sim);
+	tsunami.setReporting(true);
+	tsunami.setLatencyMonitor(&mon);
+	srand(1);
+	for (i = 0; i < 2000; i++) {
+		sim.setLatency(2000 + rand() % 4000);
+		tsunami.trackPlayPoly(i % 100 + 1, 0, false);
+		for (t = 0; t < 8000; t += 50) {
+			sim.advance(50);
+			tsunami.update();
+		}
+		sim.setLatency(1000 + rand() % 2000);
+		tsunami.trackStop(i % 100 + 1);
+		for (t = 0; t < 4000; t += 50) {
+			sim.advance(50);
+			tsunami.update();
+		}
+	}
+	printHistogram("latency: play to start report", mon.start);
+	printHistogram("latency: stop to stop report", mon.stop);
+	printf("latency: %u unmatched\n", mon.getUnmatched());
+
+	// A play the full queue dropped, and a play never reported, must
+	// not be matched with the next report of their track
+	sim.setLatency(TSUNAMI_SIM_LATENCY_US);
+	mon.clear();
+	tsunami.setReporting(false);
+	tsunami.trackPlayPoly(9, 0, false);
+	for (t = 0; t < (int)LATENCY_TIMEOUT_US + 100000; t += 1000) {
+		sim.advance(1000);
+		tsunami.update();
+	}
+	tsunami.setReporting(true);
+	tsunami.setTxMode(TX_QUEUED, TX_OVERFLOW_DROP);
+	for (i = 0; i <= TX_QUEUE_PLAY_LEN / MsgResumeAllSync::LEN; i++)
+		tsunami.resumeAllInSync();
+	tsunami.trackPlayPoly(8, 0, false);
+	if (!tsunami.getTxDropped()) {
+		printf("latency: play queue did not fill\n");
+		return 1;
+	}
+	for (t = 0; t < 20000; t += 50) {
+		sim.advance(50);
+		tsunami.update();
+	}
+	tsunami.trackPlayPoly(8, 0, false);
+	tsunami.trackPlayPoly(9, 0, false);
+	for (t = 0; t < 10000; t += 50) {
+		sim.advance(50);
+		tsunami.update();
+	}
+	if ((mon.start.count() != 2) || (mon.start.maxUs() > 10000) || (mon.getUnmatched() != 1)) {
+		printf("latency: stale plays matched, %u us at most\n", mon.start.maxUs());
+		return 1;
+	}
+	tsunami.setTxMode(TX_DIRECT, TX_OVERFLOW_DROP);
+	printf("latency: ok\n");
+
+	// Cost of the monitor on the command path
+	mon.setClock(NULL);
+	tsunami.start(&null);
+	for (pass = 0; pass < 2; pass++) {
+		tsunami.setLatencyMonitor(pass ? &mon : NULL);
+		t0 = benchNs();
+		for (i = 0; i < BENCH_FRAMES; i++)
+			tsunami.trackPlayPoly((i & 0x0fff) + 1, i & 0x07, false);
+		ns[pass] = benchNs() - t0;
+	}
+	benchReport("latency: trackPlayPoly, no monitor", BENCH_FRAMES, ns[0], "frame");
+	benchReport("latency: trackPlayPoly, monitor", BENCH_FRAMES, ns[1], "frame");
+	return 0;
+}
+
+// **************************************************************
+// Voice telemetry: a steal by hand on the simulator's clock, then
+// plays of distinct tracks at random times into 8 voices with the
+// board's silent steals, where every play finding all voices busy
+// must be counted as a steal
+#define VOICE_PLAYS		4000
+
+static uint32_t gSteals;
+static uint16_t gStealOld;
+static uint16_t gStealNew;
+static uint8_t gStealVoice;
+
+static void onSteal(uint16_t oldTrack, uint16_t newTrack, uint8_t voice) {
+
+	gSteals++;
+	gStealOld = oldTrack;
+	gStealNew = newTrack;
+	gStealVoice = voice;
+}
+
+static int benchVoices(void) {
+
+Tsunami tsunami;
+TsunamiSim sim;
+TsunamiVoiceStats mon;
+uint32_t expect = 0;
+uint64_t elapsed;
+int pass;
+int i;
+
+	gLatencySim = &sim;
+	mon.setClock(simClock);
+	mon.setStealCallback(onSteal);
+	tsunami.start(&sim);
+	tsunami.setVoiceMonitor(&mon);
+	sim.injectTrackReport(1, 0, true);
+	tsunami.update();
+	sim.advance(1000);
+	sim.injectTrackReport(2, 0, true);
+	tsunami.update();
+	sim.advance(2000);
+	sim.injectTrackReport(2, 0, false);
+	tsunami.update();
+	sim.advance(1000);
+	if ((mon.getSteals() != 1) || (gSteals != 1) || (gStealOld != 1) || (gStealNew != 2) ||
+		(gStealVoice != 0) || (mon.getVoiceStarts(0) != 2) || (mon.getBusyUs(0) != 3000) ||
+		(mon.getPeak() != 1) || (mon.getTimeAtUs(1) != 3000) || (mon.getElapsedUs() != 4000) ||
+		(mon.getMeanMilli() != 750)) {
+		printf("voices: wrong counts for a steal\n");
+		return 1;
+	}
+	// A track restarting on its own voice is no steal, and a voice
+	// busy for longer than the 71 minute clock period is timed in full
+	sim.injectTrackReport(3, 1, true);
+	tsunami.update();
+	sim.injectTrackReport(3, 1, true);
+	tsunami.update();
+	for (i = 0; i < 8; i++) {
+		sim.advance(600000000UL);
+		mon.getElapsedUs();
+	}
+	sim.injectTrackReport(3, 1, false);
+	tsunami.update();
+	if ((mon.getSteals() != 1) || (gSteals != 1) || (mon.getVoiceStarts(1) != 2) ||
+		(mon.getBusyUs(1) != 4800000000ULL)) {
+		printf("voices: wrong counts for a restart, busy %llu us\n", (unsigned long long)mon.getBusyUs(1));
+		return 1;
+	}
+
+	// With the simulator's stop reports on steals nothing is counted
+	for (pass = 0; pass < 2; pass++) {
+		sim.reset();
+		sim.setNumVoices(8);
+		sim.setStealReports(pass == 0);
+		tsunami.start(&sim);
+		tsunami.setReporting(true);
+		mon.clear();
+		gSteals = 0;
+		expect = 0;
+		srand(1);
+		for (i = 0; i < VOICE_PLAYS; i++) {
+			if ((pass == 1) && (sim.activeVoices() == 8))
+				expect++;
+			tsunami.trackPlayPoly(i + 1, 0, false);
+			sim.advance(TSUNAMI_SIM_LATENCY_US);
+			tsunami.update();
+			sim.advance((rand() % 3000) * 1000);
+			tsunami.update();
+		}
+		if ((mon.getSteals() != expect) || (gSteals != expect) || (mon.getPeak() != 8)) {
+			printf("voices: %u steals counted, %u expected\n", mon.getSteals(), expect);
+			return 1;
+		}
+	}
+	elapsed = mon.getElapsedUs();
+	printf("voices: %u plays into 8 voices, %u stolen, peak %d, mean %u.%03u\n", VOICE_PLAYS,
+		mon.getSteals(), mon.getPeak(), mon.getMeanMilli() / 1000, mon.getMeanMilli() % 1000);
+	printf("voices: time at n voices  ");
+	for (i = 0; i <= 8; i++)
+		printf(" %d:%4.1f%%", i, 100.0 * mon.getTimeAtUs(i) / elapsed);
+	printf("\nvoices: busy per voice    ");
+	for (i = 0; i < 8; i++)
+		printf(" %d:%4.1f%%", i, 100.0 * mon.getBusyUs(i) / elapsed);
+	printf("\nvoices: ok\n");
+	return 0;
+}
+
+// **************************************************************
+// Priority classes in TX_QUEUED mode, on a serial port at 57600 baud
+// with a 16 byte transmit FIFO, one byte leaving every 174 us of a
+// virtual clock. First the order the frames of a held queue come
+// out in, then stops sent into bursts of gains: the time until the
+// stop is on the wire, and the time it would have waited at the end
+// of a single queue
+#define UART_FIFO_LEN	16
+#define UART_BYTE_US	174
+#define PRIO_ROUNDS		2000
+
+class BenchUartTransport : public TsunamiTransport
+{
+public:
+	BenchUartTransport() : nowUs(0), fifo(0), len(0), hold(false), stopUs(0) {;}
+	int available(void) { return 0; }
+	int read(void) { return -1; }
+	size_t write(const uint8_t *p, size_t n) {
+		if ((len + n) <= sizeof(buf)) {
+			memcpy(buf + len, p, n);
+			len += n;
+		}
+		fifo += n;
+		if ((p[3] == CMD_STOP_ALL) || ((p[3] == CMD_TRACK_CONTROL) && (p[4] == TRK_STOP)))
+			stopUs = nowUs + fifo * UART_BYTE_US;
+		return n;
+	}
+	int availableForWrite(void) { return hold ? 0 : UART_FIFO_LEN - fifo; }
+	// One byte time
+	void tick(void) {
+		nowUs += UART_BYTE_US;
+		if (fifo)
+			fifo--;
+	}
+
+	uint32_t nowUs;
+	uint32_t fifo;
+	uint8_t buf[256];
+	size_t len;
+	bool hold;
+	// When the last byte of the last stop written leaves
+	uint32_t stopUs;
+};
+
+static BenchUartTransport *gUart;
+
+static uint32_t uartClock(void) {
+
+	return gUart->nowUs;
+}
+
+// Queues the commands of fill with the port held, then releases it
+// and compares what comes out with expect
+static int checkPrio(const char *name, void (*fill)(Tsunami &t), const uint8_t *expect, int expectLen) {
+
+Tsunami tsunami;
+BenchUartTransport uart;
+
+	tsunami.start(&uart);
+	tsunami.setTxMode(TX_QUEUED, TX_OVERFLOW_DROP);
+	uart.len = 0;
+	uart.hold = true;
+	fill(tsunami);
+	uart.hold = false;
+	while (tsunami.txPending()) {
+		uart.tick();
+		tsunami.update();
+	}
+	if ((uart.len != (size_t)expectLen) || memcmp(uart.buf, expect, expectLen)) {
+		printf("tx prio: %s: wrong order\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+// Gain burst on tracks 1-2, a play of track 2 that must follow its
+// gain, a play of 3 and a stop of 9 that go ahead
+static void fillPlays(Tsunami &t) {
+
+	t.trackGain(1, -10);
+	t.trackGain(2, -20);
+	t.trackPlayPoly(2, 0, false);
+	t.trackPlayPoly(3, 0, false);
+	t.trackStop(9);
+}
+
+// A stop that must follow the play of its track, and a stop all
+// that drops the queued plays and goes first after that stop
+static void fillStops(Tsunami &t) {
+
+	t.trackGain(1, -10);
+	t.trackPlayPoly(4, 0, false);
+	t.trackStop(4);
+	t.trackPlayPoly(5, 0, false);
+	t.stopAllTracks();
+}
+
+// A play held in the BULK ring behind the gain of its track, then a
+// burst of master gains: the stop all drops the play and goes first
+static void fillStopBulk(Tsunami &t) {
+
+int i;
+
+	t.trackGain(5, -10);
+	t.trackPlayPoly(5, 0, false);
+	for (i = 0; i < 10; i++)
+		t.masterGain(0, -i);
+	t.stopAllTracks();
+}
+
+static int benchTxPrio(void) {
+
+Tsunami tsunami;
+Tsunami board;
+BenchUartTransport uart;
+TsunamiTxDelay mon;
+TsunamiPolyManager poly;
+TsunamiHistogram stop;
+TsunamiHistogram fifo;
+uint8_t ex[128];
+uint32_t t0;
+int round;
+int i;
+int n;
+
+	n = 0;
+	MsgTrackControl::encode(ex + n, TRK_STOP, 9, 0, 0); n += MsgTrackControl::LEN;
+	MsgTrackControl::encode(ex + n, TRK_PLAY_POLY, 3, 0, 0); n += MsgTrackControl::LEN;
+	MsgTrackVolume::encode(ex + n, 1, (uint16_t)-10); n += MsgTrackVolume::LEN;
+	MsgTrackVolume::encode(ex + n, 2, (uint16_t)-20); n += MsgTrackVolume::LEN;
+	MsgTrackControl::encode(ex + n, TRK_PLAY_POLY, 2, 0, 0); n += MsgTrackControl::LEN;
+	if (checkPrio("play after its gain", fillPlays, ex, n))
+		return 1;
+	n = 0;
+	MsgTrackControl::encode(ex + n, TRK_STOP, 4, 0, 0); n += MsgTrackControl::LEN;
+	MsgStopAll::encode(ex + n); n += MsgStopAll::LEN;
+	MsgTrackVolume::encode(ex + n, 1, (uint16_t)-10); n += MsgTrackVolume::LEN;
+	if (checkPrio("stop all", fillStops, ex, n))
+		return 1;
+	n = 0;
+	MsgStopAll::encode(ex + n); n += MsgStopAll::LEN;
+	MsgTrackVolume::encode(ex + n, 5, (uint16_t)-10); n += MsgTrackVolume::LEN;
+	for (i = 0; i < 10; i++) {
+		MsgMasterVolume::encode(ex + n, 0, (uint16_t)-i);
+		n += MsgMasterVolume::LEN;
+	}
+	if (checkPrio("stop all behind a held play", fillStopBulk, ex, n))
+		return 1;
+	// Only the plays and loads are dropped: the loop flag goes out, and
+	// the monitors forget the frames that never will
+	gUart = &uart;
+	mon.setClock(uartClock);
+	poly.setClock(uartClock);
+	board.start(&uart);
+	board.setTxMode(TX_QUEUED, TX_OVERFLOW_DROP);
+	board.setTxDelayMonitor(&mon);
+	board.setPolyManager(&poly);
+	uart.len = 0;
+	uart.hold = true;
+	board.trackLoop(6, true);
+	board.trackPlayPrio(7, 0, POLY_PRIO_LOW);
+	board.trackLoad(8, 0, false);
+	board.trackLoop(8, true);
+	board.stopAllTracks();
+	uart.hold = false;
+	while (board.txPending()) {
+		uart.tick();
+		board.update();
+	}
+	n = 0;
+	MsgTrackControl::encode(ex + n, TRK_LOOP_ON, 6, 0, 0); n += MsgTrackControl::LEN;
+	MsgTrackControl::encode(ex + n, TRK_LOOP_ON, 8, 0, 0); n += MsgTrackControl::LEN;
+	MsgStopAll::encode(ex + n); n += MsgStopAll::LEN;
+	if ((uart.len != (size_t)n) || memcmp(uart.buf, ex, n) || (board.getTxDropped() != 2) ||
+		(poly.getPending() != 0) || (mon.delay[TX_PRIO_PLAY].count() != 3)) {
+		printf("tx prio: stop all dropped the wrong frames\n");
+		return 1;
+	}
+	mon.clear();
+	// A port that never reports room, waited on in the interrupt
+	// mode: the frames must come out directly instead of hanging
+	tsunami.start(&uart);
+	tsunami.setTxMode(TX_QUEUED_ISR, TX_OVERFLOW_BLOCK);
+	uart.hold = true;
+	uart.fifo = 0;
+	for (i = 0; i < 40; i++)
+		tsunami.trackGain(i + 1, -10);
+	tsunami.setTxMode(TX_DIRECT, TX_OVERFLOW_DROP);
+	uart.hold = false;
+	if ((uart.fifo != 40 * MsgTrackVolume::LEN) || tsunami.getTxDropped()) {
+		printf("tx prio: blocking wait: wrong bytes %u\n", uart.fifo);
+		return 1;
+	}
+	uart.fifo = 0;
+	// A play ring full of the shortest frames and one more waiting
+	// for room: every frame must still be timed
+	gUart = &uart;
+	mon.setClock(uartClock);
+	tsunami.start(&uart);
+	tsunami.setTxMode(TX_QUEUED, TX_OVERFLOW_BLOCK);
+	tsunami.setTxDelayMonitor(&mon);
+	uart.hold = true;
+	n = TX_QUEUE_PLAY_LEN / MsgResumeAllSync::LEN + 5;
+	for (i = 0; i < n; i++)
+		tsunami.resumeAllInSync();
+	tsunami.setTxMode(TX_DIRECT, TX_OVERFLOW_DROP);
+	uart.hold = false;
+	uart.fifo = 0;
+	if (mon.delay[TX_PRIO_PLAY].count() != (uint32_t)n) {
+		printf("tx prio: full ring timed %u of %d frames, wrong\n", mon.delay[TX_PRIO_PLAY].count(), n);
+		return 1;
+	}
+	tsunami.setTxDelayMonitor(NULL);
+	printf("tx prio: ok\n");
+
+	gUart = &uart;
+	mon.setClock(uartClock);
+	tsunami.start(&uart);
+	tsunami.setTxMode(TX_QUEUED, TX_OVERFLOW_DROP);
+	tsunami.setTxDelayMonitor(&mon);
+	srand(1);
+	for (round = 0; round < PRIO_ROUNDS; round++) {
+		// A burst of 12 gains, then 0 - 2 ms later a stop or a play
+		for (i = 0; i < 12; i++)
+			tsunami.trackGain(i % 8 + 1, -(rand() % 40));
+		tsunami.update();
+		n = rand() % 12;
+		for (i = 0; i < n; i++) {
+			uart.tick();
+			tsunami.update();
+		}
+		t0 = uart.nowUs;
+		if (round & 1) {
+			// The bytes queued and in the FIFO go out before it
+			fifo.add((tsunami.txPending() + uart.fifo + MsgTrackControl::LEN) * UART_BYTE_US);
+			tsunami.trackStop(100);
+		}
+		else
+			tsunami.trackPlayPoly(100, 0, false);
+		while (tsunami.txPending() || uart.fifo) {
+			uart.tick();
+			tsunami.update();
+		}
+		if (round & 1)
+			stop.add(uart.stopUs - t0);
+	}
+	printHistogram("tx prio: stop to wire", stop);
+	printHistogram("tx prio: stop to wire, single queue", fifo);
+	printHistogram("tx prio: queued, stop class", mon.delay[TX_PRIO_STOP]);
+	printHistogram("tx prio: queued, play class", mon.delay[TX_PRIO_PLAY]);
+	printHistogram("tx prio: queued, bulk class", mon.delay[TX_PRIO_BULK]);
+	printf("tx prio: queued frames dropped %u\n", tsunami.getTxDropped());
+	// At worst the stop waits for a full FIFO and a frame boundary
+	if (stop.maxUs() > (uint32_t)(UART_FIFO_LEN + 2 * MsgTrackControl::LEN) * UART_BYTE_US) {
+		printf("tx prio: stop waited too long\n");
+		return 1;
+	}
+	return 0;
+}
+
+// **************************************************************
+// Coalescing with a full queue that drops: a gain the queue lost must
+// not be suppressed as a repeat of the value on the board
+static int benchCoalesceDrop(void) {
+
+Tsunami tsunami;
+BenchUartTransport uart;
+int i;
+
+	tsunami.start(&uart);
+	tsunami.setTxMode(TX_QUEUED, TX_OVERFLOW_DROP);
+	tsunami.setCoalescing(true, 0);
+	uart.hold = true;
+	for (i = 0; i < TX_QUEUE_LEN / MsgTrackVolume::LEN; i++)
+		tsunami.trackGain(i + 1, -10);
+	tsunami.masterGain(0, -5);
+	if (!tsunami.getTxDropped()) {
+		printf("coalesce drop: queue did not fill\n");
+		return 1;
+	}
+	uart.hold = false;
+	while (tsunami.txPending()) {
+		uart.tick();
+		tsunami.update();
+	}
+	uart.len = 0;
+	tsunami.masterGain(0, -5);
+	while (tsunami.txPending()) {
+		uart.tick();
+		tsunami.update();
+	}
+	if ((uart.len != MsgMasterVolume::LEN) || (uart.buf[3] != CMD_MASTER_VOLUME)) {
+		printf("coalesce drop: dropped gain stays suppressed\n");
+		return 1;
+	}
+	printf("coalesce drop: ok\n");
+	return 0;
+}
+
+// **************************************************************
+// Polyphony manager: random plays of random priorities into 8
+// voices under each policy. The board must never steal a voice, the
+// protected tracks must play to their end, and a play stops no more
+// tracks than the reserve needs. Then the track each stealing policy
+// picks, and the cost of a play once the budget is full, with 31
+// tracks held
+#define POLY_PLAYS		4000
+#define POLY_PROT_TRACKS	2
+
+static uint32_t gVoiceStartUs[MAX_NUM_VOICES];
+static uint32_t gEarlyStops;
+
+static void polyReport(uint16_t track, uint8_t voice, bool didStart) {
+
+uint32_t t = gLatencySim->now();
+
+	if (didStart)
+		gVoiceStartUs[voice] = t;
+	else if ((track <= POLY_PROT_TRACKS) &&
+		((t - gVoiceStartUs[voice]) < TSUNAMI_SIM_TRACK_LEN_MS * 1000UL))
+		gEarlyStops++;
+}
+
+static uint32_t zeroClock(void) {
+
+	return 0;
+}
+
+static int benchPoly(void) {
+
+static const char *names[] = { "lru", "lowest", "reject" };
+Tsunami tsunami;
+TsunamiSim sim;
+TsunamiVoiceStats mon;
+TsunamiPolyManager poly;
+BenchNullTransport null;
+uint64_t t0;
+uint64_t ns[2];
+uint32_t stolen;
+int need;
+int mode;
+int prio;
+int r;
+int i;
+
+	gLatencySim = &sim;
+	mon.setClock(simClock);
+	poly.setClock(simClock);
+	for (mode = POLY_STEAL_LRU; mode <= POLY_REJECT; mode++) {
+		sim.reset();
+		sim.setNumVoices(8);
+		sim.setStealReports(false);
+		tsunami.start(&sim);
+		for (i = 0; (i < 100) && !tsunami.isReady(); i++) {
+			sim.advance(10000);
+			tsunami.update();
+		}
+		tsunami.setReporting(true);
+		tsunami.setTrackReportCallback(polyReport);
+		tsunami.setVoiceMonitor(&mon);
+		tsunami.setPolyManager(&poly);
+		poly.setMode(mode);
+		gEarlyStops = 0;
+		srand(1);
+		for (i = 0; i < POLY_PLAYS; i++) {
+			r = rand() % 100;
+			if (r == 0)
+				prio = POLY_PRIO_PROTECTED;
+			else if (r < 20)
+				prio = POLY_PRIO_HIGH;
+			else if (r < 60)
+				prio = POLY_PRIO_NORMAL;
+			else
+				prio = POLY_PRIO_LOW;
+			// Voices still stopping will be free: only the others
+			// and this play count against the reserve
+			need = poly.getBusy() + poly.getPending() + 1 + POLY_RESERVE - 8;
+			stolen = poly.getStolen();
+			if (prio == POLY_PRIO_PROTECTED)
+				tsunami.trackPlayPrio(rand() % POLY_PROT_TRACKS + 1, 0, prio);
+			else
+				tsunami.trackPlayPrio(rand() % 100 + POLY_PROT_TRACKS + 1, 0, prio);
+			if ((int)(poly.getStolen() - stolen) > ((need > 0) ? need : 0)) {
+				printf("poly %s: one play stopped %u tracks\n", names[mode], poly.getStolen() - stolen);
+				return 1;
+			}
+			sim.advance(TSUNAMI_SIM_LATENCY_US);
+			tsunami.update();
+			sim.advance((rand() % 1000) * 1000);
+			tsunami.update();
+			if (poly.getUsed() > 8) {
+				printf("poly %s: %d voices used, budget 8\n", names[mode], poly.getUsed());
+				return 1;
+			}
+		}
+		if (mon.getSteals() || gEarlyStops || (mon.getPeak() != 8) ||
+			((mode == POLY_REJECT) ? (poly.getStolen() || !poly.getRejected()) : !poly.getStolen())) {
+			printf("poly %s: %u board steals, %u protected tracks cut, %u stopped, %u refused\n",
+				names[mode], mon.getSteals(), gEarlyStops, poly.getStolen(), poly.getRejected());
+			return 1;
+		}
+		printf("poly %s: %u plays into 8 voices, %u stopped, %u refused, %u board steals, mean %u.%03u\n",
+			names[mode], POLY_PLAYS, poly.getStolen(), poly.getRejected(), mon.getSteals(),
+			mon.getMeanMilli() / 1000, mon.getMeanMilli() % 1000);
+	}
+	tsunami.setVoiceMonitor(NULL);
+	tsunami.setTrackReportCallback(NULL);
+
+	// Track 1 (normal) played first, then 2 - 7 (low): a normal play
+	// stops exactly one track, 1 when stealing the least recently
+	// played and 2 when stealing the lowest priority
+	for (mode = POLY_STEAL_LRU; mode <= POLY_STEAL_LOWEST; mode++) {
+		sim.reset();
+		sim.setNumVoices(8);
+		tsunami.start(&sim);
+		for (i = 0; (i < 100) && !tsunami.isReady(); i++) {
+			sim.advance(10000);
+			tsunami.update();
+		}
+		tsunami.setReporting(true);
+		tsunami.setPolyManager(&poly);
+		poly.setMode(mode);
+		for (i = 1; i <= 8; i++) {
+			tsunami.trackPlayPrio(i, 0, ((i == 1) || (i == 8)) ? POLY_PRIO_NORMAL : POLY_PRIO_LOW);
+			sim.advance(TSUNAMI_SIM_LATENCY_US);
+			tsunami.update();
+			sim.advance(TSUNAMI_SIM_LATENCY_US);
+			tsunami.update();
+		}
+		r = (mode == POLY_STEAL_LRU) ? 1 : 2;
+		if ((poly.getStolen() != 1) || (poly.getBusy() != 7) || (poly.getStopping() != 0) ||
+			(poly.getPriority(r) != -1) || (poly.getPriority(3 - r) < 0)) {
+			printf("poly %s: %u tracks stopped for one play, track 1 %d, track 2 %d\n", names[mode],
+				poly.getStolen(), poly.getPriority(1), poly.getPriority(2));
+			return 1;
+		}
+	}
+	tsunami.setPolyManager(NULL);
+
+	// No reports: every play stays waiting, so once 31 are held each
+	// play stops the oldest
+	poly.setClock(zeroClock);
+	poly.setMode(POLY_STEAL_LRU);
+	tsunami.start(&null);
+	for (i = 0; i < 2; i++) {
+		tsunami.setPolyManager(i ? &poly : NULL);
+		t0 = benchNs();
+		for (r = 0; r < BENCH_FRAMES / 2; r++)
+			tsunami.trackPlayPrio((r & 0x0fff) + 1, 0, r % 3);
+		ns[i] = benchNs() - t0;
+	}
+	tsunami.setPolyManager(NULL);
+	benchReport("poly: trackPlayPrio, no manager", BENCH_FRAMES / 2, ns[0], "play");
+	benchReport("poly: trackPlayPrio, budget full", BENCH_FRAMES / 2, ns[1], "play");
+	if ((poly.getStolen() + poly.getRejected()) != (uint32_t)(BENCH_FRAMES / 2 - MAX_NUM_VOICES + POLY_RESERVE)) {
+		printf("poly: %u stopped and %u refused of %u plays\n", poly.getStolen(), poly.getRejected(),
+			BENCH_FRAMES / 2);
+		return 1;
+	}
+	printf("poly: ok\n");
+	return 0;
+}
+
+// **************************************************************
+// Mixer scenes: the first scene goes out whole in one write, an
+// unchanged one not at all, and the next only with the settings that
+// differ, also after direct masterGain() calls. Then the time to
+// apply a whole scene and a small change, against setting the 17
+// values one call at a time
+#define SCENE_ROUNDS	200000
+
+class BenchWriteLog : public TsunamiTransport
+{
+public:
+	BenchWriteLog() : writes(0), bytes(0), len(0) {;}
+	int available(void) { return 0; }
+	int read(void) { return -1; }
+	size_t write(const uint8_t *p, size_t n) {
+		writes++;
+		bytes += n;
+		len = (n < sizeof(last)) ? n : sizeof(last);
+		memcpy(last, p, len);
+		return n;
+	}
+
+	uint32_t writes;
+	uint32_t bytes;
+	uint8_t last[256];
+	size_t len;
+};
+
+static int benchScene(void) {
+
+Tsunami tsunami;
+TsunamiScene a;
+TsunamiScene b;
+TsunamiScene c;
+BenchWriteLog log;
+BenchNullTransport null;
+uint64_t t0;
+uint8_t expect[SCENE_BLOB_LEN];
+uint32_t bytes;
+int len;
+int i;
+
+	for (i = 0; i < TSUNAMI_NUM_OUTPUTS; i++) {
+		a.setGain(i, -6 - i);
+		a.setRate(i, i * 100);
+		b.setGain(i, -6 - i);
+		b.setRate(i, i * 100);
+	}
+	a.setInputMix(IMIX_OUT1);
+	b.setInputMix(IMIX_OUT1 | IMIX_OUT2);
+	b.setGain(2, -20);
+	b.setRate(7, -300);
+	tsunami.start(&log);
+	log.writes = 0;
+	len = tsunami.applyScene(&a);
+	if ((len != SCENE_BLOB_LEN) || (log.writes != 1) || memcmp(log.last, a.getFrames(), SCENE_BLOB_LEN)) {
+		printf("scene: first apply sent %d bytes in %u writes\n", len, log.writes);
+		return 1;
+	}
+	if (tsunami.applyScene(&a) || (log.writes != 1)) {
+		printf("scene: unchanged scene sent again\n");
+		return 1;
+	}
+	// Gain of output 2, offset of output 7 and the mix differ
+	len = tsunami.applyScene(&b);
+	memcpy(expect, b.getFrames() + SCENE_GAIN_OFS + 2 * MsgMasterVolume::LEN, MsgMasterVolume::LEN);
+	memcpy(expect + 8, b.getFrames() + SCENE_RATE_OFS + 7 * MsgSamplerateOffset::LEN, MsgSamplerateOffset::LEN);
+	memcpy(expect + 16, b.getFrames() + SCENE_MIX_OFS, MsgSetInputMix::LEN);
+	if ((len != 22) || (log.writes != 2) || (log.len != 22) || memcmp(log.last, expect, 22)) {
+		printf("scene: delta sent %d bytes in %u writes\n", len, log.writes - 1);
+		return 1;
+	}
+	// A direct call is part of the state the next scene is compared to
+	tsunami.masterGain(5, 0);
+	if ((tsunami.applyScene(&b) != MsgMasterVolume::LEN) ||
+		memcmp(log.last, b.getFrames() + SCENE_GAIN_OFS + 5 * MsgMasterVolume::LEN, MsgMasterVolume::LEN)) {
+		printf("scene: masterGain() not taken into account\n");
+		return 1;
+	}
+	if (!tsunami.captureScene(&c) || memcmp(c.getFrames(), b.getFrames(), SCENE_BLOB_LEN) ||
+		(c.getGain(2) != -20) || (c.getRate(7) != -300) || (c.getInputMix() != (IMIX_OUT1 | IMIX_OUT2))) {
+		printf("scene: captured scene differs\n");
+		return 1;
+	}
+	// Queued, the frames come out the same. When the queue drops some,
+	// the next scene goes out whole
+	tsunami.start(&log);
+	tsunami.setTxMode(TX_QUEUED, TX_OVERFLOW_BLOCK);
+	bytes = log.bytes;
+	tsunami.applyScene(&a);
+	while (tsunami.txPending())
+		tsunami.update();
+	if (log.bytes - bytes != SCENE_BLOB_LEN) {
+		printf("scene: queued apply sent %u bytes\n", log.bytes - bytes);
+		return 1;
+	}
+	tsunami.start(&log);
+	tsunami.setTxMode(TX_QUEUED, TX_OVERFLOW_DROP);
+	tsunami.applyScene(&a);
+	while (tsunami.txPending())
+		tsunami.update();
+	if (!tsunami.getTxDropped() || (tsunami.applyScene(&a) != SCENE_BLOB_LEN)) {
+		printf("scene: dropped frames not sent again\n");
+		return 1;
+	}
+	tsunami.setTxMode(TX_DIRECT, TX_OVERFLOW_DROP);
+	printf("scene: ok, %d bytes in 1 write, a change of 3 settings in 22 bytes\n", SCENE_BLOB_LEN);
+
+	// c differs from a in every setting
+	for (i = 0; i < TSUNAMI_NUM_OUTPUTS; i++) {
+		c.setGain(i, -30 - i);
+		c.setRate(i, -1 - i * 100);
+	}
+	c.setInputMix(IMIX_OUT4);
+	tsunami.start(&null);
+	null.frames = 0;
+	t0 = benchNs();
+	for (i = 0; i < SCENE_ROUNDS; i++)
+		tsunami.applyScene((i & 1) ? &a : &c);
+	benchReport("scene: whole scene", SCENE_ROUNDS, benchNs() - t0, "scene");
+	printf("scene: %.1f writes per whole scene\n", (double)null.frames / SCENE_ROUNDS);
+	null.frames = 0;
+	t0 = benchNs();
+	for (i = 0; i < SCENE_ROUNDS; i++)
+		tsunami.applyScene((i & 1) ? &a : &b);
+	benchReport("scene: 3 settings changed", SCENE_ROUNDS, benchNs() - t0, "scene");
+	null.frames = 0;
+	t0 = benchNs();
+	for (i = 0; i < SCENE_ROUNDS; i++) {
+		for (len = 0; len < TSUNAMI_NUM_OUTPUTS; len++) {
+			tsunami.masterGain(len, a.getGain(len));
+			tsunami.samplerateOffset(len, a.getRate(len));
+		}
+		tsunami.setInputMix(a.getInputMix());
+	}
+	benchReport("scene: 17 calls", SCENE_ROUNDS, benchNs() - t0, "scene");
+	printf("scene: %.1f writes per 17 calls\n", (double)null.frames / SCENE_ROUNDS);
+	return 0;
+}
+
+// **************************************************************
+// Event dispatch: version and system info at start-up, track
+// reports to the listeners of their track only, a listener object,
+// removal, then parser errors. Then the time per report through
+// update() as the subscriptions grow, against a report callback that
+// searches its list of tracks
+#define DISPATCH_SUBS_MAX	512
+
+struct BenchListener {
+	uint32_t calls;
+	uint32_t versions;
+	uint32_t sysinfos;
+	uint32_t errors;
+	uint16_t lastTrack;
+};
+
+static void benchListen(void *pCtx, const TsunamiDispatchEvent &ev) {
+
+BenchListener *pL = (BenchListener *)pCtx;
+
+	pL->calls++;
+	switch (ev.type) {
+		case DISPATCH_TRACK_REPORT:
+			pL->lastTrack = ev.track;
+		break;
+		case DISPATCH_VERSION:
+			if (ev.version && ev.version[0])
+				pL->versions++;
+		break;
+		case DISPATCH_SYSINFO:
+			if (ev.track == TSUNAMI_SIM_MAX_TRACKS)
+				pL->sysinfos++;
+		break;
+		case DISPATCH_RX_ERROR:
+			pL->errors += ev.errors;
+		break;
+	}
+}
+
+class BenchFunctor
+{
+public:
+	BenchFunctor() : calls(0) {;}
+	void operator()(const TsunamiDispatchEvent &ev) { calls += ev.track; }
+	uint32_t calls;
+};
+
+static uint16_t gSubTracks[DISPATCH_SUBS_MAX];
+static int gSubCount;
+static uint32_t gSubHits;
+
+static void searchReport(uint16_t track, uint8_t voice, bool didStart) {
+
+int i;
+
+	(void)voice;
+	(void)didStart;
+	for (i = 0; i < gSubCount; i++) {
+		if (gSubTracks[i] == track) {
+			gSubHits++;
+			break;
+		}
+	}
+}
+
+static void countListen(void *pCtx, const TsunamiDispatchEvent &ev) {
+
+	(void)ev;
+	(*(uint32_t *)pCtx)++;
+}
+
+static uint64_t dispatchRun(Tsunami &tsunami, TsunamiSim &sim) {
+
+uint64_t t0;
+uint64_t ns = 0;
+uint32_t sent = 0;
+int i;
+
+	while (sent < BENCH_FRAMES / 4) {
+		for (i = 0; i < (TSUNAMI_SIM_RX_LEN / 9); i++, sent++)
+			sim.injectTrackReport((sent & 0x0fff) + 1, sent % MAX_NUM_VOICES, sent & 1);
+		t0 = benchNs();
+		tsunami.update();
+		ns += benchNs() - t0;
+	}
+	return ns;
+}
+
+static int benchDispatch(void) {
+
+static const uint8_t bad[] = {
+	SOM1, 0x00, SOM1, SOM2, MAX_MESSAGE_LEN + 1, SOM1, SOM2, 0x00,
+	SOM1, SOM2, 0x06, RSP_TRACK_REPORT, SOM1, SOM2, 0x09, RSP_TRACK_REPORT,
+	0x00, 0x00, 0x00, 0x00, 0x00
+};
+Tsunami tsunami;
+Tsunami other;
+TsunamiSim sim;
+TsunamiSim otherSim;
+TsunamiDispatcher disp;
+BenchListener a;
+BenchListener b;
+BenchListener all;
+BenchFunctor obj;
+TsunamiRxStats st;
+uint32_t counts[DISPATCH_LISTENERS];
+char name[48];
+uint64_t ns;
+uint32_t hits;
+int ida;
+int idb;
+int idall;
+int idobj;
+int subs;
+int i;
+
+	memset(&a, 0, sizeof(a));
+	memset(&b, 0, sizeof(b));
+	memset(&all, 0, sizeof(all));
+	ida = disp.addListener(benchListen, &a, DISPATCH_TRACK_REPORT);
+	idb = disp.addListener(benchListen, &b, DISPATCH_VERSION | DISPATCH_SYSINFO | DISPATCH_RX_ERROR);
+	idall = disp.addListener(benchListen, &all, DISPATCH_ALL);
+	idobj = disp.addListener(&obj, DISPATCH_TRACK_REPORT);
+	disp.subscribe(ida, 10, 19);
+	disp.subscribe(idobj, 15);
+	disp.subscribeAll(idall, true);
+	tsunami.start(&sim);
+	tsunami.setDispatcher(&disp);
+	for (i = 0; (i < 100) && !tsunami.isReady(); i++) {
+		sim.advance(10000);
+		tsunami.update();
+	}
+	if ((b.versions != 1) || (b.sysinfos != 1) || (all.versions != 1) || (a.calls != 0)) {
+		printf("dispatch: version and sysinfo not dispatched\n");
+		return 1;
+	}
+	sim.injectTrackReport(5, 0, true);
+	sim.injectTrackReport(15, 1, true);
+	sim.injectTrackReport(25, 2, true);
+	tsunami.update();
+	if ((a.calls != 1) || (a.lastTrack != 15) || (obj.calls != 15) || (b.calls != 2) ||
+		(all.calls != 5) || (all.lastTrack != 25)) {
+		printf("dispatch: reports reached the wrong listeners\n");
+		return 1;
+	}
+	disp.removeListener(ida);
+	disp.unsubscribe(idobj, 1, 4096);
+	sim.injectTrackReport(15, 1, false);
+	tsunami.update();
+	if ((a.calls != 1) || (obj.calls != 15) || (all.calls != 6)) {
+		printf("dispatch: removed listener called\n");
+		return 1;
+	}
+	// Counted from zero again after a reset
+	tsunami.resetRxStats();
+	sim.inject(bad, sizeof(bad));
+	tsunami.update();
+	tsunami.getRxStats(&st);
+	hits = st.badSom2 + st.oversize + st.undersize + st.badLength + st.badEom;
+	if (!hits || (b.errors != hits) || (all.errors != hits)) {
+		printf("dispatch: %u parser errors dispatched, %u expected\n", b.errors, hits);
+		return 1;
+	}
+	// A second board on the same dispatcher counts its own errors
+	other.start(&otherSim);
+	other.setDispatcher(&disp);
+	tsunami.update();
+	if (b.errors != hits) {
+		printf("dispatch: parser errors dispatched again for a second board\n");
+		return 1;
+	}
+	otherSim.inject(bad, sizeof(bad));
+	other.update();
+	tsunami.update();
+	if ((b.errors != 2 * hits) || (all.errors != 2 * hits)) {
+		printf("dispatch: %u parser errors from two boards, %u expected\n", b.errors, 2 * hits);
+		return 1;
+	}
+	other.setDispatcher(NULL);
+	printf("dispatch: ok\n");
+	disp.removeListener(idb);
+	disp.removeListener(idall);
+	disp.removeListener(idobj);
+	tsunami.setDispatcher(NULL);
+
+	// Single track subscriptions spread over 8 listeners
+	for (i = 0; i < DISPATCH_LISTENERS; i++) {
+		counts[i] = 0;
+		disp.addListener(countListen, &counts[i], DISPATCH_TRACK_REPORT);
+	}
+	tsunami.setReporting(false);
+	for (subs = 1, gSubCount = 0; subs <= DISPATCH_SUBS_MAX; subs *= 8) {
+		for (; gSubCount < subs; gSubCount++) {
+			gSubTracks[gSubCount] = (gSubCount * 7) % 4096 + 1;
+			disp.subscribe(gSubCount % DISPATCH_LISTENERS, gSubTracks[gSubCount]);
+		}
+		tsunami.setTrackReportCallback(searchReport);
+		gSubHits = 0;
+		ns = dispatchRun(tsunami, sim);
+		snprintf(name, sizeof(name), "dispatch: %3d subs, callback search", subs);
+		benchReport(name, BENCH_FRAMES / 4, ns, "report");
+		tsunami.setTrackReportCallback(NULL);
+		tsunami.setDispatcher(&disp);
+		for (i = 0; i < DISPATCH_LISTENERS; i++)
+			counts[i] = 0;
+		ns = dispatchRun(tsunami, sim);
+		tsunami.setDispatcher(NULL);
+		snprintf(name, sizeof(name), "dispatch: %3d subs, dispatcher", subs);
+		benchReport(name, BENCH_FRAMES / 4, ns, "report");
+		for (i = 0, hits = 0; i < DISPATCH_LISTENERS; i++)
+			hits += counts[i];
+		if (hits != gSubHits) {
+			printf("dispatch: %u listener calls, %u expected\n", hits, gSubHits);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// **************************************************************
+// Cue blob records match the run time encoders, then a show of
+// cues 500 us apart runs on the real clock while update() spins
+#define CUE_SHOW_LEN	2000
+
+static const uint8_t gCueBlob[] TSUNAMI_PROGMEM = {
+	TSUNAMI_CUE_PLAY_POLY(100, 300, 2),
+	TSUNAMI_CUE_FADE(200, 300, -40, 1000, 1),
+	TSUNAMI_CUE_TRACK_GAIN(300, 300, -6),
+	TSUNAMI_CUE_MASTER_GAIN(400, 5, -12),
+	TSUNAMI_CUE_STOP_ALL(500)
+};
+
+static int benchCues(void) {
+
+static uint8_t show[CUE_SHOW_LEN * 14];
+Tsunami tsunami;
+BenchNullTransport null;
+TsunamiCueList cues;
+TsunamiCueList ram;
+uint8_t a[CUE_FRAME_LEN];
+uint8_t b[CUE_FRAME_LEN];
+uint64_t t0;
+uint64_t ns = 0;
+uint32_t calls = 0;
+int pos = 0;
+int la;
+int lb;
+int i;
+
+	cues.loadBlob(gCueBlob, sizeof(gCueBlob));
+	ram.addTrack(100, TRK_PLAY_POLY, 300, 2, false);
+	ram.addFade(200, 300, -40, 1000, true);
+	ram.addTrackGain(300, 300, -6);
+	ram.addMasterGain(400, 5, -12);
+	ram.add(500, TsunamiConstFrame<CMD_STOP_ALL>::data);
+	if ((cues.pending() != 5) || (ram.pending() != 5)) {
+		printf("cues: wrong pending count\n");
+		return 1;
+	}
+	cues.start(0);
+	ram.start(0);
+	for (i = 0; i < 5; i++) {
+		la = cues.next(1000, a);
+		lb = ram.next(1000, b);
+		if ((la == 0) || (la != lb) || memcmp(a, b, la)) {
+			printf("cues: blob record %d does not match its encoder\n", i);
+			return 1;
+		}
+	}
+	// Cues due at the same time keep the order they were added in,
+	// also for a cue held while many later ones come and go
+	ram.clear();
+	ram.start(0);
+	ram.addTrackGain(2000, 99, -6);
+	for (la = 0; la < 9000; la++) {
+		for (i = 0; i < 8; i++)
+			ram.addTrackGain(1000, i + 1, -6);
+		for (i = 0; i < 8; i++) {
+			if (!ram.next(1000, a) || ((a[4] | (a[5] << 8)) != i + 1)) {
+				printf("cues: cues with equal times out of order, wrong\n");
+				return 1;
+			}
+		}
+	}
+	ram.addTrackGain(2000, 100, -6);
+	if (!ram.next(2000, a) || (a[4] != 99) || !ram.next(2000, b) || (b[4] != 100)) {
+		printf("cues: held cue went out after a later one, wrong\n");
+		return 1;
+	}
+	// A cue 40 minutes into the show is not due after 1 ms
+	ram.clear();
+	ram.start(5000);
+	ram.addTrackGain(0, 1, -6);
+	ram.addTrackGain(2400000000UL, 2, -6);
+	if (!ram.next(6000, a) || (a[4] != 1) || ram.next(6000, b) ||
+		(ram.untilNextUs(6000) != INT32_MAX) || (ram.untilNextUs(2400004000UL) != 1000)) {
+		printf("cues: cue 40 minutes ahead sent early\n");
+		return 1;
+	}
+
+	// Track cues every 500 us
+	for (i = 0; i < CUE_SHOW_LEN; i++) {
+		show[pos++] = (uint8_t)(i * 500);
+		show[pos++] = (uint8_t)((i * 500) >> 8);
+		show[pos++] = (uint8_t)((i * 500) >> 16);
+		show[pos++] = (uint8_t)((i * 500) >> 24);
+		MsgTrackControl::encode(show + pos, TRK_PLAY_POLY, i % 100 + 1, 0, 0);
+		pos += MsgTrackControl::LEN;
+	}
+	tsunami.start(&null);
+	null.frames = 0;
+	cues.clear();
+	cues.loadBlob(show, pos);
+	tsunami.setCueList(&cues);
+	cues.start(micros());
+	while (cues.getDispatched() < CUE_SHOW_LEN) {
+		t0 = benchNs();
+		tsunami.update();
+		ns += benchNs() - t0;
+		calls++;
+	}
+	printf("cues: %u sent  lateness mean %u  p99 %u  max %u us\n", cues.getDispatched(),
+		cues.lateness.meanUs(), cues.lateness.percentileUs(99), cues.lateness.maxUs());
+	benchReport("cues: update() while showing", calls, ns, "call");
+	return 0;
+}
+
+int main(void) {
+
+	if (benchSmoke() || benchRxStats() || benchCues() || benchSync() || benchMirror() ||
+		benchHandshake() || benchTxPrio() || benchCoalesceDrop() || benchVoices() || benchPoly() ||
+		benchScene() || benchDispatch())
+		return 1;
+	benchRx();
+	benchRxBudget("rx budget: none", 0, 0);
+	benchRxBudget("rx budget: 256 bytes", 256, 0);
+	benchRxBudget("rx budget: 64 bytes", 64, 0);
+	benchRxBudget("rx budget: 2 us", 0, 2);
+	benchQuery();
+	benchTx();
+	benchCoalesce();
+	benchGroup();
+	return benchLatency();
+}
@@ -0,0 +1,265 @@
+// **************************************************************
+//     Filename: TtyBench.cpp
+// Date Created: 10/17/2026
+//
+//     Comments: Runs the library over a pseudo-terminal through the
+//               Linux tty transport and epoll loop. A board thread
+//               holds the pty master and plays the Tsunami with the
+//               simulator on the real clock. Checks the start-up
+//               handshake, its retries and a play, then floods the
+//               line with track reports and reports the CPU time and
+//               wake-ups per second of the epoll loop against a loop
+//               that polls update().
+//
+// **************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "Tsunami.h"
+#include "TsunamiSim.h"
+#include "TsunamiLinux.h"
+#include "BenchUtil.h"
+
+// Length of each flood
+#define FLOOD_MS		2000
+// Track reports per second at 57600 baud (9 byte frames), and as
+// fast as the board thread goes
+#define LINE_REPORTS	640
+#define FAST_REPORTS	50000
+
+static int gMaster;
+static TsunamiSim gSim;
+static volatile bool gDone;
+// Reports per second the board thread adds, 0 for none, and the
+// flood number, which restarts the count
+static volatile uint32_t gFloodRate;
+static volatile uint32_t gFloodRun;
+static volatile uint32_t gInjected;
+static uint32_t gReports;
+
+static void countReport(uint16_t track, uint8_t voice, bool didStart) {
+
+	(void)track;
+	(void)voice;
+	(void)didStart;
+	gReports++;
+}
+
+// **************************************************************
+// Board side: commands from the pty go to the simulator, whose
+// answers and the flood reports go back, on the real clock
+static void *boardThread(void *pArg) {
+
+struct pollfd pfd;
+uint8_t buf[512];
+uint64_t last;
+uint64_t floodStart = 0;
+uint64_t now;
+uint32_t due;
+uint32_t run = 0;
+int n;
+int off;
+int w;
+
+	(void)pArg;
+	last = benchNs();
+	while (!gDone) {
+		pfd.fd = gMaster;
+		pfd.events = POLLIN;
+		poll(&pfd, 1, 1);
+		while ((n = read(gMaster, buf, sizeof(buf))) > 0)
+			gSim.write(buf, n);
+		now = benchNs();
+		gSim.advance((uint32_t)((now - last) / 1000));
+		last = now;
+		if (gFloodRun != run) {
+			run = gFloodRun;
+			floodStart = now;
+			gInjected = 0;
+		}
+		if (gFloodRate) {
+			// At most 64 reports per pass, so the simulator never
+			// overruns
+			due = (uint32_t)((now - floodStart) * gFloodRate / 1000000000ull);
+			for (n = 0; (gInjected < due) && (n < 64); n++) {
+				gSim.injectTrackReport(gInjected % 4096 + 1, gInjected % MAX_NUM_VOICES, true);
+				gInjected++;
+			}
+		}
+		while ((n = gSim.readBytes(buf, sizeof(buf))) > 0) {
+			for (off = 0; off < n; off += w) {
+				w = write(gMaster, buf + off, n - off);
+				if (w <= 0) {
+					pfd.events = POLLOUT;
+					poll(&pfd, 1, 10);
+					w = 0;
+				}
+			}
+		}
+	}
+	return NULL;
+}
+
+static uint64_t threadCpuUs(void) {
+
+struct rusage ru;
+
+	getrusage(RUSAGE_THREAD, &ru);
+	return (uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+		ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+// **************************************************************
+// Runs the loop (or polls update() when pLoop is NULL) through one
+// flood and prints what it cost
+static int flood(const char *name, Tsunami &tsunami, TsunamiEpollLoop *pLoop, uint32_t rate) {
+
+uint64_t t0;
+uint64_t cpu0;
+uint64_t ns;
+uint64_t cpu;
+uint32_t wakes = 0;
+uint32_t spins = 0;
+
+	gReports = 0;
+	if (pLoop)
+		wakes = pLoop->getWakeups();
+	cpu0 = threadCpuUs();
+	t0 = benchNs();
+	gFloodRate = rate;
+	gFloodRun++;
+	while ((ns = benchNs() - t0) < (uint64_t)FLOOD_MS * 1000000) {
+		if (pLoop)
+			pLoop->run(100);
+		else
+			tsunami.update();
+		spins++;
+	}
+	gFloodRate = 0;
+	// Let the last reports arrive
+	t0 = benchNs();
+	while ((gReports < gInjected) && ((benchNs() - t0) < 500000000ull)) {
+		if (pLoop)
+			pLoop->run(10);
+		else
+			tsunami.update();
+	}
+	cpu = threadCpuUs() - cpu0;
+	if (pLoop)
+		wakes = pLoop->getWakeups() - wakes;
+	else
+		wakes = spins;
+	printf("tty: %-26s %7u reports/s  cpu %5.1f%%  %8.0f wake-ups/s  %5.1f reports/wake-up\n", name,
+		(unsigned)(gReports * 1000ull / FLOOD_MS), 100.0 * cpu / (FLOOD_MS * 1000.0),
+		wakes * 1000.0 / FLOOD_MS, wakes ? (double)gReports / wakes : 0.0);
+	if (gReports != gInjected) {
+		printf("tty: %s: %u of %u reports lost\n", name, gInjected - gReports, gInjected);
+		return 1;
+	}
+	return 0;
+}
+
+// **************************************************************
+// A board that never answers, with a short handshake retry time:
+// each run() must wake up for the next retry, not sleep for the
+// default one
+static int silentBoard(void) {
+
+Tsunami tsunami;
+TsunamiTtyTransport tty;
+TsunamiEpollLoop loop;
+uint64_t t0;
+int master;
+int i;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((master < 0) || grantpt(master) || unlockpt(master) || !tty.open(ptsname(master))) {
+		printf("tty: no second pseudo-terminal, retry wait skipped\n");
+		return 0;
+	}
+	tsunami.setHandshake(10, 100);
+	tsunami.start(&tty);
+	loop.begin(&tsunami, &tty);
+	t0 = benchNs();
+	for (i = 0; i < 5; i++)
+		loop.run(-1);
+	t0 = benchNs() - t0;
+	tty.close();
+	close(master);
+	if (t0 > 5 * (HANDSHAKE_RETRY_MS / 2) * 1000000ull) {
+		printf("tty: retry wait of %u ms, not the board's 10 ms\n", (unsigned)(t0 / 5000000));
+		return 1;
+	}
+	return 0;
+}
+
+int main(void) {
+
+Tsunami tsunami;
+TsunamiTtyTransport tty;
+TsunamiEpollLoop loop;
+pthread_t board;
+uint64_t t0;
+char version[VERSION_STRING_LEN];
+int fail = 0;
+
+	gMaster = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((gMaster < 0) || grantpt(gMaster) || unlockpt(gMaster)) {
+		printf("tty: no pseudo-terminal, skipped\n");
+		return 0;
+	}
+	fcntl(gMaster, F_SETFL, fcntl(gMaster, F_GETFL) | O_NONBLOCK);
+	if (!tty.open(ptsname(gMaster))) {
+		printf("tty: cannot open %s, skipped\n", ptsname(gMaster));
+		return 0;
+	}
+	pthread_create(&board, NULL, boardThread, NULL);
+	tsunami.start(&tty);
+	tsunami.setTrackReportCallback(countReport);
+	if (!loop.begin(&tsunami, &tty)) {
+		printf("tty: epoll failed\n");
+		return 1;
+	}
+
+	// Handshake and a play over the pty
+	t0 = benchNs();
+	while ((tsunami.getHandshakeState() != HANDSHAKE_READY) && ((benchNs() - t0) < 2000000000ull))
+		loop.run(-1);
+	if (!tsunami.isReady() || !tsunami.getVersion(version, sizeof(version)) ||
+		(tsunami.getNumTracks() != TSUNAMI_SIM_MAX_TRACKS)) {
+		printf("tty: handshake failed over the pty\n");
+		fail = 1;
+	}
+	tsunami.setReporting(true);
+	tsunami.trackPlayPoly(5, 0, false);
+	t0 = benchNs();
+	while (!tsunami.isTrackPlaying(5) && ((benchNs() - t0) < 1000000000ull))
+		loop.run(100);
+	if (!fail && !tsunami.isTrackPlaying(5)) {
+		printf("tty: play not reported over the pty\n");
+		fail = 1;
+	}
+	tsunami.stopAllTracks();
+	fail |= silentBoard();
+	if (!fail)
+		printf("tty: ok, ready in %u ms\n", tsunami.getReadyMs());
+
+	// Idle, then report floods
+	if (!fail) {
+		fail |= flood("idle, epoll", tsunami, &loop, 0);
+		fail |= flood("line rate, epoll", tsunami, &loop, LINE_REPORTS);
+		fail |= flood("line rate, polled", tsunami, NULL, LINE_REPORTS);
+		fail |= flood("flood, epoll", tsunami, &loop, FAST_REPORTS);
+		fail |= flood("flood, polled", tsunami, NULL, FAST_REPORTS);
+	}
+	gDone = true;
+	pthread_join(board, NULL);
+	tty.close();
+	close(gMaster);
+	return fail;
+}